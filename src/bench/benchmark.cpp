@@ -0,0 +1,663 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   End-to-end benchmark over the experiments directory. Every grammar of an
+ *   experiment is parsed against every 'len<n>.input' file of that experiment,
+ *   for each engine, thread count and worklist policy. Each configuration runs in a separate
+ *   process, so that its peak memory usage can be measured, and is repeated
+ *   after a number of warmup runs. The results are written as CSV and JSON,
+ *   and can be compared against a baseline CSV file to find regressions.
+ *   Run 'benchmark --help' for the available options.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <cmath>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../parsers/parsers.hpp"
+#include "../utilities/argparse.hpp"
+
+/**
+ * Options of the benchmark.
+ */
+struct BenchmarkOptions
+{
+    /* Directory that contains the experiments. */
+    std::string experiments = "experiments";
+    /* Engines to benchmark. */
+    std::vector<std::string> engines = { "sequential", "pool", "tree" };
+    /* Thread counts to benchmark the Thread Pool parser with. */
+    std::vector<unsigned int> thread_counts = { 16 };
+    /* Worklist policies to benchmark every engine with. */
+    std::vector<std::string> worklist_policies = { DEFAULT_WORKLIST_POLICY };
+    /* Runs before measuring. */
+    unsigned int warmup = 1;
+    /* Measured runs. */
+    unsigned int repetitions = 5;
+    /* Only experiments and inputs whose path contains this string are run. */
+    std::string filter;
+    /* Longer inputs are skipped. */
+    size_t max_length = static_cast<size_t>(-1);
+    /* Time limit of a configuration in seconds. */
+    unsigned int timeout = 60;
+    /* Files to write the results to. CSV is written to standard output if empty. */
+    std::string csv_file;
+    std::string json_file;
+    /* Baseline CSV file to compare against. */
+    std::string baseline_file;
+    /* Percentage by which the median time may exceed the baseline. */
+    double threshold = 10;
+    /* Baseline medians below this time in milliseconds are not compared. */
+    double min_time = 1;
+};
+
+/**
+ * Measurements of one configuration.
+ */
+struct BenchmarkResult
+{
+    std::string grammar;
+    std::string input;
+    size_t length = 0;
+    std::string engine;
+    unsigned int num_threads = 1;
+    std::string worklist_policy = DEFAULT_WORKLIST_POLICY;
+    std::vector<double> times;
+    double median = 0;
+    double p95 = 0;
+    size_t num_descriptors = 0;
+    size_t num_epns = 0;
+    /* Descriptors processed by all threads, and descriptors rejected because
+       they were already known. Both depend on the worklist policy. */
+    unsigned long num_processed = 0;
+    unsigned long num_duplicates = 0;
+    /* Peak resident set size in kilobytes. */
+    long peak_rss = 0;
+    /* 'ok', 'timeout' or 'failed'. */
+    std::string status = "ok";
+};
+
+/**
+ * Output of a single measured run, sent from the child process to the parent.
+ */
+struct RunOutput
+{
+    double time;
+    size_t num_descriptors;
+    size_t num_epns;
+    unsigned long num_processed;
+    unsigned long num_duplicates;
+};
+
+/**
+ * @brief Splits a string on commas.
+ *
+ * @param value String to split.
+ *
+ * @return Vector of the parts.
+ */
+std::vector<std::string> split(std::string value)
+{
+    std::vector<std::string> parts;
+    std::stringstream ss(value);
+    std::string part;
+
+    while (std::getline(ss, part, ','))
+    {
+        parts.push_back(part);
+    }
+
+    return parts;
+}
+
+/**
+ * @brief Prints the usage of the benchmark.
+ */
+void print_usage()
+{
+    std::cout << "Usage: benchmark [options]\n"
+              << "  --experiments <dir>     Experiments directory. Default: experiments.\n"
+              << "  --engines <list>        Comma-separated engines. Default: sequential,pool,tree.\n"
+              << "  --threads <list>        Comma-separated thread counts for the parallel engines. Default: 16.\n"
+              << "  --worklists <list>      Comma-separated worklist policies. Default: hash.\n"
+              << "  --warmup <n>            Runs before measuring. Default: 1.\n"
+              << "  --repetitions <n>       Measured runs. Default: 5.\n"
+              << "  --filter <string>       Only run inputs whose path contains the string.\n"
+              << "  --max-length <n>        Skip inputs longer than n tokens.\n"
+              << "  --timeout <s>           Time limit of a configuration. Default: 60.\n"
+              << "  --csv <file>            Write CSV to a file instead of standard output.\n"
+              << "  --json <file>           Also write the results as JSON.\n"
+              << "  --baseline <file>       Compare against a CSV file of an earlier run.\n"
+              << "  --threshold <percent>   Allowed slowdown of the median time. Default: 10.\n"
+              << "  --min-time <ms>         Do not compare baseline medians below this time. Default: 1.\n";
+}
+
+/**
+ * @brief Reads the options from the command line arguments.
+ *
+ * @param argc Amount of arguments.
+ * @param argv Array of arguments.
+ * @param options Options to fill in.
+ *
+ * @return True if the arguments are valid, false otherwise.
+ */
+bool parse_benchmark_arguments(int argc, char const *argv[], BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+
+        if (argument == "--help" || i + 1 >= argc)
+        {
+            print_usage();
+            return false;
+        }
+
+        std::string value(argv[++i]);
+
+        try
+        {
+            if (argument == "--experiments") options.experiments = value;
+            else if (argument == "--engines") options.engines = split(value);
+            else if (argument == "--worklists") options.worklist_policies = split(value);
+            else if (argument == "--warmup") options.warmup = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--repetitions") options.repetitions = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--filter") options.filter = value;
+            else if (argument == "--max-length") options.max_length = std::stoul(value);
+            else if (argument == "--timeout") options.timeout = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--csv") options.csv_file = value;
+            else if (argument == "--json") options.json_file = value;
+            else if (argument == "--baseline") options.baseline_file = value;
+            else if (argument == "--threshold") options.threshold = std::stod(value);
+            else if (argument == "--min-time") options.min_time = std::stod(value);
+            else if (argument == "--threads")
+            {
+                options.thread_counts.clear();
+
+                for (auto part : split(value))
+                {
+                    options.thread_counts.push_back(static_cast<unsigned int>(std::stoul(part)));
+                }
+            }
+            else
+            {
+                std::cerr << "Error: unknown option '" << argument << "'" << std::endl;
+                return false;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: invalid value '" << value << "' for option '" << argument << "'" << std::endl;
+            return false;
+        }
+    }
+
+    for (auto engine : options.engines)
+    {
+        if (!is_parser_engine(engine))
+        {
+            std::cerr << "Error: unknown engine '" << engine << "'" << std::endl;
+            return false;
+        }
+    }
+
+    for (auto policy : options.worklist_policies)
+    {
+        if (!Worklist::is_policy(policy))
+        {
+            std::cerr << "Error: unknown worklist policy '" << policy << "'" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.repetitions == 0 || options.thread_counts.empty()
+        || std::count(options.thread_counts.begin(), options.thread_counts.end(), 0u))
+    {
+        std::cerr << "Error: repetitions and thread counts must be positive" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Gets the number from the name of a 'len<n>.input' file.
+ *
+ * @param path Path of the input file.
+ *
+ * @return The number, or 0 if the name does not have that form.
+ */
+size_t input_number(const std::filesystem::path& path)
+{
+    std::string name = path.filename().string();
+
+    if (name.rfind("len", 0) != 0 || path.extension() != ".input")
+    {
+        return 0;
+    }
+
+    try
+    {
+        return std::stoul(name.substr(3));
+    }
+    catch (const std::exception& e)
+    {
+        return 0;
+    }
+}
+
+/**
+ * @brief Value at a percentile of sorted values, using the nearest rank.
+ *
+ * @param values Sorted values.
+ * @param percentile Percentile between 0 and 100.
+ *
+ * @return Value at the percentile.
+ */
+double percentile(std::vector<double>& values, double percentile)
+{
+    size_t rank = static_cast<size_t>(std::ceil(percentile / 100 * static_cast<double>(values.size())));
+
+    return values[std::max<size_t>(rank, 1) - 1];
+}
+
+/**
+ * @brief Runs one configuration in a child process. The child performs the
+ * warmup and measured runs and sends the output of each measured run through
+ * a pipe. The parent collects the peak memory usage of the child.
+ *
+ * @param options Benchmark options.
+ * @param grammar Input grammar.
+ * @param input Input sequence.
+ * @param result Result to fill in.
+ */
+void run_configuration(BenchmarkOptions& options, Grammar& grammar, std::vector<std::string>& input, BenchmarkResult& result)
+{
+    int fds[2];
+
+    if (pipe(fds) != 0)
+    {
+        result.status = "failed";
+        return;
+    }
+
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        alarm(options.timeout);
+
+        for (unsigned int i = 0; i < options.warmup + options.repetitions; i++)
+        {
+            auto parser = make_parser(result.engine, grammar, result.num_threads);
+            parser->print_experiment_data = false;
+            parser->worklist_policy = result.worklist_policy;
+
+            auto output = parser->parse(input);
+            RunOutput run = {
+                parser->timer.elapsedMilliseconds(),
+                output.descriptors.size(),
+                output.epns.size(),
+                parser->statistics.total().num_processed,
+                parser->statistics.total().num_duplicates
+            };
+
+            if (i >= options.warmup && write(fds[1], &run, sizeof(run)) != sizeof(run))
+            {
+                _exit(1);
+            }
+        }
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    RunOutput run;
+    int status = 0;
+    rusage usage = {};
+
+    while (pid > 0 && read(fds[0], &run, sizeof(run)) == sizeof(run))
+    {
+        result.times.push_back(run.time);
+        result.num_descriptors = run.num_descriptors;
+        result.num_epns = run.num_epns;
+        result.num_processed = run.num_processed;
+        result.num_duplicates = run.num_duplicates;
+    }
+
+    close(fds[0]);
+
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0)
+    {
+        result.status = "failed";
+        return;
+    }
+
+    result.peak_rss = usage.ru_maxrss;
+
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+    {
+        result.status = "timeout";
+    }
+    else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || result.times.size() != options.repetitions)
+    {
+        result.status = "failed";
+    }
+
+    if (!result.times.empty())
+    {
+        std::sort(result.times.begin(), result.times.end());
+        result.median = percentile(result.times, 50);
+        result.p95 = percentile(result.times, 95);
+    }
+}
+
+/**
+ * @brief Number of descriptors in the output per second of parsing time.
+ *
+ * @param result Result of a configuration.
+ *
+ * @return Descriptors per second.
+ */
+double descriptors_per_second(BenchmarkResult& result)
+{
+    return result.median > 0 ? static_cast<double>(result.num_descriptors) / result.median * 1e3 : 0;
+}
+
+/**
+ * @brief Writes the results as CSV.
+ *
+ * @param out Stream to write to.
+ * @param results Results to write.
+ */
+void write_csv(std::ostream& out, std::vector<BenchmarkResult>& results)
+{
+    out << "grammar,input,length,engine,threads,worklist,repetitions,median_ms,p95_ms,"
+        << "descriptors_per_second,descriptors,processed,duplicates,epns,peak_rss_kb,status" << std::endl;
+
+    for (auto& result : results)
+    {
+        out << result.grammar
+            << "," << result.input
+            << "," << result.length
+            << "," << result.engine
+            << "," << result.num_threads
+            << "," << result.worklist_policy
+            << "," << result.times.size()
+            << "," << result.median
+            << "," << result.p95
+            << "," << descriptors_per_second(result)
+            << "," << result.num_descriptors
+            << "," << result.num_processed
+            << "," << result.num_duplicates
+            << "," << result.num_epns
+            << "," << result.peak_rss
+            << "," << result.status
+            << std::endl;
+    }
+}
+
+/**
+ * @brief Writes the results as a JSON array, with one object per configuration.
+ *
+ * @param out Stream to write to.
+ * @param results Results to write.
+ */
+void write_json(std::ostream& out, std::vector<BenchmarkResult>& results)
+{
+    out << "[" << std::endl;
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto& result = results[i];
+
+        out << "  {\"grammar\": \"" << result.grammar << "\""
+            << ", \"input\": \"" << result.input << "\""
+            << ", \"length\": " << result.length
+            << ", \"engine\": \"" << result.engine << "\""
+            << ", \"threads\": " << result.num_threads
+            << ", \"worklist\": \"" << result.worklist_policy << "\""
+            << ", \"times_ms\": [";
+
+        for (size_t j = 0; j < result.times.size(); j++)
+        {
+            out << (j ? ", " : "") << result.times[j];
+        }
+
+        out << "], \"median_ms\": " << result.median
+            << ", \"p95_ms\": " << result.p95
+            << ", \"descriptors_per_second\": " << descriptors_per_second(result)
+            << ", \"descriptors\": " << result.num_descriptors
+            << ", \"processed\": " << result.num_processed
+            << ", \"duplicates\": " << result.num_duplicates
+            << ", \"epns\": " << result.num_epns
+            << ", \"peak_rss_kb\": " << result.peak_rss
+            << ", \"status\": \"" << result.status << "\"}"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    out << "]" << std::endl;
+}
+
+/**
+ * @brief Compares the results against a baseline CSV file written by an
+ * earlier run. Configurations are matched on grammar, input, engine, thread
+ * count and worklist policy. A baseline without a worklist column used the
+ * default policy. Prints each regression to standard error.
+ *
+ * @param options Benchmark options.
+ * @param results Results of this run.
+ *
+ * @return Number of regressions, or -1 if the baseline cannot be read.
+ */
+int compare_baseline(BenchmarkOptions& options, std::vector<BenchmarkResult>& results)
+{
+    std::ifstream baseline_file(options.baseline_file);
+    std::map<std::string, double> baseline;
+    std::map<std::string, size_t> columns;
+    std::string line;
+    int regressions = 0;
+
+    if (!baseline_file || !std::getline(baseline_file, line))
+    {
+        std::cerr << "Error: unable to read baseline '" << options.baseline_file << "'" << std::endl;
+        return -1;
+    }
+
+    auto header = split(line);
+
+    for (size_t i = 0; i < header.size(); i++)
+    {
+        columns[header[i]] = i;
+    }
+
+    for (auto column : { "grammar", "input", "engine", "threads", "median_ms", "status" })
+    {
+        if (!columns.count(column))
+        {
+            std::cerr << "Error: baseline is missing column '" << column << "'" << std::endl;
+            return -1;
+        }
+    }
+
+    while (std::getline(baseline_file, line))
+    {
+        auto fields = split(line);
+
+        if (fields.size() != header.size() || fields[columns["status"]] != "ok")
+        {
+            continue;
+        }
+
+        std::string policy = columns.count("worklist") ? fields[columns["worklist"]] : DEFAULT_WORKLIST_POLICY;
+        std::string key = fields[columns["grammar"]] + "," + fields[columns["input"]] + ","
+                          + fields[columns["engine"]] + "," + fields[columns["threads"]] + "," + policy;
+
+        baseline[key] = std::stod(fields[columns["median_ms"]]);
+    }
+
+    for (auto& result : results)
+    {
+        std::string key = result.grammar + "," + result.input + "," + result.engine + ","
+                          + std::to_string(result.num_threads) + "," + result.worklist_policy;
+
+        if (!baseline.count(key) || baseline[key] < options.min_time)
+        {
+            continue;
+        }
+
+        double change = (result.median / baseline[key] - 1) * 100;
+
+        if (result.status != "ok" || change > options.threshold)
+        {
+            std::cerr << "Regression: " << key << ": " << baseline[key] << " ms -> "
+                      << result.median << " ms (" << (change > 0 ? "+" : "") << change << "%, "
+                      << result.status << ")" << std::endl;
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+int main(int argc, char const *argv[])
+{
+    BenchmarkOptions options;
+    std::vector<BenchmarkResult> results;
+    std::vector<std::filesystem::path> experiments;
+
+    if (!parse_benchmark_arguments(argc, argv, options))
+    {
+        return 1;
+    }
+
+    if (!std::filesystem::is_directory(options.experiments))
+    {
+        std::cerr << "Error: unable to open directory '" << options.experiments << "'" << std::endl;
+        return 1;
+    }
+
+    for (auto& entry : std::filesystem::directory_iterator(options.experiments))
+    {
+        if (entry.is_directory())
+        {
+            experiments.push_back(entry.path());
+        }
+    }
+
+    std::sort(experiments.begin(), experiments.end());
+
+    for (auto& experiment : experiments)
+    {
+        std::vector<std::filesystem::path> grammars;
+        std::vector<std::filesystem::path> inputs;
+
+        for (auto& entry : std::filesystem::recursive_directory_iterator(experiment))
+        {
+            if (entry.path().extension() == ".gr")
+            {
+                grammars.push_back(entry.path());
+            }
+            else if (input_number(entry.path()) && entry.path().string().find(options.filter) != std::string::npos)
+            {
+                inputs.push_back(entry.path());
+            }
+        }
+
+        std::sort(grammars.begin(), grammars.end());
+        std::sort(inputs.begin(), inputs.end(), [](auto& first, auto& second) {
+            return std::make_pair(first.parent_path(), input_number(first))
+                   < std::make_pair(second.parent_path(), input_number(second));
+        });
+
+        for (auto& grammar_file : grammars)
+        {
+            Grammar grammar;
+
+            if (inputs.empty() || !read_grammar_file(grammar_file.string(), grammar))
+            {
+                continue;
+            }
+
+            for (auto& input_file : inputs)
+            {
+                auto input = read_input_file(input_file.string());
+
+                if (input.size() > options.max_length)
+                {
+                    continue;
+                }
+
+                for (auto engine : options.engines)
+                {
+                    std::vector<unsigned int> thread_counts = { 1 };
+
+                    if (is_parallel_engine(engine))
+                    {
+                        thread_counts = options.thread_counts;
+                    }
+
+                    for (auto num_threads : thread_counts)
+                    {
+                        for (auto policy : options.worklist_policies)
+                        {
+                            BenchmarkResult result;
+
+                            result.grammar = grammar_file.string();
+                            result.input = input_file.string();
+                            result.length = input.size();
+                            result.engine = engine;
+                            result.num_threads = num_threads;
+                            result.worklist_policy = policy;
+
+                            run_configuration(options, grammar, input, result);
+                            results.push_back(result);
+
+                            std::cerr << result.input << " " << engine << " " << num_threads << " " << policy << ": "
+                                      << result.median << " ms, " << result.num_processed << " processed ("
+                                      << result.status << ")" << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (options.csv_file.empty())
+    {
+        write_csv(std::cout, results);
+    }
+    else
+    {
+        std::ofstream csv_file(options.csv_file);
+        write_csv(csv_file, results);
+    }
+
+    if (!options.json_file.empty())
+    {
+        std::ofstream json_file(options.json_file);
+        write_json(json_file, results);
+    }
+
+    if (!options.baseline_file.empty())
+    {
+        int regressions = compare_baseline(options, results);
+
+        if (regressions != 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -9,85 +9,80 @@
 #include "../utilities/print.hpp"
 #include "../utilities/hash_custom.hpp"
 
-/**
- * @brief Default constructor.
- */
-Descriptor::Descriptor() { }
-
-/**
- * @brief Copy constructor.
- *
- * @param d Descriptor to copy.
- */
-Descriptor::Descriptor(const Descriptor& d)
-{
-    lhs = d.lhs;
-    rhs = d.rhs;
-    dot_position = d.dot_position;
-    left_extent = d.left_extent;
-    right_extent = d.right_extent;
-    force_process = d.force_process;
-}
-
 /**
  * @brief Creates descriptor from parameters.
  *
- * @param k Left hand side of the grammar slot.
- * @param v Right hand side fo the grammar slot.
- * @param d Position of the dot in the grammar slot.
+ * @param s Grammar slot.
  * @param l Left extent.
  * @param r Right extent or pivot.
  */
 Descriptor::Descriptor(
-    std::string k,
-    std::vector<std::string> v,
-    unsigned int d,
+    const GrammarSlot* s,
     unsigned int l,
     unsigned int r
-// ) : lhs(k), rhs(v), dot_position(d), left_extent(l), right_extent(r) { }
-) : lhs(k), rhs(v), dot_position(d), left_extent(l), right_extent(r), force_process(false) { }
+) : slot(s), left_extent(l), right_extent(r), force_process(false) { }
 
 /**
  * @brief Creates descriptor from parameters.
  *
- * @param k Left hand side of the grammar slot.
- * @param v Right hand side fo the grammar slot.
- * @param d Position of the dot in the grammar slot.
+ * @param s Grammar slot.
  * @param l Left extent.
  * @param r Right extent or pivot.
  * @param f Whether to force descriptor to be processed.
  */
 Descriptor::Descriptor(
-    std::string k,
-    std::vector<std::string> v,
-    unsigned int d,
+    const GrammarSlot* s,
     unsigned int l,
     unsigned int r,
     bool f
-) : lhs(k), rhs(v), dot_position(d), left_extent(l), right_extent(r), force_process(f) { }
+) : slot(s), left_extent(l), right_extent(r), force_process(f) { }
+
+/**
+ * @return Left-hand side of the production rule.
+ */
+const std::string& Descriptor::lhs() const
+{
+    return slot->lhs;
+}
+
+/**
+ * @return Right-hand side of the production rule.
+ */
+const std::vector<std::string>& Descriptor::rhs() const
+{
+    return slot->rhs;
+}
+
+/**
+ * @return Position of the dot in the grammar slot.
+ */
+unsigned int Descriptor::dot_position() const
+{
+    return slot->dot_position;
+}
 
 /**
  * @return True if the production rule is fully processed, false otherwise.
  */
-bool Descriptor::is_completed()
+bool Descriptor::is_completed() const
 {
-    return dot_position == rhs.size();
+    return slot->completed;
 }
 
 /**
  * @return True if the right hand side of the production rule is empty.
  */
-bool Descriptor::is_empty()
+bool Descriptor::is_empty() const
 {
-    return rhs.size() == 0;
+    return slot->rhs.size() == 0;
 }
 
 /**
  * @return The next symbol to be processed.
  */
-std::string Descriptor::get_next_symbol()
+const std::string& Descriptor::get_next_symbol() const
 {
-    return rhs.at(dot_position);
+    return slot->rhs.at(slot->dot_position);
 }
 
 /**
@@ -95,7 +90,7 @@ std::string Descriptor::get_next_symbol()
  */
 void Descriptor::advance()
 {
-    dot_position++;
+    slot = slot->next;
 }
 
 /**
@@ -103,7 +98,7 @@ void Descriptor::advance()
  *
  * @return Advanced copy of this descriptor.
  */
-Descriptor Descriptor::copy_and_advance()
+Descriptor Descriptor::copy_and_advance() const
 {
     Descriptor copy = Descriptor(*this);
     copy.advance();
@@ -116,7 +111,7 @@ Descriptor Descriptor::copy_and_advance()
  *
  * @return Advanced copy of this descriptor.
  */
-Descriptor Descriptor::copy_and_force()
+Descriptor Descriptor::copy_and_force() const
 {
     Descriptor copy = Descriptor(*this);
     copy.force_process = true;
@@ -130,55 +125,29 @@ Descriptor Descriptor::copy_and_force()
 size_t Descriptor::hash() const
 {
     size_t seed = 17;
-    hash_custom::hash_combine(seed, lhs);
-    hash_custom::hash_combine(seed, rhs);
-    hash_custom::hash_combine(seed, dot_position);
+    hash_custom::hash_combine(seed, slot->id);
     hash_custom::hash_combine(seed, left_extent);
     hash_custom::hash_combine(seed, right_extent);
 
     return seed;
 }
 
-Descriptor& Descriptor::operator=(const Descriptor& d)
-{
-    if (this == &d)
-    {
-        return *this;
-    }
-
-    lhs = d.lhs;
-    rhs = d.rhs;
-    dot_position = d.dot_position;
-    left_extent = d.left_extent;
-    right_extent = d.right_extent;
-    force_process = d.force_process;
-
-    return *this;
-}
-
+/**
+ * @brief Descriptors are equal if they have the same slot and extents. Slots
+ * are compared by id, so that descriptors of two compilations of the same
+ * grammar can be compared.
+ */
 bool operator==(const Descriptor& first, const Descriptor& second)
 {
-    bool result = first.lhs == second.lhs
-                  && first.rhs.size() == second.rhs.size()
-                  && first.dot_position == second.dot_position
-                  && first.left_extent == second.left_extent
-                  && first.right_extent == second.right_extent;
-
-    if (result)
-    {
-        for (size_t i = 0; i < first.rhs.size(); i++)
-        {
-            result = result && first.rhs[i] == second.rhs[i];
-        }
-    }
-
-    return result;
+    return first.left_extent == second.left_extent
+           && first.right_extent == second.right_extent
+           && (first.slot == second.slot || first.slot->id == second.slot->id);
 }
 
 std::ostream& operator<<(std::ostream& out, const Descriptor& descriptor)
 {
     out << std::string("[")
-        << production_rule_to_string(std::make_pair(descriptor.lhs, descriptor.rhs), descriptor.dot_position)
+        << production_rule_to_string(std::make_pair(descriptor.lhs(), descriptor.rhs()), descriptor.dot_position())
         << std::string(", ")
         << std::to_string(descriptor.left_extent)
         << std::string(", ")
@@ -187,4 +156,4 @@ std::ostream& operator<<(std::ostream& out, const Descriptor& descriptor)
         << std::string(" ") << std::to_string(descriptor.force_process);
 
     return out;
-}
\ No newline at end of file
+}
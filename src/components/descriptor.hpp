@@ -9,38 +9,38 @@
 
 #include <string>
 #include <vector>
+#include "slot.hpp"
 
 /**
- * Represents a descriptor.
+ * Represents a descriptor. The grammar slot is a pointer into the slots of a
+ * compiled grammar, so a descriptor is a small value that is cheap to copy
+ * and hash.
  */
 class Descriptor
 {
 public:
-    /* Left-hand side of the grammar slot. */
-    std::string lhs;
-    /* Right-hand side of the grammar slot. */
-    std::vector<std::string> rhs;
-    /* Position of the dot in the grammar slot. */
-    unsigned int dot_position;
-    unsigned int left_extent;
-    unsigned int right_extent;
+    /* Grammar slot. */
+    const GrammarSlot* slot = nullptr;
+    unsigned int left_extent = 0;
+    unsigned int right_extent = 0;
     /* Whether the descriptor must be forcibly processed, even if it already has been processed. */
     bool force_process = false;
 public:
-    Descriptor();
-    Descriptor(const Descriptor& d);
-    Descriptor(std::string k, std::vector<std::string> v, unsigned int d, unsigned int l, unsigned int r);
-    Descriptor(std::string k, std::vector<std::string> v, unsigned int d, unsigned int l, unsigned int r, bool f);
+    Descriptor() = default;
+    Descriptor(const GrammarSlot* s, unsigned int l, unsigned int r);
+    Descriptor(const GrammarSlot* s, unsigned int l, unsigned int r, bool f);
 public:
-    bool is_completed();
-    bool is_empty();
-    std::string get_next_symbol();
+    const std::string& lhs() const;
+    const std::vector<std::string>& rhs() const;
+    unsigned int dot_position() const;
+    bool is_completed() const;
+    bool is_empty() const;
+    const std::string& get_next_symbol() const;
     void advance();
-    Descriptor copy_and_advance();
-    Descriptor copy_and_force();
+    Descriptor copy_and_advance() const;
+    Descriptor copy_and_force() const;
     size_t hash() const;
-    Descriptor& operator=(const Descriptor& descriptor);
 };
 
 bool operator==(const Descriptor& first, const Descriptor& second);
-std::ostream& operator<<(std::ostream& out, const Descriptor& descriptor);
\ No newline at end of file
+std::ostream& operator<<(std::ostream& out, const Descriptor& descriptor);
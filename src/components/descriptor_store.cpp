@@ -0,0 +1,391 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the descriptor store and its sets of extents.
+ */
+
+#include "descriptor_store.hpp"
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Computes the bits that are set in one bitvector and not in another,
+ * two words at a time with SSE2 when available.
+ *
+ * @param bits Bits to keep.
+ * @param known Bits to clear.
+ * @param result Bitvector to store the result in. May be the same as bits.
+ * @param num_words Number of words in each bitvector.
+ */
+static void and_not(const uint64_t* bits, const uint64_t* known, uint64_t* result, size_t num_words)
+{
+    size_t word = 0;
+
+#ifdef __SSE2__
+    for (; word + 2 <= num_words; word += 2)
+    {
+        __m128i keep = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + word));
+        __m128i clear = _mm_loadu_si128(reinterpret_cast<const __m128i*>(known + word));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + word), _mm_andnot_si128(clear, keep));
+    }
+#endif
+
+    for (; word < num_words; word++)
+    {
+        result[word] = bits[word] & ~known[word];
+    }
+}
+
+/**
+ * @param extent Extent to look for.
+ *
+ * @return True if the extent is in the set.
+ */
+bool ExtentSet::contains(unsigned int extent) const
+{
+    if (dense)
+    {
+        return (data[extent / 64] >> (extent % 64)) & 1;
+    }
+
+    return std::binary_search(data.begin(), data.end(), extent);
+}
+
+/**
+ * @brief Adds an extent to the set. The set becomes a bitvector once the
+ * sorted list would be at least as large as the bitvector.
+ *
+ * @param extent Extent to add.
+ * @param num_words Number of 64-bit words in a bitvector over all extents.
+ *
+ * @return True if the extent was not in the set yet.
+ */
+bool ExtentSet::insert(unsigned int extent, size_t num_words)
+{
+    if (dense)
+    {
+        uint64_t bit = uint64_t(1) << (extent % 64);
+
+        if (data[extent / 64] & bit)
+        {
+            return false;
+        }
+
+        data[extent / 64] |= bit;
+        num_extents++;
+
+        return true;
+    }
+
+    auto position = std::lower_bound(data.begin(), data.end(), extent);
+
+    if (position != data.end() && *position == extent)
+    {
+        return false;
+    }
+
+    data.insert(position, extent);
+    num_extents++;
+
+    if (data.size() >= num_words)
+    {
+        std::vector<uint64_t> bits(num_words, 0);
+
+        for (auto e : data)
+        {
+            bits[e / 64] |= uint64_t(1) << (e % 64);
+        }
+
+        data.swap(bits);
+        dense = true;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Sets the bits of the extents in the set in a bitvector over all
+ * extents. A dense set is added one word at a time.
+ *
+ * @param bits Bitvector to add the extents to.
+ */
+void ExtentSet::add_to(std::vector<uint64_t>& bits) const
+{
+    if (dense)
+    {
+        for (size_t word = 0; word < data.size(); word++)
+        {
+            bits[word] |= data[word];
+        }
+
+        return;
+    }
+
+    for (auto extent : data)
+    {
+        bits[extent / 64] |= uint64_t(1) << (extent % 64);
+    }
+}
+
+/**
+ * @brief Computes the extents in a bitvector that are not in the set. A dense
+ * set is subtracted one word at a time.
+ *
+ * @param bits Bitvector over all extents.
+ * @param result Bitvector of the same size to store the result in.
+ *
+ * @return Number of extents in the result.
+ */
+size_t ExtentSet::subtract_from(const std::vector<uint64_t>& bits, std::vector<uint64_t>& result) const
+{
+    result.resize(bits.size());
+
+    if (dense)
+    {
+        and_not(bits.data(), data.data(), result.data(), bits.size());
+    }
+    else
+    {
+        std::copy(bits.begin(), bits.end(), result.begin());
+
+        for (auto extent : data)
+        {
+            result[extent / 64] &= ~(uint64_t(1) << (extent % 64));
+        }
+    }
+
+    return count_bits(result);
+}
+
+/**
+ * @param bits Bitvector.
+ *
+ * @return Number of bits that are set.
+ */
+size_t ExtentSet::count_bits(const std::vector<uint64_t>& bits)
+{
+    size_t count = 0;
+
+    for (auto word : bits)
+    {
+        count += static_cast<size_t>(__builtin_popcountll(word));
+    }
+
+    return count;
+}
+
+/**
+ * @param extent Extent to look for.
+ *
+ * @return Position of the entry of the extent in the table, or of the free
+ * entry where it would be added. The table must not be empty.
+ */
+size_t ExtentIndex::position(unsigned int extent) const
+{
+    size_t mask = table.size() - 1;
+    size_t index = (static_cast<size_t>(extent) * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+
+    while (table[index].first && table[index].first != extent + 1)
+    {
+        index = (index + 1) & mask;
+    }
+
+    return index;
+}
+
+/**
+ * @brief Doubles the size of the table, or gives it 8 entries if it has none.
+ */
+void ExtentIndex::grow()
+{
+    std::vector<std::pair<uint32_t, uint32_t>> old(std::max<size_t>(8, table.size() * 2));
+
+    table.swap(old);
+
+    for (auto& entry : old)
+    {
+        if (entry.first)
+        {
+            table[position(entry.first - 1)] = entry;
+        }
+    }
+}
+
+/**
+ * @param extent Extent of the set.
+ *
+ * @return The set of an extent, or nullptr if it has none.
+ */
+const ExtentSet* ExtentIndex::find(unsigned int extent) const
+{
+    if (table.empty())
+    {
+        return nullptr;
+    }
+
+    auto& entry = table[position(extent)];
+
+    return entry.first ? &sets[entry.second] : nullptr;
+}
+
+/**
+ * @param extent Extent of the set.
+ *
+ * @return The set of an extent, created empty if it has none.
+ */
+ExtentSet& ExtentIndex::get(unsigned int extent)
+{
+    if ((sets.size() + 1) * 2 > table.size())
+    {
+        grow();
+    }
+
+    auto& entry = table[position(extent)];
+
+    if (!entry.first)
+    {
+        entry = std::make_pair(static_cast<uint32_t>(extent + 1), static_cast<uint32_t>(sets.size()));
+        sets.emplace_back();
+    }
+
+    return sets[entry.second];
+}
+
+/**
+ * @brief Removes all descriptors and prepares the store for a parse.
+ *
+ * @param num_slots Number of slots of the compiled grammar.
+ * @param input_length Length of the input sequence.
+ */
+void DescriptorStore::reset(size_t num_slots, size_t input_length)
+{
+    num_words = input_length / 64 + 1;
+    num_descriptors = 0;
+
+    right_extents.clear();
+    left_extents.clear();
+    right_extents.resize(num_slots);
+    left_extents.resize(num_slots);
+}
+
+/**
+ * @brief Adds a descriptor to the store.
+ *
+ * @param descriptor Descriptor to add.
+ *
+ * @return True if the descriptor was not in the store yet.
+ */
+bool DescriptorStore::insert(const Descriptor& descriptor)
+{
+    auto& rows = right_extents[descriptor.slot->id];
+    auto& columns = left_extents[descriptor.slot->id];
+
+    if (!rows.get(descriptor.left_extent).insert(descriptor.right_extent, num_words))
+    {
+        return false;
+    }
+
+    columns.get(descriptor.right_extent).insert(descriptor.left_extent, num_words);
+    num_descriptors++;
+
+    return true;
+}
+
+/**
+ * @param descriptor Descriptor to look for.
+ *
+ * @return True if the descriptor is in the store.
+ */
+bool DescriptorStore::contains(const Descriptor& descriptor) const
+{
+    auto& rows = right_extents[descriptor.slot->id];
+    const ExtentSet* extents = rows.find(descriptor.left_extent);
+
+    return extents && extents->contains(descriptor.right_extent);
+}
+
+/**
+ * @brief Adds the right extents of the descriptors with the given slot and
+ * left extent to a bitvector.
+ *
+ * @param slot Slot of the descriptors.
+ * @param left_extent Left extent of the descriptors.
+ * @param bits Bitvector of bitvector_words() words to add the right extents to.
+ *
+ * @return True if there is at least one such descriptor.
+ */
+bool DescriptorStore::add_right_extents(const GrammarSlot* slot, unsigned int left_extent, std::vector<uint64_t>& bits) const
+{
+    auto& rows = right_extents[slot->id];
+    const ExtentSet* extents = rows.find(left_extent);
+
+    if (!extents || extents->empty())
+    {
+        return false;
+    }
+
+    extents->add_to(bits);
+
+    return true;
+}
+
+/**
+ * @param slot Slot of the descriptors.
+ * @param right_extent Right extent of the descriptors.
+ *
+ * @return The left extents of the descriptors with the given slot and right
+ *         extent.
+ */
+const ExtentSet& DescriptorStore::get_left_extents(const GrammarSlot* slot, unsigned int right_extent) const
+{
+    static const ExtentSet none;
+    auto& columns = left_extents[slot->id];
+    const ExtentSet* extents = columns.find(right_extent);
+
+    return extents ? *extents : none;
+}
+
+/**
+ * @param slot Slot of the descriptors.
+ * @param left_extent Left extent of the descriptors.
+ *
+ * @return The right extents of the descriptors with the given slot and left
+ *         extent.
+ */
+const ExtentSet& DescriptorStore::get_right_extents(const GrammarSlot* slot, unsigned int left_extent) const
+{
+    static const ExtentSet none;
+    auto& rows = right_extents[slot->id];
+    const ExtentSet* extents = rows.find(left_extent);
+
+    return extents ? *extents : none;
+}
+
+/**
+ * @param grammar Compiled grammar that the slots of the descriptors belong to.
+ *
+ * @return Set of all descriptors in the store.
+ */
+descriptor_set_t DescriptorStore::to_set(const Grammar& grammar) const
+{
+    descriptor_set_t descriptors;
+    descriptors.reserve(num_descriptors);
+
+    for (unsigned int id = 0; id < right_extents.size(); id++)
+    {
+        const GrammarSlot* slot = grammar.get_slot(id);
+
+        right_extents[id].for_each([&](unsigned int left_extent, const ExtentSet& extents) {
+            extents.for_each([&](unsigned int right_extent) {
+                descriptors.insert(Descriptor(slot, left_extent, right_extent));
+            });
+        });
+    }
+
+    return descriptors;
+}
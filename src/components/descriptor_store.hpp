@@ -0,0 +1,191 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Contains a descriptor store that keeps, for every slot and left extent, the
+ *   set of right extents of the descriptors, and for every slot and right
+ *   extent the set of left extents. A set of extents is a small sorted list
+ *   while it is sparse and becomes a bitvector over all extents once the list
+ *   would take more memory than the bitvector. On highly ambiguous grammars
+ *   almost all (slot, left extent, right extent) triples are descriptors, and
+ *   the bitvectors take a fraction of the memory of a hash set. A slot only
+ *   has sets for the extents it has descriptors at, so grammars with few
+ *   descriptors per slot, such as Java, only pay for the extents they use.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "descriptor.hpp"
+#include "grammar.hpp"
+
+/**
+ * Set of extents of the input, between 0 and the length of the input.
+ */
+class ExtentSet
+{
+private:
+    /* Sorted extents while sparse, one bit per extent while dense. */
+    std::vector<uint64_t> data;
+    /* Number of extents in the set. */
+    unsigned int num_extents = 0;
+    /* Whether the set is a bitvector. */
+    bool dense = false;
+public:
+    bool contains(unsigned int extent) const;
+    bool insert(unsigned int extent, size_t num_words);
+    void add_to(std::vector<uint64_t>& bits) const;
+    size_t subtract_from(const std::vector<uint64_t>& bits, std::vector<uint64_t>& result) const;
+    size_t size() const { return num_extents; }
+    bool empty() const { return num_extents == 0; }
+    static size_t count_bits(const std::vector<uint64_t>& bits);
+
+    /**
+     * @brief Calls a function for every extent in the set that is not in
+     * another set. A dense set is filtered one word at a time, a sparse set
+     * one extent at a time.
+     *
+     * @param known Set of extents to leave out.
+     * @param scratch Bitvector over all extents, used by dense sets.
+     * @param function Function to call with each extent.
+     *
+     * @return Number of extents that were left out.
+     */
+    template <typename Function>
+    size_t for_each_new(const ExtentSet& known, std::vector<uint64_t>& scratch, Function function) const
+    {
+        if (!dense)
+        {
+            size_t num_known = 0;
+
+            for (auto extent : data)
+            {
+                if (known.contains(static_cast<unsigned int>(extent)))
+                {
+                    num_known++;
+                }
+                else
+                {
+                    function(static_cast<unsigned int>(extent));
+                }
+            }
+
+            return num_known;
+        }
+
+        size_t num_new = known.subtract_from(data, scratch);
+        for_each_bit(scratch, function);
+
+        return num_extents - num_new;
+    }
+
+    /**
+     * @brief Calls a function for every extent in the set, in ascending order.
+     *
+     * @param function Function to call with each extent.
+     */
+    template <typename Function>
+    void for_each(Function function) const
+    {
+        if (!dense)
+        {
+            for (auto extent : data)
+            {
+                function(static_cast<unsigned int>(extent));
+            }
+
+            return;
+        }
+
+        for_each_bit(data, function);
+    }
+
+    /**
+     * @brief Calls a function for the index of every bit that is set in a
+     * bitvector, in ascending order.
+     *
+     * @param bits Bitvector.
+     * @param function Function to call with each index.
+     */
+    template <typename Function>
+    static void for_each_bit(const std::vector<uint64_t>& bits, Function function)
+    {
+        for (size_t word = 0; word < bits.size(); word++)
+        {
+            uint64_t remaining = bits[word];
+
+            while (remaining)
+            {
+                function(static_cast<unsigned int>(word * 64 + static_cast<size_t>(__builtin_ctzll(remaining))));
+                remaining &= remaining - 1;
+            }
+        }
+    }
+};
+
+/**
+ * Sets of extents indexed by an extent. Only extents whose set was written
+ * have one, found through an open-addressing hash table, so extents without
+ * descriptors take no memory. Sets never move once created.
+ */
+class ExtentIndex
+{
+private:
+    /* Extent plus one and index of its set, or 0 and 0 for a free entry. The
+       size is a power of two, and at most half of the entries are used. */
+    std::vector<std::pair<uint32_t, uint32_t>> table;
+    std::deque<ExtentSet> sets;
+public:
+    const ExtentSet* find(unsigned int extent) const;
+    ExtentSet& get(unsigned int extent);
+
+    /**
+     * @brief Calls a function for every set, with its extent, in no
+     * particular order.
+     *
+     * @param function Function to call with each extent and set.
+     */
+    template <typename Function>
+    void for_each(Function function) const
+    {
+        for (auto& entry : table)
+        {
+            if (entry.first)
+            {
+                function(entry.first - 1, sets[entry.second]);
+            }
+        }
+    }
+private:
+    size_t position(unsigned int extent) const;
+    void grow();
+};
+
+/**
+ * Set of descriptors of a single parse, indexed by slot and extents.
+ */
+class DescriptorStore
+{
+private:
+    /* Number of 64-bit words in a bitvector over all extents. */
+    size_t num_words = 0;
+    /* Right extents, indexed by slot id and left extent. */
+    std::vector<ExtentIndex> right_extents;
+    /* Left extents, indexed by slot id and right extent. */
+    std::vector<ExtentIndex> left_extents;
+    /* Number of descriptors in the store. */
+    size_t num_descriptors = 0;
+public:
+    void reset(size_t num_slots, size_t input_length);
+    bool insert(const Descriptor& descriptor);
+    bool contains(const Descriptor& descriptor) const;
+    bool add_right_extents(const GrammarSlot* slot, unsigned int left_extent, std::vector<uint64_t>& bits) const;
+    const ExtentSet& get_left_extents(const GrammarSlot* slot, unsigned int right_extent) const;
+    const ExtentSet& get_right_extents(const GrammarSlot* slot, unsigned int left_extent) const;
+    descriptor_set_t to_set(const Grammar& grammar) const;
+    size_t size() const { return num_descriptors; }
+    size_t bitvector_words() const { return num_words; }
+};
@@ -16,14 +16,7 @@
  * @param d Descriptor.
  */
 EPN::EPN(const Descriptor& d)
-{
-    lhs = d.lhs;
-    rhs = d.rhs;
-    dot_position = d.dot_position;
-    left_extent = d.left_extent;
-    pivot = d.right_extent;
-    right_extent = d.right_extent;
-}
+    : slot(d.slot), left_extent(d.left_extent), pivot(d.right_extent), right_extent(d.right_extent) { }
 
 /**
  * @brief Crates an EPN from a descriptor with a provided pivot.
@@ -32,33 +25,46 @@ EPN::EPN(const Descriptor& d)
  * @param p Pivot.
  */
 EPN::EPN(const Descriptor& d, unsigned int p)
-{
-    lhs = d.lhs;
-    rhs = d.rhs;
-    dot_position = d.dot_position;
-    left_extent = d.left_extent;
-    pivot = p;
-    right_extent = d.right_extent;
-}
+    : slot(d.slot), left_extent(d.left_extent), pivot(p), right_extent(d.right_extent) { }
 
 /**
- * @brief Creates descriptor from parameters.
+ * @brief Creates EPN from parameters.
  *
- * @param k Left hand side of the grammar slot.
- * @param v Right hand side fo the grammar slot.
- * @param d Position of the dot in the grammar slot.
+ * @param s Grammar slot.
  * @param l Left extent.
  * @param p Pivot.
  * @param r Right extent.
  */
 EPN::EPN(
-    std::string k,
-    std::vector<std::string> v,
-    unsigned int d,
+    const GrammarSlot* s,
     unsigned int l,
     unsigned int p,
     unsigned int r
-) : lhs(k), rhs(v), dot_position(d), left_extent(l), pivot(p), right_extent(r) { }
+) : slot(s), left_extent(l), pivot(p), right_extent(r) { }
+
+/**
+ * @return Left-hand side of the production rule.
+ */
+const std::string& EPN::lhs() const
+{
+    return slot->lhs;
+}
+
+/**
+ * @return Right-hand side of the production rule.
+ */
+const std::vector<std::string>& EPN::rhs() const
+{
+    return slot->rhs;
+}
+
+/**
+ * @return Position of the dot in the grammar slot.
+ */
+unsigned int EPN::dot_position() const
+{
+    return slot->dot_position;
+}
 
 /**
  * @return Hash of this object.
@@ -66,9 +72,7 @@ EPN::EPN(
 size_t EPN::hash() const
 {
     size_t seed = 17;
-    hash_custom::hash_combine(seed, lhs);
-    hash_custom::hash_combine(seed, rhs);
-    hash_custom::hash_combine(seed, dot_position);
+    hash_custom::hash_combine(seed, slot->id);
     hash_custom::hash_combine(seed, left_extent);
     hash_custom::hash_combine(seed, pivot);
     hash_custom::hash_combine(seed, right_extent);
@@ -76,30 +80,22 @@ size_t EPN::hash() const
     return seed;
 }
 
+/**
+ * @brief EPNs are equal if they have the same slot, extents and pivot. Slots
+ * are compared by id.
+ */
 bool operator==(const EPN& first, const EPN& second)
 {
-    bool result = first.lhs == second.lhs
-                  && first.rhs.size() == second.rhs.size()
-                  && first.dot_position == second.dot_position
-                  && first.left_extent == second.left_extent
-                  && first.pivot == second.pivot
-                  && first.right_extent == second.right_extent;
-
-    if (result)
-    {
-        for (size_t i = 0; i < first.rhs.size(); i++)
-        {
-            result = result && first.rhs[i] == second.rhs[i];
-        }
-    }
-
-    return result;
+    return first.left_extent == second.left_extent
+           && first.pivot == second.pivot
+           && first.right_extent == second.right_extent
+           && (first.slot == second.slot || first.slot->id == second.slot->id);
 }
 
 std::ostream& operator<<(std::ostream& out, const EPN& epn)
 {
     out << std::string("[")
-        << production_rule_to_string(std::make_pair(epn.lhs, epn.rhs), epn.dot_position)
+        << production_rule_to_string(std::make_pair(epn.lhs(), epn.rhs()), epn.dot_position())
         << std::string(", ")
         << std::to_string(epn.left_extent)
         << std::string(", ")
@@ -109,4 +105,4 @@ std::ostream& operator<<(std::ostream& out, const EPN& epn)
         << std::string("]");
 
     return out;
-}
\ No newline at end of file
+}
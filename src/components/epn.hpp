@@ -11,27 +11,28 @@
 #include "descriptor.hpp"
 
 /**
- * Represents an extended packed node.
+ * Represents an extended packed node. Like a descriptor, the grammar slot is
+ * a pointer into the slots of a compiled grammar.
  */
 class EPN
 {
 public:
-    /* Left-hand side of the grammar slot. */
-    std::string lhs;
-    /* Right-hand side of the grammar slot. */
-    std::vector<std::string> rhs;
-    /* Position of the dot in the grammar slot. */
-    unsigned int dot_position;
-    unsigned int left_extent;
-    unsigned int pivot;
-    unsigned int right_extent;
+    /* Grammar slot. */
+    const GrammarSlot* slot = nullptr;
+    unsigned int left_extent = 0;
+    unsigned int pivot = 0;
+    unsigned int right_extent = 0;
 public:
+    EPN() = default;
     EPN(const Descriptor& d);
     EPN(const Descriptor& d, unsigned int p);
-    EPN(std::string k, std::vector<std::string> v, unsigned int d, unsigned int l, unsigned int p, unsigned int r);
+    EPN(const GrammarSlot* s, unsigned int l, unsigned int p, unsigned int r);
 public:
+    const std::string& lhs() const;
+    const std::vector<std::string>& rhs() const;
+    unsigned int dot_position() const;
     size_t hash() const;
 };
 
 bool operator==(const EPN& first, const EPN& second);
-std::ostream& operator<<(std::ostream& out, const EPN& epn);
\ No newline at end of file
+std::ostream& operator<<(std::ostream& out, const EPN& epn);
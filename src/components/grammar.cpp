@@ -33,6 +33,7 @@ bool Grammar::add_terminal(std::string symbol)
     bool success = !nonterminals.count(symbol);
     success = success && terminals.insert(symbol).second;
     success = success && symbols.insert(symbol).second;
+    compiled.reset();
 
     if (!success)
     {
@@ -55,6 +56,7 @@ bool Grammar::add_nonterminal(std::string symbol)
     bool success = !terminals.count(symbol);
     success = success && nonterminals.insert(symbol).second;
     success = success && symbols.insert(symbol).second;
+    compiled.reset();
 
     return success;
 }
@@ -104,6 +106,8 @@ void Grammar::add_production_rule(std::string lhs, std::initializer_list<std::st
 void Grammar::add_production_rule(std::string lhs, std::vector<std::string> rhs)
 {
     production_rules.insert({lhs, rhs});
+    rule_list.push_back({lhs, rhs});
+    compiled.reset();
 }
 
 /**
@@ -127,4 +131,164 @@ std::vector<production_rule_t> Grammar::get_production_rules(std::string lhs)
     );
 
     return rules;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Creates the grammar slots of all production rules, if the grammar
+ * has not been compiled since it was last changed. Slot ids follow the order
+ * in which the rules were added, so compiling the same grammar twice gives
+ * the same ids. A rule that was added twice gets one set of slots. Copies of
+ * the grammar made after compiling share the slots.
+ */
+void Grammar::compile()
+{
+    if (compiled)
+    {
+        return;
+    }
+
+    auto result = std::make_shared<CompiledGrammar>();
+    std::unordered_set<std::vector<std::string>, hash_custom::hash<std::vector<std::string>>> seen;
+
+    auto symbol_id = [&result](const std::string& symbol) {
+        auto id = static_cast<unsigned int>(result->symbol_ids.size());
+
+        return result->symbol_ids.emplace(symbol, id).first->second;
+    };
+
+    for (auto& rule : rule_list)
+    {
+        std::vector<std::string> key = rule.second;
+        key.push_back(rule.first);
+
+        if (!seen.insert(key).second)
+        {
+            continue;
+        }
+
+        GrammarSlot* previous = nullptr;
+
+        for (unsigned int dot = 0; dot <= rule.second.size(); dot++)
+        {
+            GrammarSlot slot;
+
+            slot.id = static_cast<unsigned int>(result->slots.size());
+            slot.lhs = rule.first;
+            slot.rhs = rule.second;
+            slot.dot_position = dot;
+            slot.completed = dot == rule.second.size();
+            slot.next_symbol = slot.completed ? "" : rule.second[dot];
+            slot.lhs_id = symbol_id(slot.lhs);
+            slot.next_symbol_id = slot.completed ? 0 : symbol_id(slot.next_symbol);
+            slot.next_is_terminal = !slot.completed && terminals.count(slot.next_symbol);
+            slot.next = nullptr;
+
+            result->slots.push_back(slot);
+
+            if (previous)
+            {
+                previous->next = &result->slots.back();
+            }
+            else
+            {
+                result->initial_slots[rule.first].push_back(&result->slots.back());
+            }
+
+            previous = &result->slots.back();
+        }
+    }
+
+    result->completed_slots.resize(result->symbol_ids.size());
+    result->waiting_slots.resize(result->symbol_ids.size());
+
+    for (auto& slot : result->slots)
+    {
+        if (slot.completed)
+        {
+            result->completed_slots[slot.lhs_id].push_back(&slot);
+        }
+        else if (!slot.next_is_terminal)
+        {
+            result->waiting_slots[slot.next_symbol_id].push_back(&slot);
+        }
+    }
+
+    compiled = result;
+}
+
+/**
+ * @brief Get the slots of the production rules of a nonterminal, with the dot
+ * at the start. The grammar must be compiled.
+ *
+ * @param lhs Left-hand side of the production rules.
+ *
+ * @return Slots of the production rules, empty if there are none.
+ */
+const std::vector<const GrammarSlot*>& Grammar::get_initial_slots(const std::string& lhs) const
+{
+    static const std::vector<const GrammarSlot*> none;
+    auto slots = compiled->initial_slots.find(lhs);
+
+    return slots == compiled->initial_slots.end() ? none : slots->second;
+}
+
+/**
+ * @brief Get the slot of a production rule with the dot at some position. The
+ * grammar must be compiled.
+ *
+ * @param lhs Left-hand side of the production rule.
+ * @param rhs Right-hand side of the production rule.
+ * @param dot_position Position of the dot.
+ *
+ * @return The slot, or null if the grammar does not have the rule.
+ */
+const GrammarSlot* Grammar::get_slot(const std::string& lhs, const std::vector<std::string>& rhs, unsigned int dot_position) const
+{
+    for (auto slot : get_initial_slots(lhs))
+    {
+        if (slot->rhs == rhs && dot_position <= rhs.size())
+        {
+            return &compiled->slots[slot->id + dot_position];
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @param id Id of a slot. The grammar must be compiled.
+ *
+ * @return The slot with the id.
+ */
+const GrammarSlot* Grammar::get_slot(unsigned int id) const
+{
+    return &compiled->slots[id];
+}
+
+/**
+ * @return Number of slots of the compiled grammar, 0 if it is not compiled.
+ */
+size_t Grammar::num_slots() const
+{
+    return compiled ? compiled->slots.size() : 0;
+}
+
+/**
+ * @param symbol_id Id of a nonterminal. The grammar must be compiled.
+ *
+ * @return The completed slots of the production rules of the nonterminal.
+ */
+const std::vector<const GrammarSlot*>& Grammar::get_completed_slots(unsigned int symbol_id) const
+{
+    return compiled->completed_slots[symbol_id];
+}
+
+/**
+ * @param symbol_id Id of a nonterminal. The grammar must be compiled.
+ *
+ * @return The slots that have the nonterminal after the dot.
+ */
+const std::vector<const GrammarSlot*>& Grammar::get_waiting_slots(unsigned int symbol_id) const
+{
+    return compiled->waiting_slots[symbol_id];
+}
@@ -7,10 +7,30 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
 #include <unordered_map>
+#include "slot.hpp"
 #include "../utilities/hash_custom.hpp"
 #include "../utilities/types.hpp"
 
+/**
+ * Grammar slots of a compiled grammar.
+ */
+struct CompiledGrammar
+{
+    /* All slots, indexed by id. A deque keeps the addresses of the slots stable. */
+    std::deque<GrammarSlot> slots;
+    /* Maps a nonterminal to the slots of its production rules with the dot at the start. */
+    std::unordered_map<std::string, std::vector<const GrammarSlot*>> initial_slots;
+    /* Maps each symbol to its id. */
+    std::unordered_map<std::string, unsigned int> symbol_ids;
+    /* Completed slots, indexed by the symbol id of their left-hand side. */
+    std::vector<std::vector<const GrammarSlot*>> completed_slots;
+    /* Slots with a nonterminal after the dot, indexed by the symbol id of that nonterminal. */
+    std::vector<std::vector<const GrammarSlot*>> waiting_slots;
+};
+
 /**
  * Represents a context-free grammar.
  */
@@ -29,6 +49,10 @@ public:
     std::string start_symbol;
     /* Indicates if start symbol is set. */
     bool has_start_symbol = false;
+    /* Production rules in the order they were added. */
+    std::vector<production_rule_t> rule_list;
+    /* Compiled grammar slots, shared between copies of the grammar. Null if not compiled. */
+    std::shared_ptr<const CompiledGrammar> compiled;
 public:
     Grammar() = default;
     Grammar(std::string start_symbol);
@@ -39,4 +63,11 @@ public:
     void add_production_rule(std::string lhs, std::initializer_list<std::string> rhs);
     void add_production_rule(std::string lhs, std::vector<std::string> rhs);
     std::vector<production_rule_t> get_production_rules(std::string lhs);
+    void compile();
+    const std::vector<const GrammarSlot*>& get_initial_slots(const std::string& lhs) const;
+    const GrammarSlot* get_slot(const std::string& lhs, const std::vector<std::string>& rhs, unsigned int dot_position) const;
+    const GrammarSlot* get_slot(unsigned int id) const;
+    size_t num_slots() const;
+    const std::vector<const GrammarSlot*>& get_completed_slots(unsigned int symbol_id) const;
+    const std::vector<const GrammarSlot*>& get_waiting_slots(unsigned int symbol_id) const;
 };
@@ -5,34 +5,185 @@
  *   Implementation of the Parser base class.
  */
 
+#include <iostream>
 #include "parser.hpp"
 
 /**
- * @brief Constructs a parser using a grammar.
+ * @param input Input to edit.
+ *
+ * @return Copy of the input with the edit applied.
+ */
+std::vector<std::string> TokenEdit::apply(const std::vector<std::string>& input) const
+{
+    std::vector<std::string> result(input.begin(), input.begin() + static_cast<long>(begin));
+
+    result.insert(result.end(), tokens.begin(), tokens.end());
+    result.insert(result.end(), input.begin() + static_cast<long>(end), input.end());
+
+    return result;
+}
+
+/**
+ * @brief Constructs a parser using a grammar. Compiles the grammar if that
+ * has not been done yet.
  *
  * @param g Grammar.
  */
-Parser::Parser(Grammar g) : grammar(g), timer(Timer()) {}
+Parser::Parser(Grammar g) : grammar(g), timer(Timer())
+{
+    grammar.compile();
+}
 
 /**
  * @brief Sets the appropriate varibles and starts the timer. Calls the
- * virtual loop() and print_data() functions.
+ * virtual loop(), get_result() and, if enabled, print_data() functions. The
+ * calling thread is the first thread of the statistics. When lock profiling
+ * is enabled, statistics.locks holds the contention of the locks of this
+ * parser during the parse. The 'parse', 'materialise' and 'output' phases are recorded,
+ * and 'merge_spill' if EPNs were spilled to disk. If the parse exceeds one
+ * of its limits or is cancelled, loop() returns early and the result holds
+ * what was found until then; statistics.stop_reason says why.
  *
- * @param input_sequence Input sequence for the parser.
+ * @param input_sequence Input sequence for the parser, moved into the parser.
  *
- * @return Tuple with descriptors and EPNs outputted by the parser.
+ * @return Descriptors and EPNs outputted by the parser.
  */
-std::tuple<descriptor_set_t, epn_set_t>
-Parser::parse(std::vector<std::string> input_sequence)
+ParseResult Parser::parse(std::vector<std::string> input_sequence)
 {
-    this->input = input_sequence;
+    this->input = std::move(input_sequence);
+    this->statistics.reset();
+    this->phases = PhaseTimer();
+    this->spilled_epns.reset();
+    this->spill_failed = false;
+    this->stopped = false;
+    this->num_checks = 0;
+
+    ThreadStatistics& counters = this->statistics.add_thread();
+
+    this->phases.start("parse");
     this->timer.start();
 
-    auto result = loop();
+    loop();
 
     this->timer.stop();
+    this->statistics.wall_time = this->timer.elapsedMilliseconds();
+    counters.stop_cpu_clock();
+    this->phases.start("materialise");
+
+    auto result = get_result();
 
-    print_data();
+    result.grammar = grammar.compiled;
+
+    if (spilled_epns)
+    {
+        this->phases.start("merge_spill");
+        merge_spilled_epns(result.epns);
+    }
+
+    this->phases.start("output");
+
+    if (print_experiment_data)
+    {
+        print_data(result);
+    }
+
+    if (print_statistics)
+    {
+        std::cout << statistics.to_json() << std::endl;
+    }
+
+    this->phases.stop();
 
     return result;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Parses an input after an edit, given the result of the input before
+ * the edit. Parsers that cannot reuse the previous result parse the edited
+ * input from scratch.
+ *
+ * @param previous_input Input before the edit.
+ * @param previous_result Result of parsing the previous input with the same
+ *                        grammar, with all of its EPNs.
+ * @param edit Edit of the previous input, valid for its length.
+ *
+ * @return Descriptors and EPNs of the edited input.
+ */
+ParseResult Parser::reparse(
+    const std::vector<std::string>& previous_input,
+    const ParseResult& /* previous_result */,
+    const TokenEdit& edit
+)
+{
+    return parse(edit.apply(previous_input));
+}
+
+/**
+ * @brief Stops the current parse. The threads of the parser see this at their
+ * next call to should_stop() or is_stopped() and finish. Only the first reason
+ * is recorded in the statistics.
+ *
+ * @param reason 'time', 'descriptors', 'memory', 'cancelled' or 'failed'.
+ *
+ * @return True.
+ */
+bool Parser::stop(const std::string& reason)
+{
+    bool expected = false;
+
+    if (stopped.compare_exchange_strong(expected, true))
+    {
+        statistics.stop_reason = reason;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes the EPNs to disk as a sorted run and empties the set, which
+ * releases its memory. If the run cannot be written, the EPNs stay in memory
+ * and no more EPNs are spilled during the parse.
+ *
+ * @param epns EPN set of the parser.
+ *
+ * @return True if the EPNs were spilled, false otherwise.
+ */
+bool Parser::spill_epns(epn_set_t& epns)
+{
+    if (!spilled_epns)
+    {
+        spilled_epns = std::make_unique<EPNSpill>(spill_directory);
+    }
+
+    if (!spilled_epns->write_run(epns))
+    {
+        std::cerr << "Error: unable to spill EPNs, keeping them in memory" << std::endl;
+        spill_failed = true;
+        return false;
+    }
+
+    epns = epn_set_t();
+
+    return true;
+}
+
+/**
+ * @brief Spills the EPNs that are still in memory and merges all runs into
+ * one without duplicates. If either fails, the runs are removed and the parse
+ * is stopped with the reason 'failed', as the result then lacks the EPNs of
+ * the runs: all EPNs if the merge failed, as the last spill emptied the set,
+ * or those of the earlier runs if the last spill failed.
+ *
+ * @param epns EPNs of the result, emptied if the last spill succeeds.
+ */
+void Parser::merge_spilled_epns(epn_set_t& epns)
+{
+    if (spill_epns(epns) && spilled_epns->merge())
+    {
+        return;
+    }
+
+    std::cerr << "Error: unable to merge the spilled EPNs, the result is incomplete" << std::endl;
+    spilled_epns.reset();
+    stop("failed");
+}
@@ -7,10 +7,69 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <utility>
 #include "descriptor.hpp"
 #include "epn.hpp"
 #include "grammar.hpp"
+#include "worklist.hpp"
 #include "../utilities/timer.hpp"
+#include "../utilities/statistics.hpp"
+#include "../utilities/phases.hpp"
+#include "../utilities/worker_threads.hpp"
+#include "../utilities/epn_spill.hpp"
+
+/* Number of descriptors between two checks of the time limit of a parse. */
+#define LIMIT_CHECK_INTERVAL 64
+
+/**
+ * Edit of an input: replaces the tokens from begin up to end by new tokens.
+ */
+struct TokenEdit
+{
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<std::string> tokens;
+
+    bool is_valid(size_t input_length) const { return begin <= end && end <= input_length; }
+    std::vector<std::string> apply(const std::vector<std::string>& input) const;
+};
+
+/**
+ * Result of a parse: its descriptors and EPNs. The parsers move their sets
+ * into the result, and the result can only be moved, so that a large result
+ * is never copied by accident.
+ */
+struct ParseResult
+{
+    descriptor_set_t descriptors;
+    epn_set_t epns;
+    /* Compiled grammar that the slots of the descriptors and EPNs point into,
+       kept alive for as long as the result, even after the parser is gone. */
+    std::shared_ptr<const CompiledGrammar> grammar;
+
+    ParseResult() = default;
+    ParseResult(descriptor_set_t&& d, epn_set_t&& e) : descriptors(std::move(d)), epns(std::move(e)) {};
+    ParseResult(ParseResult&&) = default;
+    ParseResult& operator=(ParseResult&&) = default;
+    ParseResult(const ParseResult&) = delete;
+    ParseResult& operator=(const ParseResult&) = delete;
+};
+
+/**
+ * Token that another thread cancels to stop the parses that check it. A
+ * token can be shared by several parsers.
+ */
+class CancellationToken
+{
+private:
+    std::atomic<bool> cancelled{false};
+public:
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    void reset() { cancelled.store(false, std::memory_order_relaxed); }
+    bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+};
 
 /**
  * Base class for all parsers.
@@ -24,11 +83,163 @@ public:
     Grammar grammar;
     /* Timer used for experiments. */
     Timer timer;
+    /* Statistics collected during the last parse. */
+    Statistics statistics;
+    /* Wall time of the phases of the last parse. */
+    PhaseTimer phases;
+    /* Whether parse() prints the data for experiments. */
+    bool print_experiment_data = true;
+    /* Whether parse() prints the statistics as JSON. */
+    bool print_statistics = false;
+    /* Bytes the EPN set may take before its EPNs are spilled to disk, or 0
+       to keep all EPNs in memory. */
+    size_t memory_budget = 0;
+    /* Directory of the files of spilled EPNs. */
+    std::string spill_directory = "/tmp";
+    /* Limits of a parse, or 0 for no limit: its wall time in milliseconds,
+       the descriptors taken from the worklists by all threads together, and
+       the bytes of its EPN set in memory. A parse that exceeds a limit stops
+       with the descriptors and EPNs found so far. */
+    double time_limit = 0;
+    unsigned long descriptor_limit = 0;
+    size_t memory_limit = 0;
+    /* Token that stops the parse when it is cancelled, or nullptr. */
+    std::shared_ptr<CancellationToken> cancellation;
+    /* Policy of the worklists of the parsers that have them. */
+    std::string worklist_policy = DEFAULT_WORKLIST_POLICY;
+private:
+    /* EPNs of the last parse that were spilled to disk. */
+    std::unique_ptr<EPNSpill> spilled_epns;
+    /* Whether spilling failed during the current parse. */
+    bool spill_failed = false;
+    /* Whether the current parse must stop, and the number of times its
+       threads checked the limits. */
+    std::atomic<bool> stopped{false};
+    std::atomic<unsigned long> num_checks{0};
+protected:
+    /* Threads of the parallel parsers, kept between parses. */
+    WorkerThreads worker_threads;
 public:
     Parser(Grammar g);
+    virtual ~Parser() = default;
 public:
-    std::tuple<descriptor_set_t, epn_set_t> parse(std::vector<std::string> input_sequence);
+    ParseResult parse(std::vector<std::string> input_sequence);
+    virtual ParseResult reparse(
+        const std::vector<std::string>& previous_input,
+        const ParseResult& previous_result,
+        const TokenEdit& edit
+    );
+
+    /**
+     * @return EPNs of the last parse that were spilled to disk, merged into
+     * one sorted run, or nullptr if the EPNs of the last parse fit in memory.
+     * The EPN set returned by parse() is empty if they were spilled.
+     */
+    const EPNSpill* get_spilled_epns() const { return spilled_epns.get(); }
+protected:
+    /**
+     * @brief Spills the EPNs to disk if they take more memory than the budget,
+     * and stops the parse if they take more than its memory limit. Called by
+     * the parsers after adding EPNs, with the EPN set locked.
+     *
+     * @param epns EPN set of the parser.
+     */
+    void enforce_memory_budget(epn_set_t& epns)
+    {
+        if (memory_limit > 0 && epns.memory_usage() > memory_limit)
+        {
+            stop("memory");
+        }
+
+        if (memory_budget > 0 && !spill_failed && epns.memory_usage() > memory_budget)
+        {
+            spill_epns(epns);
+        }
+    }
+
+    /**
+     * @brief Adds the growth of the EPN set of one part of a parse, such as a
+     * chunk or a shard, to the bytes of the EPN sets of all parts. For the
+     * parsers whose parts keep their own EPN set until the parse is done.
+     *
+     * @param epns EPN set of the part.
+     * @param counted Bytes of the set that were counted already, updated.
+     * @param total Bytes of the EPN sets of all parts.
+     *
+     * @return True if the set grew and all sets together take more than the
+     * memory limit, false otherwise.
+     */
+    bool count_epn_memory(const epn_set_t& epns, size_t& counted, std::atomic<size_t>& total) const
+    {
+        size_t bytes = epns.memory_usage();
+
+        if (memory_limit == 0 || bytes == counted)
+        {
+            return false;
+        }
+
+        /* Wraps around like the counter itself when the set shrinks. */
+        size_t sum = total.fetch_add(bytes - counted, std::memory_order_relaxed) + (bytes - counted);
+        counted = bytes;
+
+        return sum > memory_limit;
+    }
+
+    /**
+     * @brief Checks the limits of the parse. Called by the parsers before they
+     * process a descriptor, from any thread. Only counts the descriptor and
+     * checks the cancellation token, and the wall time every
+     * LIMIT_CHECK_INTERVAL descriptors, so the check is cheap.
+     *
+     * @return True if the parse must stop, false otherwise.
+     */
+    bool should_stop()
+    {
+        if (stopped.load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+
+        unsigned long count = num_checks.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        if (descriptor_limit > 0 && count > descriptor_limit)
+        {
+            return stop("descriptors");
+        }
+
+        if (cancellation && cancellation->is_cancelled())
+        {
+            return stop("cancelled");
+        }
+
+        if (time_limit > 0 && count % LIMIT_CHECK_INTERVAL == 0 && timer.elapsedMilliseconds() > time_limit)
+        {
+            return stop("time");
+        }
+
+        return false;
+    }
+
+    /**
+     * @return True if the parse has been stopped, false otherwise.
+     */
+    bool is_stopped() const { return stopped.load(std::memory_order_relaxed); }
+
+    bool stop(const std::string& reason);
+
+    /**
+     * @param epns EPN set of the parser.
+     *
+     * @return Number of EPNs found by the last parse, including those spilled.
+     */
+    size_t num_epns(const epn_set_t& epns) const
+    {
+        return spilled_epns ? spilled_epns->size() : epns.size();
+    }
 private:
-    virtual std::tuple<descriptor_set_t, epn_set_t> loop() = 0;
-    virtual void print_data() = 0;
+    bool spill_epns(epn_set_t& epns);
+    void merge_spilled_epns(epn_set_t& epns);
+    virtual void loop() = 0;
+    virtual ParseResult get_result() = 0;
+    virtual void print_data(const ParseResult& result) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Contains the grammar slot, a production rule with a dot in its right-hand
+ *   side. Slots are created once when a grammar is compiled, so that
+ *   descriptors and EPNs only need to refer to them.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * Represents a grammar slot of a compiled grammar.
+ */
+struct GrammarSlot
+{
+    /* Index of the slot in the compiled grammar. */
+    unsigned int id;
+    /* Left-hand side of the production rule. */
+    std::string lhs;
+    /* Right-hand side of the production rule. */
+    std::vector<std::string> rhs;
+    /* Position of the dot in the right-hand side. */
+    unsigned int dot_position;
+    /* Symbol after the dot. Empty if the slot is completed. */
+    std::string next_symbol;
+    /* Symbol ids of the left-hand side and the symbol after the dot. */
+    unsigned int lhs_id;
+    unsigned int next_symbol_id;
+    /* Whether the dot is at the end of the right-hand side. */
+    bool completed;
+    /* Whether the symbol after the dot is a terminal. */
+    bool next_is_terminal;
+    /* Slot with the dot advanced by one position. Null if completed. */
+    const GrammarSlot* next;
+};
@@ -0,0 +1,141 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the worklist and its policies.
+ */
+
+#include "worklist.hpp"
+#include <algorithm>
+
+/**
+ * @brief Constructs an empty worklist.
+ *
+ * @param p Policy of the worklist, one of those for which is_policy() holds.
+ * @param d Whether to reject descriptors that are in the worklist already.
+ *          If not, the caller must never add a descriptor twice.
+ */
+Worklist::Worklist(const std::string& p, bool d) : policy(p), deduplicate(d)
+{
+    hashed = policy == "hash";
+    queued = policy == "fifo" || policy == "lifo";
+    bucketed = policy == "extent" || policy == "slot";
+    from_back = policy == "lifo";
+    by_slot = policy == "slot";
+}
+
+/**
+ * @return Whether a name is the name of a worklist policy.
+ */
+bool Worklist::is_policy(const std::string& name)
+{
+    return name == "hash" || name == "fifo" || name == "lifo" || name == "extent" || name == "slot";
+}
+
+/**
+ * @return Index of the bucket of a descriptor: its slot id or right extent.
+ */
+size_t Worklist::bucket_of(const Descriptor& descriptor) const
+{
+    return by_slot ? descriptor.slot->id : descriptor.right_extent;
+}
+
+/**
+ * @brief Adds a descriptor to the worklist if it is not in the worklist yet,
+ * or without checking if the worklist does not deduplicate.
+ *
+ * @param descriptor Descriptor to add.
+ *
+ * @return True if the descriptor was added, false if it was already there.
+ */
+bool Worklist::insert(const Descriptor& descriptor)
+{
+    if ((deduplicate || hashed) && !pending.insert(descriptor).second)
+    {
+        return false;
+    }
+
+    num_descriptors++;
+
+    if (queued)
+    {
+        queue.push_back(descriptor);
+    }
+    else if (bucketed)
+    {
+        size_t bucket = bucket_of(descriptor);
+
+        if (bucket >= buckets.size())
+        {
+            buckets.resize(bucket + 1);
+        }
+
+        buckets[bucket].push_back(descriptor);
+        next_bucket = std::min(next_bucket, bucket);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Removes the next descriptor from the worklist, which must not be
+ * empty. Within a bucket, the last added descriptor is taken first.
+ *
+ * @return The descriptor.
+ */
+Descriptor Worklist::take()
+{
+    Descriptor descriptor;
+
+    if (queued && from_back)
+    {
+        descriptor = queue.back();
+        queue.pop_back();
+    }
+    else if (queued)
+    {
+        descriptor = queue.front();
+        queue.pop_front();
+    }
+    else if (bucketed)
+    {
+        while (buckets[next_bucket].empty())
+        {
+            next_bucket++;
+        }
+
+        descriptor = buckets[next_bucket].back();
+        buckets[next_bucket].pop_back();
+    }
+    else
+    {
+        descriptor = *pending.begin();
+    }
+
+    if (deduplicate || hashed)
+    {
+        pending.erase(descriptor);
+    }
+
+    num_descriptors--;
+
+    return descriptor;
+}
+
+/**
+ * @brief Removes all descriptors from the worklist. Keeps the memory of the
+ * buckets for the next parse.
+ */
+void Worklist::clear()
+{
+    pending.clear();
+    num_descriptors = 0;
+    queue.clear();
+
+    for (auto& bucket : buckets)
+    {
+        bucket.clear();
+    }
+
+    next_bucket = 0;
+}
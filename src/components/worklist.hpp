@@ -0,0 +1,84 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Contains the worklist of the parsers: the descriptors that still have to
+ *   be processed. A descriptor is in the worklist at most once. The order in
+ *   which descriptors are taken is set by the policy of the worklist, which
+ *   affects the cache locality of a parse and, in the parallel parsers, how
+ *   often a descriptor is processed by more than one thread.
+ *   A worklist that does not deduplicate leaves that to its parser, which
+ *   then only adds descriptors it has not seen before. It keeps no hash set,
+ *   so adding and taking a descriptor costs no hashing.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "descriptor.hpp"
+#include "../utilities/types.hpp"
+
+/* Policy of the worklists of a parser if none is chosen. */
+#define DEFAULT_WORKLIST_POLICY "hash"
+
+/* The sequential, dense, pool and chunked parsers insert a descriptor into
+   their set of descriptors when it is discovered, like the U set of GLL,
+   instead of when it is taken from the worklist. Only new descriptors are
+   added to the worklist, which then does not deduplicate. */
+// #define OPTIMISATION_INSERT_ON_DISCOVER
+
+/**
+ * Set of descriptors that are taken one at a time, in the order of a policy:
+ *   hash    In the order of the hash set. Cheapest, but arbitrary.
+ *   fifo    In the order they were added.
+ *   lifo    The last added descriptor first.
+ *   extent  By increasing right extent.
+ *   slot    By slot, so that descriptors of the same slot are taken together.
+ */
+class Worklist
+{
+private:
+    std::string policy;
+    /* Whether descriptors that are in the worklist already are rejected. */
+    bool deduplicate = true;
+    /* Descriptors in the worklist, if it deduplicates or its policy is
+       'hash', and the number of descriptors. */
+    descriptor_set_t pending;
+    size_t num_descriptors = 0;
+    /* Order of the descriptors, for the 'fifo' and 'lifo' policies. */
+    std::deque<Descriptor> queue;
+    /* Descriptors by right extent or slot id, for the 'extent' and 'slot'
+       policies, and the smallest index that may have descriptors. */
+    std::vector<std::vector<Descriptor>> buckets;
+    size_t next_bucket = 0;
+    /* Whether the descriptors are taken from the hash set, the queue or the
+       buckets, whether the queue is taken from its back and whether the
+       buckets are by slot. */
+    bool hashed = false;
+    bool queued = false;
+    bool bucketed = false;
+    bool from_back = false;
+    bool by_slot = false;
+public:
+    Worklist(const std::string& p = DEFAULT_WORKLIST_POLICY, bool d = true);
+public:
+    bool insert(const Descriptor& descriptor);
+    Descriptor take();
+    void clear();
+    size_t size() const { return num_descriptors; }
+    bool empty() const { return num_descriptors == 0; }
+    const std::string& get_policy() const { return policy; }
+
+    /**
+     * @return Iterators over the descriptors in the worklist, in no order.
+     * Only for a worklist that deduplicates.
+     */
+    descriptor_set_t::iterator begin() const { return pending.begin(); }
+    descriptor_set_t::iterator end() const { return pending.end(); }
+
+    static bool is_policy(const std::string& name);
+private:
+    size_t bucket_of(const Descriptor& descriptor) const;
+};
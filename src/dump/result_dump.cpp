@@ -0,0 +1,82 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Reads a binary result file, written by 'main --output', and prints its
+ *   EPNs and descriptors as text, sorted by slot and extents. The text of two
+ *   results of the same grammar can be compared with diff. With '--summary',
+ *   only the input length, the numbers of descriptors and EPNs, and whether
+ *   the input was recognised are printed.
+ */
+
+#include <iostream>
+#include "../utilities/result_file.hpp"
+#include "../utilities/checks.hpp"
+
+/**
+ * @brief Prints the usage of the tool.
+ */
+void print_usage()
+{
+    std::cout << "Usage: result_dump [options] <result_file>\n"
+              << "  --summary               Only print the input length, the numbers of\n"
+              << "                          descriptors and EPNs, and whether the input\n"
+              << "                          was recognised.\n";
+}
+
+int main(int argc, char const *argv[])
+{
+    bool summary = false;
+    std::string file_name;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+
+        if (argument == "--summary")
+        {
+            summary = true;
+        }
+        else if (argument == "--help")
+        {
+            print_usage();
+            return 0;
+        }
+        else if (argument.rfind("--", 0) == 0 || !file_name.empty())
+        {
+            std::cerr << "Error: unknown argument '" << argument << "'" << std::endl;
+            return 1;
+        }
+        else
+        {
+            file_name = argument;
+        }
+    }
+
+    if (file_name.empty())
+    {
+        print_usage();
+        return 1;
+    }
+
+    ResultFile result;
+
+    if (!read_result_file(file_name, result))
+    {
+        return 1;
+    }
+
+    if (summary)
+    {
+        std::cout << "length: " << result.input_length << "\n"
+                  << "descriptors: " << result.descriptors.size() << "\n"
+                  << "epns: " << result.epns.size() << "\n"
+                  << "recognised: " << is_recognised(result.descriptors, result.grammar, result.input_length) << std::endl;
+
+        return 0;
+    }
+
+    write_result_text(std::cout, result.descriptors, result.epns);
+
+    return 0;
+}
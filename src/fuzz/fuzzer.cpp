@@ -0,0 +1,582 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Differential fuzzer for the parser engines. Each iteration generates a
+ *   random grammar and a sentence, which is either derived from the grammar
+ *   or a random sequence of its terminals. The sentence is parsed by the
+ *   sequential parser, whose output is the reference, and by each parallel
+ *   engine in a separate process. The output of a parallel engine must equal
+ *   the reference and satisfy the correctness checker. Failing cases, and
+ *   cases where a parallel engine is much slower than the sequential parser,
+ *   are saved in the layout of the experiments directory, so that they can be
+ *   reproduced with 'main' and 'benchmark'. Iteration i uses the seed
+ *   <seed> + i, so a single iteration can also be rerun with '--seed'.
+ *   Run 'fuzzer --help' for the available options.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../parsers/parsers.hpp"
+#include "../utilities/checks.hpp"
+
+/**
+ * Options of the fuzzer.
+ */
+struct FuzzOptions
+{
+    /* Number of generated cases. */
+    unsigned long iterations = 100;
+    /* Seed of the first case. */
+    unsigned long seed = 0;
+    /* Engines to compare against the sequential parser. */
+    std::vector<std::string> engines = { "pool", "tree" };
+    /* Number of threads of the parallel engines. */
+    unsigned int num_threads = 4;
+    /* Maximum number of nonterminals, terminals and rules per nonterminal. */
+    unsigned int max_nonterminals = 4;
+    unsigned int max_terminals = 3;
+    unsigned int max_rules = 3;
+    /* Maximum length of the right-hand side of a rule. */
+    unsigned int max_rhs = 3;
+    /* Maximum length of a sentence. */
+    unsigned int max_length = 8;
+    /* Time limit of a parallel engine in seconds. */
+    unsigned int timeout = 10;
+    /* A parallel engine that is this many times slower than the sequential parser is an outlier. */
+    double slowdown = 20;
+    /* Parallel parse times below this time in milliseconds are never outliers. */
+    double min_time = 100;
+    /* Directory to save failing and slow cases in. */
+    std::string output = "fuzz-cases";
+};
+
+/**
+ * A generated grammar and sentence.
+ */
+struct FuzzCase
+{
+    /* Rules of the grammar in the format of a grammar file, start symbol first. */
+    std::vector<production_rule_t> rules;
+    std::vector<std::string> input;
+    Grammar grammar;
+};
+
+/**
+ * Comparison of the output of an engine with the reference, sent from the
+ * child process to the parent.
+ */
+struct FuzzOutput
+{
+    double time;
+    size_t missing_descriptors;
+    size_t extra_descriptors;
+    size_t missing_epns;
+    size_t extra_epns;
+    bool correct;
+};
+
+/**
+ * @brief Splits a string on commas.
+ *
+ * @param value String to split.
+ *
+ * @return Vector of the parts.
+ */
+std::vector<std::string> split(std::string value)
+{
+    std::vector<std::string> parts;
+    std::stringstream ss(value);
+    std::string part;
+
+    while (std::getline(ss, part, ','))
+    {
+        parts.push_back(part);
+    }
+
+    return parts;
+}
+
+/**
+ * @brief Prints the usage of the fuzzer.
+ */
+void print_usage()
+{
+    std::cout << "Usage: fuzzer [options]\n"
+              << "  --iterations <n>        Number of generated cases. Default: 100.\n"
+              << "  --seed <n>              Seed of the first case. Default: current time.\n"
+              << "  --engines <list>        Comma-separated engines to compare. Default: pool,tree.\n"
+              << "  --threads <n>           Threads of the parallel engines. Default: 4.\n"
+              << "  --nonterminals <n>      Maximum number of nonterminals. Default: 4.\n"
+              << "  --terminals <n>         Maximum number of terminals. Default: 3.\n"
+              << "  --rules <n>             Maximum number of rules per nonterminal. Default: 3.\n"
+              << "  --rhs <n>               Maximum length of a right-hand side. Default: 3.\n"
+              << "  --max-length <n>        Maximum length of a sentence. Default: 8.\n"
+              << "  --timeout <s>           Time limit of a parallel engine. Default: 10.\n"
+              << "  --slowdown <factor>     Slowdown that counts as an outlier. Default: 20.\n"
+              << "  --min-time <ms>         Faster parses are never outliers. Default: 100.\n"
+              << "  --output <dir>          Directory to save cases in. Default: fuzz-cases.\n";
+}
+
+/**
+ * @brief Reads the options from the command line arguments.
+ *
+ * @param argc Amount of arguments.
+ * @param argv Array of arguments.
+ * @param options Options to fill in.
+ *
+ * @return True if the arguments are valid, false otherwise.
+ */
+bool parse_fuzz_arguments(int argc, char const *argv[], FuzzOptions& options)
+{
+    options.seed = static_cast<unsigned long>(std::chrono::system_clock::now().time_since_epoch().count());
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+
+        if (argument == "--help" || i + 1 >= argc)
+        {
+            print_usage();
+            return false;
+        }
+
+        std::string value(argv[++i]);
+
+        try
+        {
+            if (argument == "--iterations") options.iterations = std::stoul(value);
+            else if (argument == "--seed") options.seed = std::stoul(value);
+            else if (argument == "--engines") options.engines = split(value);
+            else if (argument == "--threads") options.num_threads = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--nonterminals") options.max_nonterminals = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--terminals") options.max_terminals = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--rules") options.max_rules = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--rhs") options.max_rhs = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--max-length") options.max_length = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--timeout") options.timeout = static_cast<unsigned int>(std::stoul(value));
+            else if (argument == "--slowdown") options.slowdown = std::stod(value);
+            else if (argument == "--min-time") options.min_time = std::stod(value);
+            else if (argument == "--output") options.output = value;
+            else
+            {
+                std::cerr << "Error: unknown option '" << argument << "'" << std::endl;
+                return false;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: invalid value '" << value << "' for option '" << argument << "'" << std::endl;
+            return false;
+        }
+    }
+
+    for (auto engine : options.engines)
+    {
+        if (!is_parser_engine(engine))
+        {
+            std::cerr << "Error: unknown engine '" << engine << "'" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.num_threads == 0 || options.max_nonterminals == 0 || options.max_terminals == 0
+        || options.max_rules == 0 || options.max_length == 0)
+    {
+        std::cerr << "Error: threads, nonterminals, terminals, rules and length must be positive" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Random number in a closed range.
+ *
+ * @param random Random number generator.
+ * @param min Lower bound.
+ * @param max Upper bound.
+ *
+ * @return The random number.
+ */
+unsigned int uniform(std::mt19937& random, unsigned int min, unsigned int max)
+{
+    return std::uniform_int_distribution<unsigned int>(min, max)(random);
+}
+
+/**
+ * @brief Derives a sentence from a symbol by choosing random rules. Once the
+ * depth limit is reached, the shortest rule is chosen.
+ *
+ * @param fuzz_case Case with the grammar to derive from.
+ * @param symbol Symbol to derive.
+ * @param depth Depth of the symbol in the derivation.
+ * @param max_length Maximum length of the sentence.
+ * @param random Random number generator.
+ * @param sentence Sentence to add the derived terminals to.
+ *
+ * @return False if the derivation exceeds the maximum length or depth.
+ */
+bool derive(FuzzCase& fuzz_case, std::string symbol, unsigned int depth, unsigned int max_length, std::mt19937& random, std::vector<std::string>& sentence)
+{
+    if (fuzz_case.grammar.terminals.count(symbol))
+    {
+        sentence.push_back(symbol);
+        return sentence.size() <= max_length;
+    }
+
+    if (depth > 4 * max_length)
+    {
+        return false;
+    }
+
+    auto rules = fuzz_case.grammar.get_production_rules(symbol);
+    auto rule = rules[uniform(random, 0, static_cast<unsigned int>(rules.size() - 1))];
+
+    if (depth > max_length)
+    {
+        rule = *std::min_element(rules.begin(), rules.end(), [](auto& first, auto& second) {
+            return first.second.size() < second.second.size();
+        });
+    }
+
+    for (auto& rhs_symbol : rule.second)
+    {
+        if (!derive(fuzz_case, rhs_symbol, depth + 1, max_length, random, sentence))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Generates a random grammar and sentence. The grammar is built in the
+ * same way as a grammar file is read: the first nonterminal is the start
+ * symbol, and every symbol without rules is a terminal.
+ *
+ * @param options Fuzzer options.
+ * @param seed Seed of the case.
+ *
+ * @return The generated case.
+ */
+FuzzCase generate_case(FuzzOptions& options, unsigned long seed)
+{
+    std::mt19937 random(static_cast<std::mt19937::result_type>(seed));
+    FuzzCase fuzz_case;
+    std::vector<std::string> nonterminals;
+    std::vector<std::string> symbols;
+    unsigned int num_nonterminals = uniform(random, 1, options.max_nonterminals);
+    unsigned int num_terminals = uniform(random, 1, options.max_terminals);
+
+    for (unsigned int i = 0; i < num_nonterminals; i++)
+    {
+        nonterminals.push_back(std::string(1, static_cast<char>('A' + i % 26)) + (i >= 26 ? std::to_string(i / 26) : ""));
+    }
+
+    symbols = nonterminals;
+
+    for (unsigned int i = 0; i < num_terminals; i++)
+    {
+        symbols.push_back(std::string(1, static_cast<char>('a' + i % 26)) + (i >= 26 ? std::to_string(i / 26) : ""));
+    }
+
+    for (auto& lhs : nonterminals)
+    {
+        fuzz_case.grammar.add_nonterminal(lhs);
+    }
+
+    fuzz_case.grammar.set_start_symbol(nonterminals[0]);
+
+    for (auto& lhs : nonterminals)
+    {
+        unsigned int num_rules = uniform(random, 1, options.max_rules);
+
+        for (unsigned int i = 0; i < num_rules; i++)
+        {
+            std::vector<std::string> rhs;
+            unsigned int length = uniform(random, 0, options.max_rhs);
+
+            for (unsigned int j = 0; j < length; j++)
+            {
+                rhs.push_back(symbols[uniform(random, 0, static_cast<unsigned int>(symbols.size() - 1))]);
+            }
+
+            fuzz_case.rules.emplace_back(lhs, rhs);
+            fuzz_case.grammar.add_production_rule(lhs, rhs);
+        }
+    }
+
+    for (auto& rule : fuzz_case.rules)
+    {
+        for (auto& symbol : rule.second)
+        {
+            if (!fuzz_case.grammar.production_rules.count(symbol) && !fuzz_case.grammar.terminals.count(symbol))
+            {
+                fuzz_case.grammar.add_terminal(symbol);
+            }
+        }
+    }
+
+    fuzz_case.grammar.compile();
+
+    /* Half of the sentences are derived from the grammar, so that they are likely to be recognised. */
+    if (uniform(random, 0, 1) == 0 && !fuzz_case.grammar.terminals.empty())
+    {
+        derive(fuzz_case, nonterminals[0], 0, options.max_length, random, fuzz_case.input);
+    }
+
+    if (fuzz_case.input.empty() || fuzz_case.input.size() > options.max_length)
+    {
+        unsigned int length = uniform(random, 1, options.max_length);
+
+        fuzz_case.input.clear();
+
+        for (unsigned int i = 0; i < length; i++)
+        {
+            fuzz_case.input.push_back(symbols[uniform(random, num_nonterminals, static_cast<unsigned int>(symbols.size() - 1))]);
+        }
+    }
+
+    return fuzz_case;
+}
+
+/**
+ * @brief Counts the items of a reference set that are missing from a result
+ * set, and the items of the result set that are not in the reference.
+ *
+ * @param reference Reference set.
+ * @param result Result set.
+ * @param missing Variable to store the number of missing items in.
+ * @param extra Variable to store the number of extra items in.
+ */
+template <typename Set>
+void compare_sets(const Set& reference, const Set& result, size_t& missing, size_t& extra)
+{
+    missing = 0;
+
+    for (auto& item : reference)
+    {
+        if (!result.count(item))
+        {
+            missing++;
+        }
+    }
+
+    extra = result.size() - (reference.size() - missing);
+}
+
+/**
+ * @brief Parses the case with an engine in a child process, and compares the
+ * output with the reference output. The standard output of the child, which
+ * receives the messages of the correctness checker, is discarded.
+ *
+ * @param options Fuzzer options.
+ * @param fuzz_case Case to parse.
+ * @param engine Engine to use.
+ * @param reference Output of the sequential parser.
+ * @param output Comparison to fill in.
+ *
+ * @return 'ok', 'mismatch', 'incorrect', 'timeout' or 'crash'.
+ */
+std::string run_engine(
+    FuzzOptions& options,
+    FuzzCase& fuzz_case,
+    std::string engine,
+    ParseResult& reference,
+    FuzzOutput& output
+)
+{
+    int fds[2];
+
+    if (pipe(fds) != 0)
+    {
+        return "crash";
+    }
+
+    std::cout.flush();
+
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+
+        close(fds[0]);
+        dup2(null_fd, STDOUT_FILENO);
+        alarm(options.timeout);
+
+        auto parser = make_parser(engine, fuzz_case.grammar, options.num_threads);
+        parser->print_experiment_data = false;
+
+        auto result = parser->parse(fuzz_case.input);
+        FuzzOutput run = {};
+
+        run.time = parser->timer.elapsedMilliseconds();
+        compare_sets(reference.descriptors, result.descriptors, run.missing_descriptors, run.extra_descriptors);
+        compare_sets(reference.epns, result.epns, run.missing_epns, run.extra_epns);
+        run.correct = check_correctness(result.descriptors, result.epns, fuzz_case.grammar, fuzz_case.input, 1);
+
+        if (write(fds[1], &run, sizeof(run)) != sizeof(run))
+        {
+            _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    int status = 0;
+    bool received = pid > 0 && read(fds[0], &output, sizeof(output)) == sizeof(output);
+
+    close(fds[0]);
+
+    if (pid < 0 || waitpid(pid, &status, 0) < 0)
+    {
+        return "crash";
+    }
+
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+    {
+        return "timeout";
+    }
+
+    if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        return "crash";
+    }
+
+    if (output.missing_descriptors || output.extra_descriptors || output.missing_epns || output.extra_epns)
+    {
+        return "mismatch";
+    }
+
+    return output.correct ? "ok" : "incorrect";
+}
+
+/**
+ * @brief Saves a case in the layout of an experiment: '<output>/<name>/<name>.gr'
+ * and '<output>/<name>/input/len<n>.input', together with a 'reason.txt' file
+ * that describes why the case was saved.
+ *
+ * @param options Fuzzer options.
+ * @param fuzz_case Case to save.
+ * @param name Name of the experiment.
+ * @param reason Description of the failure or slowdown.
+ *
+ * @return Directory of the saved case.
+ */
+std::string save_case(FuzzOptions& options, FuzzCase& fuzz_case, std::string name, std::string reason)
+{
+    std::filesystem::path directory = std::filesystem::path(options.output) / name;
+
+    std::filesystem::create_directories(directory / "input");
+
+    std::ofstream grammar_file(directory / (name + ".gr"));
+
+    for (auto& rule : fuzz_case.rules)
+    {
+        grammar_file << rule.first;
+
+        for (auto& symbol : rule.second)
+        {
+            grammar_file << " " << symbol;
+        }
+
+        grammar_file << std::endl;
+    }
+
+    std::ofstream input_file(directory / "input" / ("len" + std::to_string(fuzz_case.input.size()) + ".input"));
+
+    for (size_t i = 0; i < fuzz_case.input.size(); i++)
+    {
+        input_file << (i ? " " : "") << fuzz_case.input[i];
+    }
+
+    input_file << std::endl;
+
+    std::ofstream reason_file(directory / "reason.txt");
+
+    reason_file << reason << std::endl;
+
+    return directory.string();
+}
+
+int main(int argc, char const *argv[])
+{
+    FuzzOptions options;
+    unsigned long failures = 0;
+    unsigned long outliers = 0;
+
+    if (!parse_fuzz_arguments(argc, argv, options))
+    {
+        return 1;
+    }
+
+    std::cerr << "Seed: " << options.seed << std::endl;
+    std::cout << "seed,length,engine,threads,sequential_ms,engine_ms,status" << std::endl;
+
+    for (unsigned long i = 0; i < options.iterations; i++)
+    {
+        unsigned long seed = options.seed + i;
+        auto fuzz_case = generate_case(options, seed);
+        auto reference_parser = make_parser("sequential", fuzz_case.grammar, 1);
+        reference_parser->print_experiment_data = false;
+        auto reference = reference_parser->parse(fuzz_case.input);
+        double reference_time = reference_parser->timer.elapsedMilliseconds();
+
+        for (auto engine : options.engines)
+        {
+            FuzzOutput output = {};
+            std::string status = run_engine(options, fuzz_case, engine, reference, output);
+            std::stringstream reason;
+
+            if (status == "ok" && output.time >= options.min_time && output.time > options.slowdown * reference_time)
+            {
+                status = "slow";
+            }
+
+            std::cout << seed << "," << fuzz_case.input.size() << "," << engine << "," << options.num_threads
+                      << "," << reference_time << "," << output.time << "," << status << std::endl;
+
+            if (status == "ok")
+            {
+                continue;
+            }
+
+            reason << "engine " << engine << ", threads " << options.num_threads << ", seed " << seed
+                   << ": " << status << std::endl
+                   << "sequential " << reference_time << " ms, " << engine << " " << output.time << " ms" << std::endl
+                   << "descriptors missing " << output.missing_descriptors << ", extra " << output.extra_descriptors
+                   << "; EPNs missing " << output.missing_epns << ", extra " << output.extra_epns;
+
+            auto directory = save_case(options, fuzz_case, "seed" + std::to_string(seed) + "_" + engine + "_" + status, reason.str());
+
+            std::cerr << "Saved " << status << " case: " << directory << std::endl;
+
+            if (status == "slow")
+            {
+                outliers++;
+            }
+            else
+            {
+                failures++;
+            }
+        }
+    }
+
+    std::cerr << "Failures: " << failures << ", outliers: " << outliers << std::endl;
+
+    return failures ? 1 : 0;
+}
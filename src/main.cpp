@@ -7,27 +7,39 @@
  *   be formatted in the following way: <lhs> <rhs1> <rhs2> ... <rhsn>.
  *   The second argument is either a file that contains the input string or the
  *   input string itself. The symbols must be separated by spaces.
+ *   With '--batch', the remaining arguments are input files or directories
+ *   of input files, which are all parsed against the grammar. With '--server',
+ *   only the grammar is given and inputs are read as parse requests.
+ *   See 'utilities/argparse.cpp' for the available options.
  */
 
 #include <iostream>
+#include <fstream>
 #include "utilities/argparse.hpp"
 #include "utilities/print.hpp"
 #include "utilities/checks.hpp"
+#include "utilities/result_file.hpp"
 #include "components/grammar.hpp"
-#include "parsers/sequential/sequential_parser.hpp"
-#include "parsers/parallel_pool/parallel_pool.hpp"
-#include "parsers/parallel_tree/parallel_tree.hpp"
+#include "parsers/parsers.hpp"
+#include "modes/batch.hpp"
+#include "modes/server.hpp"
 
 /**
  * @brief Validates the correctness of the results.
  *
- * @param result Tuple containing the results.
+ * @param result Descriptors and EPNs of the parse.
  * @param input Input sequence.
  * @param grammar Input grammar.
+ * @param num_threads Number of threads used by the checker.
  */
-void validate_result(std::tuple<descriptor_set_t, epn_set_t> result, std::vector<std::string> input, Grammar grammar)
+void validate_result(
+    const ParseResult& result,
+    const std::vector<std::string>& input,
+    Grammar& grammar,
+    unsigned int num_threads
+)
 {
-    bool success = check_correctness(std::get<0>(result), std::get<1>(result), grammar, input);
+    bool success = check_correctness(result.descriptors, result.epns, grammar, input, num_threads);
 
     if (success)
     {
@@ -39,34 +51,115 @@ void validate_result(std::tuple<descriptor_set_t, epn_set_t> result, std::vector
  * @brief Print the EPNs and descriptors for the parser.
  *
  * @param title Title of the results.
- * @param result Tuple containing the results.
+ * @param result Descriptors and EPNs of the parse.
  */
-void print_result(std::string title, std::tuple<descriptor_set_t, epn_set_t> result)
+void print_result(std::string title, const ParseResult& result)
 {
     std::cout << title << std::endl;
     std::cout << "EPNs:" << std::endl;
-    print_epns(std::get<1>(result));
+    print_epns(result.epns);
     std::cout << "Descriptors:" << std::endl;
-    print_descriptors(std::get<0>(result));
+    print_descriptors(result.descriptors);
 }
 
 int main(int argc, char const *argv[])
 {
     auto args = parse_arguments(argc, argv);
-    auto grammar = std::get<0>(args);
-    auto input_string = std::get<1>(args);
+    auto grammar = args.grammar;
+    auto input_string = args.input;
 
-    if (!std::get<2>(args))
+    if (!args.success)
     {
         return 1;
     }
 
+    if (args.batch)
+    {
+        return run_batch(args);
+    }
+
+    if (args.server)
+    {
+        return run_server(args);
+    }
+
     /* Call the parser. */
-    ThreadPoolParser parser(grammar);
-    auto result = parser.parse(input_string);
+    args.phases.start("compile");
+    auto parser = make_parser(resolve_engine(args.engine, grammar, input_string, args.memory_limit << 20), grammar, args.num_threads);
+    parser->print_statistics = args.print_statistics;
+    parser->memory_budget = args.memory_budget << 20;
+    parser->spill_directory = args.spill_directory;
+    parser->time_limit = args.time_limit;
+    parser->descriptor_limit = args.descriptor_limit;
+    parser->memory_limit = args.memory_limit << 20;
+    parser->worklist_policy = args.worklist_policy;
+    args.phases.stop();
+
+    auto result = parser->parse(input_string);
+
+    args.phases.append(parser->phases);
+
+    if (LockProfiler::is_enabled())
+    {
+        std::cerr << parser->statistics.locks.report();
+    }
 
     // print_result("Results", result);
-    // validate_result(result, input_string, grammar);
 
-    return 0;
+    const EPNSpill* spilled_epns = parser->get_spilled_epns();
+    const std::string& stop_reason = parser->statistics.stop_reason;
+
+    if (!stop_reason.empty())
+    {
+        std::cerr << "Warning: the parse was stopped (" << stop_reason << "), the result is incomplete" << std::endl;
+    }
+
+    if (args.validate && !stop_reason.empty())
+    {
+        std::cerr << "Warning: the result is incomplete and is not validated" << std::endl;
+    }
+    else if (args.validate && spilled_epns)
+    {
+        std::cerr << "Warning: the EPNs were spilled to disk, the result is not validated" << std::endl;
+    }
+    else if (args.validate)
+    {
+        args.phases.start("validate");
+        validate_result(result, input_string, grammar, args.num_threads);
+        args.phases.stop();
+    }
+
+    if (!args.output_file.empty() || !args.output_text_file.empty())
+    {
+        args.phases.start("write_output");
+
+        if (!args.output_file.empty()
+            && !write_result_file(args.output_file, grammar, input_string.size(), result.descriptors, result.epns, spilled_epns))
+        {
+            return 1;
+        }
+
+        if (!args.output_text_file.empty())
+        {
+            std::ofstream text_file(args.output_text_file);
+
+            if (!text_file)
+            {
+                std::cerr << "Error: unable to write file '" << args.output_text_file << "'" << std::endl;
+                return 1;
+            }
+
+            write_result_text(text_file, result.descriptors, result.epns, spilled_epns);
+        }
+
+        args.phases.stop();
+    }
+
+    if (args.print_phases)
+    {
+        std::cout << args.phases.to_json(parser->statistics) << std::endl;
+    }
+
+    /* A parse that failed, rather than reached a limit, is an error. */
+    return stop_reason == "failed" ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Batch mode: parses many inputs against one grammar, which is loaded only
+ *   once. Large inputs are parsed one after another, each spread across all
+ *   workers by the selected parallel engine. Small inputs are packed one per
+ *   worker and parsed concurrently by sequential parsers.
+ */
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "batch.hpp"
+#include "../parsers/parsers.hpp"
+#include "../utilities/checks.hpp"
+
+/**
+ * @brief Parses a single input and collects its result.
+ *
+ * @param arguments Parsed command line arguments, with the grammar and the
+ *                  limits of the parse.
+ * @param engine Name of the engine to use.
+ * @param num_threads Number of threads for the engine.
+ * @param input Input sequence.
+ * @param result Result to fill in.
+ */
+void parse_input(
+    Arguments& arguments,
+    std::string engine,
+    unsigned int num_threads,
+    std::vector<std::string>& input,
+    BatchResult& result
+)
+{
+    engine = resolve_engine(engine, arguments.grammar, input, arguments.memory_limit << 20);
+
+    auto parser = make_parser(engine, arguments.grammar, num_threads);
+    parser->print_experiment_data = false;
+    parser->time_limit = arguments.time_limit;
+    parser->descriptor_limit = arguments.descriptor_limit;
+    parser->memory_limit = arguments.memory_limit << 20;
+    parser->worklist_policy = arguments.worklist_policy;
+
+    auto output = parser->parse(input);
+
+    result.length = input.size();
+    result.engine = engine;
+    result.num_threads = is_parallel_engine(engine) ? num_threads : 1;
+    result.time = parser->timer.elapsedMilliseconds();
+    result.num_descriptors = output.descriptors.size();
+    result.num_epns = output.epns.size();
+    result.recognised = is_recognised(output.descriptors, parser->grammar, input.size());
+    result.stop_reason = parser->statistics.stop_reason;
+
+    if (LockProfiler::is_enabled())
+    {
+        result.lock_report = parser->statistics.locks.report();
+    }
+}
+
+/**
+ * @brief Prints the results of batch mode as CSV, in the order of the inputs.
+ * The lock reports of the inputs, if any, go to standard error.
+ *
+ * @param results Results to print.
+ */
+void print_batch_results(std::vector<BatchResult>& results)
+{
+    std::cout << "file,length,engine,threads,time,descriptors,epns,recognised,stopped" << std::endl;
+
+    for (auto& result : results)
+    {
+        std::cout << result.file
+                  << "," << result.length
+                  << "," << result.engine
+                  << "," << result.num_threads
+                  << "," << result.time
+                  << "," << result.num_descriptors
+                  << "," << result.num_epns
+                  << "," << result.recognised
+                  << "," << result.stop_reason
+                  << std::endl;
+    }
+
+    for (auto& result : results)
+    {
+        if (!result.lock_report.empty())
+        {
+            std::cerr << "Locks of " << result.file << ":" << std::endl << result.lock_report;
+        }
+    }
+}
+
+/**
+ * @brief Runs batch mode. All inputs are read first, so that they can be
+ * scheduled by length. Small inputs are handed out longest first, which
+ * balances the load between the workers.
+ *
+ * @param arguments Parsed command line arguments.
+ *
+ * @return Exit code of the program.
+ */
+int run_batch(Arguments& arguments)
+{
+    std::vector<std::vector<std::string>> inputs;
+    std::vector<BatchResult> results(arguments.input_files.size());
+    std::vector<size_t> large_inputs;
+    std::vector<size_t> small_inputs;
+    std::atomic<size_t> next_input(0);
+    std::vector<std::thread> workers;
+    std::string small_engine = is_parallel_engine(arguments.engine) ? "sequential" : arguments.engine;
+    Timer timer;
+
+    timer.start();
+
+    for (size_t i = 0; i < arguments.input_files.size(); i++)
+    {
+        inputs.push_back(read_input_file(arguments.input_files[i]));
+        results[i].file = arguments.input_files[i];
+
+        if (inputs[i].size() >= arguments.large_input_threshold
+            && is_parallel_engine(arguments.engine)
+            && arguments.num_threads > 1)
+        {
+            large_inputs.push_back(i);
+        }
+        else
+        {
+            small_inputs.push_back(i);
+        }
+    }
+
+    auto longest_first = [&inputs](size_t first, size_t second) {
+        return inputs[first].size() > inputs[second].size();
+    };
+
+    std::sort(large_inputs.begin(), large_inputs.end(), longest_first);
+    std::sort(small_inputs.begin(), small_inputs.end(), longest_first);
+
+    /* Large inputs: one at a time, using all workers. */
+    for (auto i : large_inputs)
+    {
+        parse_input(arguments, arguments.engine, arguments.num_threads, inputs[i], results[i]);
+    }
+
+    /* Small inputs: one per worker. */
+    unsigned int num_workers = std::min(arguments.num_threads, static_cast<unsigned int>(small_inputs.size()));
+
+    for (unsigned int w = 0; w < num_workers; w++)
+    {
+        workers.push_back(std::thread([&]() {
+            for (size_t n = next_input.fetch_add(1); n < small_inputs.size(); n = next_input.fetch_add(1))
+            {
+                size_t i = small_inputs[n];
+
+                parse_input(arguments, small_engine, 1, inputs[i], results[i]);
+            }
+        }));
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    timer.stop();
+
+    print_batch_results(results);
+
+    std::cerr << "Parsed " << results.size() << " inputs ("
+              << large_inputs.size() << " large, " << small_inputs.size() << " small) in "
+              << timer.elapsedMilliseconds() << " ms" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with batch mode, which parses many inputs against one grammar.
+ */
+
+#pragma once
+
+#include "../utilities/argparse.hpp"
+
+/**
+ * Result and statistics of parsing one input in batch mode.
+ */
+struct BatchResult
+{
+    /* Name of the input file. */
+    std::string file;
+    /* Length of the input sequence. */
+    size_t length = 0;
+    /* Engine that parsed the input. */
+    std::string engine;
+    /* Number of threads that parsed the input. */
+    unsigned int num_threads = 1;
+    /* Parsing time in milliseconds. */
+    double time = 0;
+    /* Size of the output descriptor set. */
+    size_t num_descriptors = 0;
+    /* Size of the output EPN set. */
+    size_t num_epns = 0;
+    /* Whether the input is in the language of the grammar. */
+    bool recognised = false;
+    /* Limit that stopped the parse, or empty if it finished. */
+    std::string stop_reason;
+    /* Contention report of the locks of the parser, with --lock-profile. */
+    std::string lock_report;
+};
+
+int run_batch(Arguments& arguments);
@@ -0,0 +1,524 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Server mode: keeps the grammar and a set of parsers loaded and answers
+ *   parse requests, either on standard input/output or on a Unix domain
+ *   socket. Requests and responses use a framed text protocol:
+ *
+ *     PARSE <outputs> <n> <token_1> ... <token_n>
+ *       Parses the n tokens. <outputs> is a comma-separated list of
+ *       'recognise', 'stats', 'statistics', 'epns' and 'descriptors'.
+ *     EDIT <outputs> <begin> <end> <n> <token_1> ... <token_n>
+ *       Replaces the tokens from begin up to end of the last input of the
+ *       session by the n tokens and parses the result, reusing the previous
+ *       result where the engine can.
+ *     DERIVES <symbol> <begin> <end>
+ *       Answers 1 if the symbol derives the tokens from begin up to end of the
+ *       last input of the session, 0 otherwise. Queries on the same input
+ *       share their work.
+ *     QUIT
+ *       Ends the session.
+ *
+ *   Tokens are separated by whitespace and may span several lines. Each
+ *   request is answered with 'OK <m>' followed by m lines of output, or with
+ *   a single 'ERROR <message>' line.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <queue>
+#include <condition_variable>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+#include "../parsers/parsers.hpp"
+#include "../parsers/query/query_parser.hpp"
+#include "../utilities/checks.hpp"
+
+namespace
+{
+    /* Connections accepted on the socket, waiting for a worker. */
+    std::queue<int> connections;
+    std::mutex connections_mutex;
+    std::condition_variable connections_cv;
+}
+
+/**
+ * Stream buffer that reads from and writes to a file descriptor.
+ */
+class FileDescriptorBuffer : public std::streambuf
+{
+private:
+    int fd;
+    char read_buffer[4096];
+    char write_buffer[4096];
+public:
+    FileDescriptorBuffer(int f) : fd(f)
+    {
+        setg(read_buffer, read_buffer, read_buffer);
+        setp(write_buffer, write_buffer + sizeof(write_buffer));
+    }
+
+    ~FileDescriptorBuffer()
+    {
+        sync();
+    }
+protected:
+    int underflow() override
+    {
+        ssize_t size = read(fd, read_buffer, sizeof(read_buffer));
+
+        if (size <= 0)
+        {
+            return traits_type::eof();
+        }
+
+        setg(read_buffer, read_buffer, read_buffer + size);
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int overflow(int c) override
+    {
+        if (sync() != 0)
+        {
+            return traits_type::eof();
+        }
+
+        if (c != traits_type::eof())
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        char* begin = pbase();
+
+        while (begin < pptr())
+        {
+            ssize_t size = write(fd, begin, static_cast<size_t>(pptr() - begin));
+
+            if (size <= 0)
+            {
+                return -1;
+            }
+
+            begin += size;
+        }
+
+        setp(write_buffer, write_buffer + sizeof(write_buffer));
+
+        return 0;
+    }
+};
+
+/**
+ * Last input of a session and its result, which EDIT requests apply to.
+ */
+struct Session
+{
+    std::vector<std::string> input;
+    ParseResult result;
+    bool has_input = false;
+    /* Answers DERIVES requests on the input, created by the first one. */
+    std::unique_ptr<QueryParser> queries;
+};
+
+/**
+ * @param output Name of an output of a PARSE or EDIT request.
+ *
+ * @return True if the output exists, false otherwise.
+ */
+bool is_output(const std::string& output)
+{
+    return output == "recognise" || output == "stats" || output == "statistics"
+        || output == "epns" || output == "descriptors";
+}
+
+/**
+ * @brief Parses an input, or reparses the last input of the session after an
+ * edit, and produces the requested outputs.
+ *
+ * @param parser Parser to use.
+ * @param outputs Requested outputs, which must all exist.
+ * @param input Input sequence, or the tokens of the edit.
+ * @param edit Edit of the last input, with its tokens, or nullptr to parse the input.
+ * @param session Session to parse in, updated with the new input and result.
+ * @param lines Vector to add the output lines to.
+ *
+ * @return True if the parse finished, false otherwise.
+ */
+bool handle_parse(
+    Parser& parser,
+    std::vector<std::string>& outputs,
+    std::vector<std::string>& input,
+    const TokenEdit* edit,
+    Session& session,
+    std::vector<std::string>& lines
+)
+{
+    if (edit)
+    {
+        session.result = parser.reparse(session.input, session.result, *edit);
+        session.input = edit->apply(session.input);
+    }
+    else
+    {
+        session.result = parser.parse(input);
+        session.input = std::move(input);
+    }
+
+    session.has_input = true;
+    session.queries.reset();
+
+    /* Standard output may carry the protocol, so the lock report goes to
+       standard error. */
+    if (LockProfiler::is_enabled())
+    {
+        std::cerr << parser.statistics.locks.report();
+    }
+
+    /* A stopped parse has an incomplete result, which later edits cannot use. */
+    if (!parser.statistics.stop_reason.empty())
+    {
+        std::stringstream ss;
+
+        ss << "ERROR parse stopped (" << parser.statistics.stop_reason << ") after "
+           << parser.statistics.total().num_processed << " descriptors and "
+           << parser.timer.elapsedMilliseconds() << " ms";
+
+        lines = { ss.str() };
+        session = Session();
+
+        return false;
+    }
+
+    auto& result = session.result;
+    bool recognised = is_recognised(result.descriptors, parser.grammar, session.input.size());
+
+    for (auto output : outputs)
+    {
+        if (output == "recognise")
+        {
+            lines.push_back(std::to_string(recognised));
+        }
+        else if (output == "stats")
+        {
+            std::stringstream ss;
+
+            ss << session.input.size()
+               << "," << parser.timer.elapsedMilliseconds()
+               << "," << result.descriptors.size()
+               << "," << result.epns.size()
+               << "," << recognised;
+
+            lines.push_back(ss.str());
+        }
+        else if (output == "statistics")
+        {
+            lines.push_back(parser.statistics.to_json());
+        }
+        else if (output == "epns")
+        {
+            for (auto& epn : result.epns)
+            {
+                std::stringstream ss;
+                ss << epn;
+                lines.push_back(ss.str());
+            }
+        }
+        else if (output == "descriptors")
+        {
+            for (auto& descriptor : result.descriptors)
+            {
+                std::stringstream ss;
+                ss << descriptor;
+                lines.push_back(ss.str());
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Answers requests from a stream until it ends or the client quits.
+ *
+ * @param in Stream to read requests from.
+ * @param out Stream to write responses to.
+ * @param parser Parser to use, only used by this thread.
+ */
+void serve(std::istream& in, std::ostream& out, Parser& parser)
+{
+    std::string command;
+    Session session;
+
+    while (in >> command)
+    {
+        if (command == "QUIT")
+        {
+            out << "OK 0" << std::endl;
+            return;
+        }
+
+        if (command == "DERIVES")
+        {
+            std::string symbol;
+            unsigned int begin;
+            unsigned int end;
+
+            if (!(in >> symbol >> begin >> end))
+            {
+                out << "ERROR malformed request" << std::endl;
+                return;
+            }
+
+            if (!session.has_input)
+            {
+                out << "ERROR no input to query" << std::endl;
+                continue;
+            }
+
+            if (!session.queries)
+            {
+                session.queries = std::make_unique<QueryParser>(parser.grammar, session.input);
+            }
+
+            out << "OK 1\n" << session.queries->derives(symbol, begin, end) << std::endl;
+            continue;
+        }
+
+        if (command != "PARSE" && command != "EDIT")
+        {
+            out << "ERROR unknown command '" << command << "'" << std::endl;
+            return;
+        }
+
+        std::string outputs_string;
+        std::vector<std::string> outputs;
+        std::vector<std::string> input;
+        std::vector<std::string> lines;
+        std::string token;
+        size_t length;
+        TokenEdit edit;
+        bool is_edit = command == "EDIT";
+
+        if (!(in >> outputs_string)
+            || (is_edit && !(in >> edit.begin >> edit.end))
+            || !(in >> length))
+        {
+            out << "ERROR malformed request" << std::endl;
+            return;
+        }
+
+        std::stringstream ss(outputs_string);
+
+        while (std::getline(ss, token, ','))
+        {
+            outputs.push_back(token);
+        }
+
+        for (size_t i = 0; i < length && in >> token; i++)
+        {
+            input.push_back(token);
+        }
+
+        if (input.size() != length)
+        {
+            out << "ERROR expected " << length << " tokens" << std::endl;
+            return;
+        }
+
+        bool success = false;
+        auto unknown = std::find_if(outputs.begin(), outputs.end(), [](const std::string& output) {
+            return !is_output(output);
+        });
+
+        if (is_edit)
+        {
+            edit.tokens = input;
+        }
+
+        /* Checked before parsing, so that a bad request keeps the session. */
+        if (unknown != outputs.end())
+        {
+            lines = { "ERROR unknown output '" + *unknown + "'" };
+        }
+        else if (is_edit && !session.has_input)
+        {
+            lines = { "ERROR no input to edit" };
+        }
+        else if (is_edit && !edit.is_valid(session.input.size()))
+        {
+            lines = { "ERROR edit outside the input" };
+        }
+        else
+        {
+            success = handle_parse(parser, outputs, input, is_edit ? &edit : nullptr, session, lines);
+        }
+
+        if (success)
+        {
+            out << "OK " << lines.size() << "\n";
+        }
+
+        for (auto& line : lines)
+        {
+            out << line << "\n";
+        }
+
+        out.flush();
+    }
+}
+
+/**
+ * @brief Function that is used to spawn socket workers. Takes connections from
+ * the queue and serves them one at a time.
+ *
+ * @param parser Parser of the worker.
+ */
+void socket_worker(Parser& parser)
+{
+    while (true)
+    {
+        int fd;
+
+        {
+            std::unique_lock<std::mutex> lock(connections_mutex);
+            connections_cv.wait(lock, []() { return !connections.empty(); });
+            fd = connections.front();
+            connections.pop();
+        }
+
+        {
+            FileDescriptorBuffer buffer(fd);
+            std::istream in(&buffer);
+            std::ostream out(&buffer);
+
+            serve(in, out, parser);
+        }
+
+        close(fd);
+    }
+}
+
+/**
+ * @brief Accepts connections on a Unix domain socket and hands them to a pool
+ * of workers. Each worker owns a parser, so requests are parsed concurrently.
+ *
+ * @param arguments Parsed command line arguments.
+ * @param parsers Parser of each worker.
+ *
+ * @return Exit code of the program.
+ */
+int serve_socket(Arguments& arguments, std::vector<std::unique_ptr<Parser>>& parsers)
+{
+    sockaddr_un address = {};
+    std::vector<std::thread> workers;
+    struct stat status;
+
+    if (arguments.socket_path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Error: socket path '" << arguments.socket_path << "' is too long" << std::endl;
+        return 1;
+    }
+
+    /* Only a stale socket of an earlier server may be replaced. */
+    if (lstat(arguments.socket_path.c_str(), &status) == 0)
+    {
+        if (!S_ISSOCK(status.st_mode))
+        {
+            std::cerr << "Error: '" << arguments.socket_path << "' exists and is not a socket" << std::endl;
+            return 1;
+        }
+
+        unlink(arguments.socket_path.c_str());
+    }
+
+    address.sun_family = AF_UNIX;
+    arguments.socket_path.copy(address.sun_path, arguments.socket_path.size());
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (server_fd < 0
+        || bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || listen(server_fd, SOMAXCONN) < 0)
+    {
+        std::cerr << "Error: unable to listen on socket '" << arguments.socket_path << "'" << std::endl;
+
+        if (server_fd >= 0)
+        {
+            close(server_fd);
+        }
+
+        return 1;
+    }
+
+    /* Clients that disconnect early must not terminate the server. */
+    std::signal(SIGPIPE, SIG_IGN);
+
+    for (auto& parser : parsers)
+    {
+        workers.push_back(std::thread(socket_worker, std::ref(*parser)));
+    }
+
+    while (true)
+    {
+        int fd = accept(server_fd, nullptr, nullptr);
+
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            connections.push(fd);
+        }
+
+        connections_cv.notify_one();
+    }
+}
+
+/**
+ * @brief Runs server mode. The parsers are created once and reused for every
+ * request.
+ *
+ * @param arguments Parsed command line arguments.
+ *
+ * @return Exit code of the program.
+ */
+int run_server(Arguments& arguments)
+{
+    std::vector<std::unique_ptr<Parser>> parsers;
+    unsigned int num_workers = arguments.socket_path.empty() ? 1 : arguments.num_threads;
+
+    for (unsigned int i = 0; i < num_workers; i++)
+    {
+        parsers.push_back(make_parser(arguments.engine, arguments.grammar, arguments.num_threads));
+        parsers.back()->print_experiment_data = false;
+        parsers.back()->time_limit = arguments.time_limit;
+        parsers.back()->descriptor_limit = arguments.descriptor_limit;
+        parsers.back()->memory_limit = arguments.memory_limit << 20;
+        parsers.back()->worklist_policy = arguments.worklist_policy;
+    }
+
+    if (arguments.socket_path.empty())
+    {
+        serve(std::cin, std::cout, *parsers[0]);
+        return 0;
+    }
+
+    return serve_socket(arguments, parsers);
+}
@@ -0,0 +1,13 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with server mode, which keeps the grammar and parsers loaded
+ *   and answers parse requests.
+ */
+
+#pragma once
+
+#include "../utilities/argparse.hpp"
+
+int run_server(Arguments& arguments);
@@ -0,0 +1,443 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the Chart parser. The slots of the compiled grammar are
+ *   its binary normal form: the symbols before the dot of a slot are those of
+ *   the previous slot followed by one symbol. The chart holds, for every slot
+ *   and left extent, the right extents up to which the symbols before the dot
+ *   derive the input, as a bitvector. For every symbol and right extent it
+ *   holds the left extents from which the symbol derives the input.
+ *   Extending a slot over a nonterminal is then the AND of a row and a column
+ *   of the chart, 64 positions at a time. The chart is filled by increasing
+ *   span length. Cells of the same length use disjoint rows and columns, so
+ *   the threads fill them in parallel and only synchronise between lengths.
+ *   Symbols that derive the empty string make cells depend on themselves, so
+ *   a cell is filled until it no longer changes.
+ *
+ *   The descriptors of the CDS algorithm are the chart entries of the slots
+ *   whose left-hand side the parse descends into at the left extent. Those
+ *   are found from the start symbol at position 0. The EPNs are the ways to
+ *   split a descriptor into its previous slot and the symbol before the dot.
+ *   The result equals that of the other engines.
+ */
+
+#include "chart_parser.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    /**
+     * Barrier for a fixed number of threads, which can be reused.
+     */
+    class Barrier
+    {
+    private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t num_threads;
+        size_t num_waiting = 0;
+        size_t generation = 0;
+    public:
+        Barrier(size_t n) : num_threads(n) {};
+
+        /**
+         * @brief Blocks until all threads have called wait().
+         */
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            size_t current = generation;
+
+            if (++num_waiting == num_threads)
+            {
+                num_waiting = 0;
+                generation++;
+                cv.notify_all();
+                return;
+            }
+
+            cv.wait(lock, [&]() { return generation != current; });
+        }
+    };
+
+    /**
+     * @return Whether a bit is set in a bitvector.
+     */
+    bool test_bit(const uint64_t* bits, size_t index)
+    {
+        return (bits[index / 64] >> (index % 64)) & 1;
+    }
+
+    /**
+     * @brief Sets a bit in a bitvector.
+     */
+    void set_bit(uint64_t* bits, size_t index)
+    {
+        bits[index / 64] |= uint64_t(1) << (index % 64);
+    }
+
+    /**
+     * @return Whether two bitvectors share a set bit between two indices.
+     */
+    bool intersects(const uint64_t* first, const uint64_t* second, size_t from, size_t to)
+    {
+        for (size_t word = from / 64; word <= to / 64; word++)
+        {
+            if (first[word] & second[word])
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Calls a function for every bit set in a bitvector, in ascending
+     * order.
+     */
+    template <typename Function>
+    void for_each_bit(const uint64_t* bits, size_t num_words, Function function)
+    {
+        for (size_t word = 0; word < num_words; word++)
+        {
+            uint64_t remaining = bits[word];
+
+            while (remaining)
+            {
+                function(static_cast<unsigned int>(word * 64 + static_cast<size_t>(__builtin_ctzll(remaining))));
+                remaining &= remaining - 1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Constructs the parser and indexes the slots of the grammar.
+ *
+ * @param g Grammar.
+ * @param t Number of threads.
+ */
+ChartParser::ChartParser(Grammar g, unsigned int t) : Parser(g), num_threads(std::max(t, 1u))
+{
+    size_t num_symbols = grammar.compiled->symbol_ids.size();
+
+    is_terminal.assign(num_symbols, false);
+    slots_by_lhs.assign(num_symbols, {});
+    previous_slots.assign(grammar.num_slots(), nullptr);
+
+    for (auto& symbol : grammar.compiled->symbol_ids)
+    {
+        is_terminal[symbol.second] = grammar.terminals.count(symbol.first) > 0;
+    }
+
+    for (auto& slot : grammar.compiled->slots)
+    {
+        slots_by_lhs[slot.lhs_id].push_back(&slot);
+
+        if (!slot.completed)
+        {
+            previous_slots[slot.next->id] = &slot;
+            advanced_slots.push_back(slot.next);
+        }
+    }
+
+    /* A slot depends on its previous slot in the same cell, which comes first. */
+    std::stable_sort(advanced_slots.begin(), advanced_slots.end(), [](const GrammarSlot* a, const GrammarSlot* b) {
+        return a->dot_position < b->dot_position;
+    });
+}
+
+/**
+ * @brief Fills a cell of the chart: finds the slots whose symbols before the
+ * dot derive the input between the extents, and the nonterminals completed
+ * between them. The shorter cells with the same left or right extent must
+ * have been filled.
+ *
+ * @param left_extent Left extent of the cell.
+ * @param right_extent Right extent of the cell.
+ */
+void ChartParser::fill_cell(unsigned int left_extent, unsigned int right_extent)
+{
+    ThreadStatistics& counters = Statistics::current();
+    bool changed = true;
+
+    counters.num_processed++;
+
+    if (left_extent == right_extent)
+    {
+        for (auto& slot : grammar.compiled->slots)
+        {
+            if (slot.dot_position == 0)
+            {
+                set_bit(slot_row(slot.id, left_extent), right_extent);
+
+                if (slot.completed)
+                {
+                    set_bit(symbol_column(slot.lhs_id, right_extent), left_extent);
+                }
+            }
+        }
+    }
+
+    while (changed)
+    {
+        changed = false;
+
+        for (auto slot : advanced_slots)
+        {
+            uint64_t* row = slot_row(slot->id, left_extent);
+
+            if (test_bit(row, right_extent))
+            {
+                continue;
+            }
+
+            const GrammarSlot* previous = previous_slots[slot->id];
+            const uint64_t* previous_row = slot_row(previous->id, left_extent);
+            bool derives = false;
+
+            if (previous->next_is_terminal)
+            {
+                derives = right_extent > left_extent
+                    && token_ids[right_extent - 1] == static_cast<long>(previous->next_symbol_id)
+                    && test_bit(previous_row, right_extent - 1);
+            }
+            else
+            {
+                derives = intersects(previous_row, symbol_column(previous->next_symbol_id, right_extent), left_extent, right_extent);
+            }
+
+            if (derives)
+            {
+                set_bit(row, right_extent);
+                changed = true;
+
+                if (slot->completed)
+                {
+                    set_bit(symbol_column(slot->lhs_id, right_extent), left_extent);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Fills the chart by increasing span length. The cells of one length
+ * are divided over the threads, which wait for each other before the next
+ * length. Every cell counts as a descriptor for the limits of the parse.
+ */
+void ChartParser::fill_chart()
+{
+    size_t threads_used = std::min<size_t>(num_threads, num_positions);
+    Barrier barrier(threads_used);
+
+    /* Once the parse is stopped, the threads skip the remaining cells but still
+       meet at every barrier, so none of them waits forever. */
+    auto fill = [&](size_t thread_id) {
+        for (size_t length = 0; length < num_positions; length++)
+        {
+            for (size_t left = thread_id; left + length < num_positions && !should_stop(); left += threads_used)
+            {
+                fill_cell(static_cast<unsigned int>(left), static_cast<unsigned int>(left + length));
+            }
+
+            barrier.wait();
+        }
+    };
+
+    worker_threads.start(threads_used > 1 ? threads_used - 1 : 0, [&](size_t index) {
+        ThreadStatistics& counters = statistics.add_thread();
+
+        fill(index + 1);
+        counters.stop_cpu_clock();
+    });
+
+    fill(0);
+    worker_threads.wait();
+}
+
+/**
+ * @brief Collects the descriptors and EPNs of the nonterminals that the parse
+ * descends into, starting from the start symbol at position 0. Every
+ * nonterminal and position counts as a descriptor for the limits of the
+ * parse.
+ */
+void ChartParser::project_chart()
+{
+    auto start = grammar.compiled->symbol_ids.find(grammar.start_symbol);
+
+    if (start == grammar.compiled->symbol_ids.end())
+    {
+        return;
+    }
+
+    std::vector<bool> reached(is_terminal.size() * num_positions, false);
+    std::vector<std::pair<unsigned int, unsigned int>> stack;
+
+    auto reach = [&](unsigned int symbol_id, unsigned int position) {
+        if (!reached[symbol_id * num_positions + position])
+        {
+            reached[symbol_id * num_positions + position] = true;
+            stack.push_back(std::make_pair(symbol_id, position));
+        }
+    };
+
+    reach(start->second, 0);
+
+    while (!stack.empty() && !is_stopped())
+    {
+        unsigned int symbol_id = stack.back().first;
+        unsigned int left_extent = stack.back().second;
+        std::vector<EPN> epns;
+
+        stack.pop_back();
+
+        for (auto slot : slots_by_lhs[symbol_id])
+        {
+            if (should_stop())
+            {
+                break;
+            }
+
+            const uint64_t* row = slot_row(slot->id, left_extent);
+            const GrammarSlot* previous = previous_slots[slot->id];
+
+            for_each_bit(row, num_words, [&](unsigned int right_extent) {
+                descriptor_set.insert(Descriptor(slot, left_extent, right_extent));
+
+                if (!slot->completed && !slot->next_is_terminal)
+                {
+                    reach(slot->next_symbol_id, right_extent);
+                }
+
+                if (!previous)
+                {
+                    if (slot->completed)
+                    {
+                        epns.push_back(EPN(slot, left_extent, right_extent, right_extent));
+                    }
+                }
+                else if (previous->next_is_terminal)
+                {
+                    epns.push_back(EPN(slot, left_extent, right_extent - 1, right_extent));
+                }
+                else
+                {
+                    const uint64_t* previous_row = slot_row(previous->id, left_extent);
+                    const uint64_t* column = symbol_column(previous->next_symbol_id, right_extent);
+
+                    for (size_t word = left_extent / 64; word <= right_extent / 64; word++)
+                    {
+                        uint64_t pivots = previous_row[word] & column[word];
+
+                        while (pivots)
+                        {
+                            unsigned int pivot = static_cast<unsigned int>(word * 64 + static_cast<size_t>(__builtin_ctzll(pivots)));
+
+                            epns.push_back(EPN(slot, left_extent, pivot, right_extent));
+                            pivots &= pivots - 1;
+                        }
+                    }
+                }
+            });
+        }
+
+        epn_set.insert(epns.begin(), epns.end());
+        enforce_memory_budget(epn_set);
+    }
+}
+
+/**
+ * @brief Call the parse method of the base class.
+ */
+ParseResult ChartParser::parse(std::vector<std::string> input_sequence)
+{
+    return Parser::parse(std::move(input_sequence));
+}
+
+/**
+ * @param grammar Compiled grammar.
+ * @param input_length Number of tokens of the input.
+ *
+ * @return Bytes of the chart for an input: a bitvector over all positions for
+ * every slot and symbol at every position.
+ */
+size_t ChartParser::chart_size(const Grammar& grammar, size_t input_length)
+{
+    size_t positions = input_length + 1;
+
+    return (grammar.num_slots() + grammar.compiled->symbol_ids.size()) * positions * (positions / 64 + 1) * sizeof(uint64_t);
+}
+
+/**
+ * @brief Fills the chart for the input and projects it onto the descriptors
+ * and EPNs. A chart that would exceed the memory limit is not allocated, and
+ * a chart that was stopped is not projected.
+ */
+void ChartParser::loop()
+{
+    /* Clear the output of a previous parse. */
+    descriptor_set.clear();
+    epn_set.clear();
+
+    num_positions = input.size() + 1;
+    num_words = num_positions / 64 + 1;
+
+    if (memory_limit > 0 && chart_size(grammar, input.size()) > memory_limit)
+    {
+        stop("memory");
+        return;
+    }
+
+    slot_rows.assign(grammar.num_slots() * num_positions * num_words, 0);
+    symbol_columns.assign(is_terminal.size() * num_positions * num_words, 0);
+    token_ids.assign(input.size(), -1);
+
+    for (size_t position = 0; position < input.size(); position++)
+    {
+        auto symbol = grammar.compiled->symbol_ids.find(input[position]);
+
+        if (symbol != grammar.compiled->symbol_ids.end() && is_terminal[symbol->second])
+        {
+            token_ids[position] = symbol->second;
+        }
+    }
+
+    fill_chart();
+
+    if (!is_stopped())
+    {
+        project_chart();
+    }
+
+    std::vector<uint64_t>().swap(slot_rows);
+    std::vector<uint64_t>().swap(symbol_columns);
+}
+
+/**
+ * @return The descriptor set and EPN set, moved out of the parser.
+ */
+ParseResult ChartParser::get_result()
+{
+    return ParseResult(std::move(descriptor_set), std::move(epn_set));
+}
+
+/**
+ * @brief Print data for experiments.
+ */
+void ChartParser::print_data(const ParseResult& result)
+{
+    std::cout << input.size()
+              << "," << timer.elapsedMilliseconds()
+              << "," << statistics.total().num_processed
+              << "," << num_threads
+              << "," << result.descriptors.size()
+              << "," << num_epns(result.epns)
+              << std::endl;
+}
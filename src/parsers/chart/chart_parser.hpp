@@ -0,0 +1,73 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with the Chart parser, which recognises the input with a
+ *   bit-parallel CYK chart and projects the chart onto the descriptors and
+ *   EPNs of the CDS algorithm.
+ */
+
+#pragma once
+
+#include "../../components/parser.hpp"
+
+/**
+ * Represents the Chart parser. Derived from the Parser class.
+ */
+class ChartParser : public Parser
+{
+public:
+    /* Number of threads that fill the chart. */
+    unsigned int num_threads;
+    descriptor_set_t descriptor_set;
+    epn_set_t epn_set;
+private:
+    /* Number of positions of the input, one more than its length. */
+    size_t num_positions = 0;
+    /* Number of 64-bit words in a bitvector over all positions. */
+    size_t num_words = 0;
+    /* For every slot and left extent, the right extents up to which the
+       symbols before the dot derive the input. */
+    std::vector<uint64_t> slot_rows;
+    /* For every symbol and right extent, the left extents from which the
+       symbol derives the input up to the right extent. */
+    std::vector<uint64_t> symbol_columns;
+    /* Symbol id of each token of the input, or -1 if it is not a terminal. */
+    std::vector<long> token_ids;
+    /* Slots with the dot after the first symbol or later, by dot position. */
+    std::vector<const GrammarSlot*> advanced_slots;
+    /* Slot before each slot, indexed by slot id. Null for initial slots. */
+    std::vector<const GrammarSlot*> previous_slots;
+    /* Slots of the rules of each nonterminal, indexed by symbol id. */
+    std::vector<std::vector<const GrammarSlot*>> slots_by_lhs;
+    /* Whether each symbol is a terminal, indexed by symbol id. */
+    std::vector<bool> is_terminal;
+public:
+    ChartParser(Grammar g, unsigned int t);
+public:
+    ParseResult parse(std::vector<std::string> input_sequence);
+    static size_t chart_size(const Grammar& grammar, size_t input_length);
+private:
+    void loop() override;
+    ParseResult get_result() override;
+    void print_data(const ParseResult& result) override;
+    void fill_cell(unsigned int left_extent, unsigned int right_extent);
+    void fill_chart();
+    void project_chart();
+
+    /**
+     * @return Row of right extents of a slot at a left extent.
+     */
+    uint64_t* slot_row(unsigned int slot_id, unsigned int left_extent)
+    {
+        return &slot_rows[(static_cast<size_t>(slot_id) * num_positions + left_extent) * num_words];
+    }
+
+    /**
+     * @return Column of left extents of a symbol at a right extent.
+     */
+    uint64_t* symbol_column(unsigned int symbol_id, unsigned int right_extent)
+    {
+        return &symbol_columns[(static_cast<size_t>(symbol_id) * num_positions + right_extent) * num_words];
+    }
+};
@@ -0,0 +1,753 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the Chunked parallel parser. The descriptors with a
+ *   given left-hand side and left extent do not depend on how that
+ *   nonterminal was reached, so every chunk of the input can parse the
+ *   nonterminals at its own positions by itself. A chunk does not know which
+ *   nonterminals descriptors of earlier chunks will descend into at its
+ *   positions, so it guesses them: the nonterminals that can start with the
+ *   token at a position and follow the token before it. Each thread parses
+ *   one chunk until it runs out of work. Then the chunks exchange the
+ *   nonterminals they need from later chunks and the completions of those
+ *   nonterminals, and a chunk whose guess missed descends into the requested
+ *   nonterminal after all. This repeats until no chunk has work left. Wrong
+ *   guesses only add descriptors and EPNs that are not reachable from the
+ *   start symbol, and those are left out of the result.
+ */
+
+#include "chunked_parser.hpp"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Constructs the parser and analyses the grammar for the guesses.
+ *
+ * @param g Grammar.
+ * @param t Number of threads.
+ */
+ChunkedParser::ChunkedParser(Grammar g, unsigned int t) : Parser(g), num_threads(std::max(t, 1u))
+{
+    analyse_grammar();
+}
+
+/**
+ * @brief Computes, for every terminal, the nonterminals that can be entered at
+ * that terminal from a rule of another nonterminal, and the terminals that can
+ * precede each nonterminal there. Uses the FIRST and LAST sets of the
+ * nonterminals.
+ */
+void ChunkedParser::analyse_grammar()
+{
+    size_t num_symbols = grammar.compiled->symbol_ids.size();
+    std::vector<bool> is_terminal(num_symbols, false);
+    std::vector<bool> nullable(num_symbols, false);
+    std::vector<std::vector<bool>> first(num_symbols, std::vector<bool>(num_symbols, false));
+    std::vector<std::vector<bool>> last(num_symbols, std::vector<bool>(num_symbols, false));
+    std::vector<std::pair<unsigned int, std::vector<unsigned int>>> rules;
+
+    initial_slots.assign(num_symbols, nullptr);
+
+    for (auto& symbol : grammar.compiled->symbol_ids)
+    {
+        if (grammar.terminals.count(symbol.first))
+        {
+            is_terminal[symbol.second] = true;
+        }
+        else
+        {
+            initial_slots[symbol.second] = &grammar.get_initial_slots(symbol.first);
+        }
+    }
+
+    for (auto& slot : grammar.compiled->slots)
+    {
+        if (slot.dot_position == 0)
+        {
+            std::vector<unsigned int> rhs;
+
+            for (const GrammarSlot* s = &slot; !s->completed; s = s->next)
+            {
+                rhs.push_back(s->next_symbol_id);
+            }
+
+            rules.push_back(std::make_pair(slot.lhs_id, rhs));
+        }
+    }
+
+    /* Adds the terminals of a symbol to a set. Returns whether the set changed. */
+    auto add = [&is_terminal](std::vector<bool>& set, unsigned int symbol, const std::vector<std::vector<bool>>& sets) {
+        bool changed = false;
+
+        if (is_terminal[symbol])
+        {
+            changed = !set[symbol];
+            set[symbol] = true;
+            return changed;
+        }
+
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            if (sets[symbol][i] && !set[i])
+            {
+                set[i] = true;
+                changed = true;
+            }
+        }
+
+        return changed;
+    };
+
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (auto& rule : rules)
+        {
+            bool all_nullable = true;
+
+            for (auto symbol : rule.second)
+            {
+                changed |= add(first[rule.first], symbol, first);
+
+                if (is_terminal[symbol] || !nullable[symbol])
+                {
+                    all_nullable = false;
+                    break;
+                }
+            }
+
+            for (auto symbol = rule.second.rbegin(); symbol != rule.second.rend(); ++symbol)
+            {
+                changed |= add(last[rule.first], *symbol, last);
+
+                if (is_terminal[*symbol] || !nullable[*symbol])
+                {
+                    break;
+                }
+            }
+
+            if (all_nullable && !nullable[rule.first])
+            {
+                nullable[rule.first] = true;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<bool> is_entry(num_symbols, false);
+
+    preceding_terminals.assign(num_symbols, std::vector<bool>(num_symbols, false));
+    preceded_by_any.assign(num_symbols, false);
+
+    for (auto& rule : rules)
+    {
+        for (size_t i = 1; i < rule.second.size(); i++)
+        {
+            unsigned int symbol = rule.second[i];
+            unsigned int previous = rule.second[i - 1];
+
+            if (is_terminal[symbol])
+            {
+                continue;
+            }
+
+            is_entry[symbol] = true;
+            add(preceding_terminals[symbol], previous, last);
+
+            if (!is_terminal[previous] && nullable[previous])
+            {
+                preceded_by_any[symbol] = true;
+            }
+        }
+    }
+
+    entry_nonterminals.assign(num_symbols, {});
+
+    for (unsigned int symbol = 0; symbol < num_symbols; symbol++)
+    {
+        for (unsigned int terminal = 0; terminal < num_symbols && is_entry[symbol]; terminal++)
+        {
+            if (first[symbol][terminal])
+            {
+                entry_nonterminals[terminal].push_back(symbol);
+            }
+        }
+    }
+}
+
+/**
+ * @param position Position of the input.
+ *
+ * @return The chunk that the position belongs to.
+ */
+Chunk& ChunkedParser::owner(unsigned int position)
+{
+    return chunks[std::min(static_cast<size_t>(position / chunk_length), chunks.size() - 1)];
+}
+
+/**
+ * @brief Adds a single descriptor to the worklist of a chunk if it doesn't
+ * already exist in the descriptor set of the chunk.
+ *
+ * @param chunk Chunk of the descriptor.
+ * @param descriptor Descriptor to add to the worklist.
+ */
+void ChunkedParser::add_to_worklist(Chunk& chunk, Descriptor descriptor)
+{
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+    if (!chunk.descriptor_set.insert(descriptor).second || !chunk.worklist.insert(descriptor))
+#else
+    if (chunk.descriptor_set.count(descriptor) || !chunk.worklist.insert(descriptor))
+#endif
+    {
+        Statistics::current().num_duplicates++;
+    }
+}
+
+/**
+ * @brief Implements the 'match' operation: add a new descriptor and EPN if the
+ * current descriptor matches the correct terminal in the input string. The
+ * terminal may lie in a later chunk.
+ *
+ * @param chunk Chunk of the descriptor.
+ * @param descriptor Descriptor that is being processed.
+ */
+void ChunkedParser::match(Chunk& chunk, Descriptor descriptor)
+{
+    Statistics::current().num_match++;
+
+    const std::string& terminal = descriptor.get_next_symbol();
+
+    if (descriptor.right_extent < input.size() && terminal == input[descriptor.right_extent])
+    {
+        Descriptor d = descriptor.copy_and_advance();
+        d.right_extent++;
+
+        add_to_worklist(chunk, d);
+
+        chunk.epn_set.insert(EPN(d, descriptor.right_extent));
+    }
+}
+
+/**
+ * @brief Implements the 'descend' operation: add a new descriptor for every
+ * alternative of a nonterminal at a position of the chunk.
+ *
+ * @param chunk Chunk that the position belongs to.
+ * @param symbol_id Symbol id of the nonterminal.
+ * @param pivot Position to descend at.
+ */
+void ChunkedParser::descend(Chunk& chunk, unsigned int symbol_id, unsigned int pivot)
+{
+    Statistics::current().num_descend++;
+
+    for (auto slot : *initial_slots[symbol_id])
+    {
+        add_to_worklist(chunk, Descriptor(slot, pivot, pivot));
+    }
+}
+
+/**
+ * @brief Implements the 'skip' operation: skip over the nonterminal after the
+ * dot, using the right extents at which it is known to be completed.
+ *
+ * @param chunk Chunk of the descriptor.
+ * @param descriptor Descriptor with the dot advanced over the nonterminal.
+ * @param right_extents Right extents of the nonterminal.
+ */
+void ChunkedParser::skip(Chunk& chunk, Descriptor descriptor, const ExtentSet& right_extents)
+{
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_skip++;
+
+    epns.reserve(right_extents.size());
+
+    right_extents.for_each([&](unsigned int right_extent) {
+        add_to_worklist(chunk, Descriptor(descriptor.slot, descriptor.left_extent, right_extent));
+
+        epns.push_back(EPN(descriptor.slot, descriptor.left_extent, descriptor.right_extent, right_extent));
+    });
+
+    chunk.epn_set.insert(epns.begin(), epns.end());
+}
+
+/**
+ * @brief Implements the 'ascend' operation: a nonterminal has been completed
+ * at a right extent, and every descriptor of the chunk that waits for it is
+ * advanced to that right extent. Completions of nonterminals that an earlier
+ * chunk requested are recorded for the next exchange.
+ *
+ * @param chunk Chunk that the completion is applied to.
+ * @param key Key of the nonterminal and its left extent.
+ * @param right_extent Right extent of the completed nonterminal.
+ */
+void ChunkedParser::ascend(Chunk& chunk, uint64_t key, unsigned int right_extent)
+{
+    if (!chunk.completions[key].insert(right_extent, num_words))
+    {
+        return;
+    }
+
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_ascend++;
+
+    auto waiting = chunk.waiting.find(key);
+
+    if (waiting != chunk.waiting.end())
+    {
+        for (auto& descriptor : waiting->second)
+        {
+            Descriptor new_descriptor = descriptor.copy_and_advance();
+            new_descriptor.right_extent = right_extent;
+
+            add_to_worklist(chunk, new_descriptor);
+
+            epns.push_back(EPN(new_descriptor, descriptor.right_extent));
+        }
+    }
+
+    chunk.epn_set.insert(epns.begin(), epns.end());
+
+    if (chunk.subscribers.count(key))
+    {
+        chunk.new_completions.push_back(std::make_pair(key, right_extent));
+    }
+}
+
+/**
+ * @brief Processes a descriptor. A nonterminal after the dot is descended once
+ * per position, in this chunk or by a request to the chunk of the position,
+ * and skipped over with the completions known so far. Later completions reach
+ * the descriptor through 'ascend'.
+ *
+ * @param chunk Chunk of the descriptor.
+ * @param descriptor Descriptor to be processed.
+ */
+void ChunkedParser::process_descriptor(Chunk& chunk, Descriptor descriptor)
+{
+    if (descriptor.is_completed())
+    {
+        ascend(chunk, make_key(descriptor.slot->lhs_id, descriptor.left_extent), descriptor.right_extent);
+
+        if (descriptor.is_empty())
+        {
+            chunk.epn_set.insert(EPN(descriptor));
+        }
+
+        return;
+    }
+
+    if (descriptor.slot->next_is_terminal)
+    {
+        match(chunk, descriptor);
+        return;
+    }
+
+    uint64_t key = make_key(descriptor.slot->next_symbol_id, descriptor.right_extent);
+
+    chunk.waiting[key].push_back(descriptor);
+
+    if (chunk.descended.insert(key).second)
+    {
+        if (descriptor.right_extent < chunk.end)
+        {
+            descend(chunk, descriptor.slot->next_symbol_id, descriptor.right_extent);
+        }
+        else
+        {
+            chunk.requests.push_back(key);
+        }
+    }
+
+    auto completions = chunk.completions.find(key);
+
+    if (completions != chunk.completions.end())
+    {
+        skip(chunk, descriptor.copy_and_advance(), completions->second);
+    }
+}
+
+/**
+ * @brief Adds the initial descriptors of a chunk to its worklist: the start
+ * symbol for the first chunk, and the guessed nonterminals at each position
+ * for the others.
+ *
+ * @param chunk Chunk to seed.
+ */
+void ChunkedParser::seed(Chunk& chunk)
+{
+    chunk.seeded = true;
+
+    if (chunk.begin == 0)
+    {
+        auto start = grammar.compiled->symbol_ids.find(grammar.start_symbol);
+
+        if (start != grammar.compiled->symbol_ids.end() && initial_slots[start->second])
+        {
+            chunk.descended.insert(make_key(start->second, 0));
+            descend(chunk, start->second, 0);
+        }
+
+        return;
+    }
+
+    for (unsigned int position = chunk.begin; position < chunk.end && position < input.size(); position++)
+    {
+        if (token_ids[position] < 0 || token_ids[position - 1] < 0)
+        {
+            continue;
+        }
+
+        auto token = static_cast<size_t>(token_ids[position]);
+        auto previous = static_cast<size_t>(token_ids[position - 1]);
+
+        for (auto symbol : entry_nonterminals[token])
+        {
+            if ((preceded_by_any[symbol] || preceding_terminals[symbol][previous])
+                && chunk.descended.insert(make_key(symbol, position)).second)
+            {
+                descend(chunk, symbol, position);
+                chunk.num_guesses++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Processes the descriptors of a chunk until its worklist is empty or
+ * the parse is stopped. Stops the parse when the EPN sets of all chunks
+ * together take more than the memory limit.
+ *
+ * @param chunk Chunk to process.
+ */
+void ChunkedParser::run(Chunk& chunk)
+{
+    ThreadStatistics& counters = Statistics::current();
+
+    while (!chunk.worklist.empty() && !should_stop())
+    {
+        counters.record_queue_depth(chunk.worklist.size());
+
+        Descriptor d = chunk.worklist.take();
+#ifndef OPTIMISATION_INSERT_ON_DISCOVER
+        chunk.descriptor_set.insert(d);
+#endif
+
+        process_descriptor(chunk, d);
+
+        if (count_epn_memory(chunk.epn_set, chunk.epn_bytes, epn_bytes))
+        {
+            stop("memory");
+        }
+
+        counters.num_processed++;
+    }
+}
+
+/**
+ * @brief Function of the thread of a chunk. Seeds the chunk in the first round
+ * and processes it in every round, until the threads are stopped.
+ *
+ * @param index Index of the chunk.
+ */
+void ChunkedParser::thread_function(size_t index)
+{
+    ThreadStatistics& counters = statistics.add_thread();
+    Chunk& chunk = chunks[index];
+    unsigned int seen_round = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(round_mutex);
+            round_cv.wait(lock, [&]() { return stop_threads || round != seen_round; });
+
+            if (stop_threads)
+            {
+                break;
+            }
+
+            seen_round = round;
+        }
+
+        if (!chunk.seeded)
+        {
+            seed(chunk);
+        }
+
+        run(chunk);
+
+        {
+            std::lock_guard<std::mutex> lock(round_mutex);
+            num_done++;
+        }
+
+        done_cv.notify_one();
+    }
+
+    counters.stop_cpu_clock();
+}
+
+/**
+ * @brief Lets every thread process its chunk, and waits until all are done.
+ */
+void ChunkedParser::run_round()
+{
+    {
+        std::lock_guard<std::mutex> lock(round_mutex);
+        num_done = 0;
+        round++;
+    }
+
+    round_cv.notify_all();
+
+    std::unique_lock<std::mutex> lock(round_mutex);
+    done_cv.wait(lock, [this]() { return num_done == chunks.size(); });
+}
+
+/**
+ * @brief Exchanges requests and completions between the chunks, while the
+ * threads wait. A requested nonterminal that its chunk did not guess or
+ * descend into yet is descended into now. The requesting chunk receives the
+ * completions known so far, and later ones in the next exchanges.
+ *
+ * @return True if any chunk has work left, false otherwise.
+ */
+bool ChunkedParser::exchange()
+{
+    bool work = false;
+
+    for (size_t index = 0; index < chunks.size(); index++)
+    {
+        for (auto key : chunks[index].requests)
+        {
+            Chunk& target = owner(key_position(key));
+
+            target.subscribers[key].push_back(index);
+
+            if (target.descended.insert(key).second)
+            {
+                descend(target, key_symbol(key), key_position(key));
+                num_misses++;
+            }
+            else
+            {
+                num_hits++;
+            }
+
+            auto completions = target.completions.find(key);
+
+            if (completions != target.completions.end())
+            {
+                completions->second.for_each([&](unsigned int right_extent) {
+                    ascend(chunks[index], key, right_extent);
+                });
+            }
+        }
+
+        chunks[index].requests.clear();
+    }
+
+    for (auto& chunk : chunks)
+    {
+        for (auto& completion : chunk.new_completions)
+        {
+            for (auto index : chunk.subscribers[completion.first])
+            {
+                ascend(chunks[index], completion.first, completion.second);
+            }
+        }
+
+        chunk.new_completions.clear();
+    }
+
+    for (auto& chunk : chunks)
+    {
+        work |= !chunk.worklist.empty();
+    }
+
+    return work;
+}
+
+/**
+ * @brief Collects the descriptors and EPNs of the nonterminals that are
+ * reachable from the start symbol at position 0 into the result. Each
+ * descriptor and EPN belongs to the nonterminal on its left-hand side at its
+ * left extent.
+ */
+void ChunkedParser::collect_result()
+{
+    std::unordered_map<uint64_t, std::vector<uint64_t>> children;
+    std::unordered_set<uint64_t> reachable;
+    std::vector<uint64_t> stack;
+
+    for (auto& chunk : chunks)
+    {
+        for (auto& waiting : chunk.waiting)
+        {
+            for (auto& descriptor : waiting.second)
+            {
+                children[make_key(descriptor.slot->lhs_id, descriptor.left_extent)].push_back(waiting.first);
+            }
+        }
+    }
+
+    auto start = grammar.compiled->symbol_ids.find(grammar.start_symbol);
+
+    if (start != grammar.compiled->symbol_ids.end())
+    {
+        reachable.insert(make_key(start->second, 0));
+        stack.push_back(make_key(start->second, 0));
+    }
+
+    while (!stack.empty())
+    {
+        uint64_t key = stack.back();
+        stack.pop_back();
+
+        for (auto child : children[key])
+        {
+            if (reachable.insert(child).second)
+            {
+                stack.push_back(child);
+            }
+        }
+    }
+
+    for (auto& chunk : chunks)
+    {
+        num_guesses += chunk.num_guesses;
+
+        for (auto& d : chunk.descriptor_set)
+        {
+            if (reachable.count(make_key(d.slot->lhs_id, d.left_extent)))
+            {
+                descriptor_set.insert(d);
+            }
+        }
+
+        for (auto& e : chunk.epn_set)
+        {
+            if (reachable.count(make_key(e.slot->lhs_id, e.left_extent)))
+            {
+                epn_set.insert(e);
+                enforce_memory_budget(epn_set);
+            }
+        }
+
+        chunk = Chunk();
+    }
+}
+
+/**
+ * @brief Call the parse method of the base class.
+ */
+ParseResult ChunkedParser::parse(std::vector<std::string> input_sequence)
+{
+    return Parser::parse(std::move(input_sequence));
+}
+
+/**
+ * @brief Splits the positions of the input into chunks of at least
+ * MIN_CHUNK_LENGTH positions, one per thread at most, and starts a thread per
+ * chunk. Lets the threads process their chunks and exchanges work between
+ * them until no chunk has work left, then collects the result.
+ */
+void ChunkedParser::loop()
+{
+    /* Clear the output of a previous parse. */
+    descriptor_set.clear();
+    epn_set.clear();
+    num_guesses = 0;
+    num_hits = 0;
+    num_misses = 0;
+    epn_bytes = 0;
+    statistics.worklist_policy = worklist_policy;
+
+    size_t num_positions = input.size() + 1;
+    size_t num_chunks = std::max<size_t>(1, std::min<size_t>(num_threads, num_positions / MIN_CHUNK_LENGTH));
+
+    chunk_length = static_cast<unsigned int>((num_positions + num_chunks - 1) / num_chunks);
+    num_words = input.size() / 64 + 1;
+    chunks.assign(num_chunks, Chunk());
+    token_ids.assign(input.size(), -1);
+
+    for (size_t index = 0; index < num_chunks; index++)
+    {
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+        chunks[index].worklist = Worklist(worklist_policy, false);
+#else
+        chunks[index].worklist = Worklist(worklist_policy);
+#endif
+        chunks[index].begin = static_cast<unsigned int>(index * chunk_length);
+        chunks[index].end = index + 1 == num_chunks
+            ? static_cast<unsigned int>(num_positions)
+            : static_cast<unsigned int>((index + 1) * chunk_length);
+    }
+
+    for (size_t position = 0; position < input.size(); position++)
+    {
+        auto symbol = grammar.compiled->symbol_ids.find(input[position]);
+
+        if (symbol != grammar.compiled->symbol_ids.end() && grammar.terminals.count(input[position]))
+        {
+            token_ids[position] = symbol->second;
+        }
+    }
+
+    round = 0;
+    stop_threads = false;
+    worker_threads.start(num_chunks, [this](size_t index) { thread_function(index); });
+
+    do
+    {
+        run_round();
+    }
+    while (!is_stopped() && exchange());
+
+    {
+        std::lock_guard<std::mutex> lock(round_mutex);
+        stop_threads = true;
+    }
+
+    round_cv.notify_all();
+    worker_threads.wait();
+
+    /* Collecting the result of a stopped parse would take about as long as
+       the rest of it, so its result stays empty. */
+    if (!is_stopped())
+    {
+        collect_result();
+    }
+
+    chunks.clear();
+}
+
+/**
+ * @return The descriptor set and EPN set, moved out of the parser.
+ */
+ParseResult ChunkedParser::get_result()
+{
+    return ParseResult(std::move(descriptor_set), std::move(epn_set));
+}
+
+/**
+ * @brief Print data for experiments.
+ */
+void ChunkedParser::print_data(const ParseResult& result)
+{
+    std::cout << input.size()
+              << "," << timer.elapsedMilliseconds()
+              << "," << statistics.total().num_processed
+              << "," << num_threads
+              << "," << result.descriptors.size()
+              << "," << num_epns(result.epns)
+              << std::endl;
+}
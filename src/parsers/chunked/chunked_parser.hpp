@@ -0,0 +1,131 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with the Chunked parallel parser, which splits the input into
+ *   chunks and parses every chunk speculatively in its own thread.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "../../components/parser.hpp"
+#include "../../components/descriptor_store.hpp"
+#include "../../utilities/pool_allocator.hpp"
+
+/* Minimum number of positions of the input in a chunk. */
+#define MIN_CHUNK_LENGTH 32
+
+/**
+ * Part of a parse of the Chunked parser: the descriptors whose left extent
+ * lies in one chunk of the input, with their EPNs. Pairs of a nonterminal and
+ * a position are keys, see ChunkedParser::make_key().
+ */
+struct Chunk
+{
+    /* First position of the chunk, and the position after the last one. */
+    unsigned int begin = 0;
+    unsigned int end = 0;
+    Worklist worklist;
+    descriptor_set_t descriptor_set;
+    epn_set_t epn_set;
+    /* Bytes of the EPN set counted in ChunkedParser::epn_bytes. */
+    size_t epn_bytes = 0;
+    /* Right extents of the completed nonterminals at a left extent, found in
+       this chunk or, for positions of later chunks, received from them. */
+    pooled_map_t<uint64_t, ExtentSet> completions;
+    /* Descriptors waiting for a nonterminal at their right extent. */
+    pooled_map_t<uint64_t, pooled_vector_t<Descriptor>> waiting;
+    /* Nonterminals descended at positions of this chunk, guessed or not, and
+       nonterminals requested from later chunks. */
+    pooled_set_t<uint64_t> descended;
+    /* Nonterminals requested from later chunks since the last exchange. */
+    std::vector<uint64_t> requests;
+    /* Indices of the earlier chunks that requested a nonterminal of this chunk. */
+    pooled_map_t<uint64_t, pooled_vector_t<size_t>> subscribers;
+    /* Completions of requested nonterminals since the last exchange. */
+    std::vector<std::pair<uint64_t, unsigned int>> new_completions;
+    /* Whether the guessed nonterminals have been added to the worklist. */
+    bool seeded = false;
+    /* Number of nonterminals guessed at the positions of the chunk. */
+    unsigned long num_guesses = 0;
+};
+
+/**
+ * Represents the Chunked parser. Derived from the Parser class.
+ */
+class ChunkedParser : public Parser
+{
+public:
+    /* Number of threads, and the maximum number of chunks. */
+    unsigned int num_threads;
+    descriptor_set_t descriptor_set;
+    epn_set_t epn_set;
+    /* Nonterminals guessed at the positions of the input. */
+    unsigned long num_guesses = 0;
+    /* Requests for nonterminals that were guessed or descended already. */
+    unsigned long num_hits = 0;
+    /* Requests for nonterminals that were not, and had to be descended late. */
+    unsigned long num_misses = 0;
+private:
+    std::vector<Chunk> chunks;
+    /* Number of positions of the input in each chunk but the last. */
+    unsigned int chunk_length = 1;
+    /* Number of 64-bit words in a bitvector over all extents. */
+    size_t num_words = 1;
+    /* Symbol id of each token of the input, or -1 if it is not a terminal. */
+    std::vector<long> token_ids;
+    /* Initial slots of each nonterminal, indexed by symbol id. */
+    std::vector<const std::vector<const GrammarSlot*>*> initial_slots;
+    /* Bytes of the EPN sets of all chunks, for the memory limit. */
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> epn_bytes{0};
+    /* Nonterminals that can be entered at a terminal from outside their
+       left-hand sides, indexed by the symbol id of the terminal. */
+    std::vector<std::vector<unsigned int>> entry_nonterminals;
+    /* Terminals that can precede each nonterminal, indexed by symbol ids. */
+    std::vector<std::vector<bool>> preceding_terminals;
+    /* Whether anything can precede each nonterminal. */
+    std::vector<bool> preceded_by_any;
+    std::mutex round_mutex;
+    std::condition_variable round_cv;
+    std::condition_variable done_cv;
+    unsigned int round = 0;
+    size_t num_done = 0;
+    bool stop_threads = false;
+public:
+    ChunkedParser(Grammar g, unsigned int t);
+public:
+    ParseResult parse(std::vector<std::string> input_sequence);
+private:
+    void loop() override;
+    ParseResult get_result() override;
+    void print_data(const ParseResult& result) override;
+    void analyse_grammar();
+    void thread_function(size_t index);
+    void run_round();
+    bool exchange();
+    void collect_result();
+    void seed(Chunk& chunk);
+    void run(Chunk& chunk);
+    void process_descriptor(Chunk& chunk, Descriptor descriptor);
+    void match(Chunk& chunk, Descriptor descriptor);
+    void descend(Chunk& chunk, unsigned int symbol_id, unsigned int pivot);
+    void skip(Chunk& chunk, Descriptor descriptor, const ExtentSet& right_extents);
+    void ascend(Chunk& chunk, uint64_t key, unsigned int right_extent);
+    void add_to_worklist(Chunk& chunk, Descriptor descriptor);
+    Chunk& owner(unsigned int position);
+
+    /**
+     * @return Key of a nonterminal at a position.
+     */
+    static uint64_t make_key(unsigned int symbol_id, unsigned int position)
+    {
+        return (static_cast<uint64_t>(position) << 32) | symbol_id;
+    }
+
+    static unsigned int key_symbol(uint64_t key) { return static_cast<unsigned int>(key); }
+    static unsigned int key_position(uint64_t key) { return static_cast<unsigned int>(key >> 32); }
+};
@@ -0,0 +1,563 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of a serial CDS descriptor-processing parser that keeps its
+ *   descriptors in a descriptor store instead of a hash set. 'skip' and
+ *   'ascend' look up the extents they need in the store, where the sequential
+ *   parser scans the whole descriptor set.
+ *
+ *   reparse() parses an edited input incrementally. The descriptors and EPNs
+ *   of the previous result that end before the edit stay valid: the
+ *   nonterminals descended at or before a position depend only on the input
+ *   before it. The descriptors that end at the start of the edit are processed
+ *   again, which continues the parse into the edit. The descriptors of a
+ *   nonterminal at a position after the edit depend only on the input after
+ *   it. When the parse reaches one that the previous parse descended into, its
+ *   descriptors and EPNs, and those of the nonterminals it descends into, are
+ *   copied from the previous result with shifted extents instead of parsed.
+ */
+
+#include "dense_parser.hpp"
+#include <algorithm>
+#include <iostream>
+
+/**
+ * @brief Adds a single descriptor to the worklist if it doesn't already exist
+ * in the descriptor store. With OPTIMISATION_INSERT_ON_DISCOVER, it is added
+ * to the store here instead of when it is processed.
+ *
+ * @param descriptor Descriptor to add to the worklist.
+ */
+void DenseParser::add_to_worklist(Descriptor descriptor)
+{
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+    if (!descriptor_store.insert(descriptor) || !worklist.insert(descriptor))
+#else
+    if (descriptor_store.contains(descriptor) || !worklist.insert(descriptor))
+#endif
+    {
+        Statistics::current().num_duplicates++;
+    }
+}
+
+/**
+ * @brief Adds a single descriptor that is known not to be in the descriptor
+ * store to the worklist, if it is not in the worklist yet.
+ *
+ * @param descriptor Descriptor to add to the worklist.
+ */
+void DenseParser::add_new_to_worklist(Descriptor descriptor)
+{
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+    if (!descriptor_store.insert(descriptor) || !worklist.insert(descriptor))
+#else
+    if (!worklist.insert(descriptor))
+#endif
+    {
+        Statistics::current().num_duplicates++;
+    }
+}
+
+/**
+ * @brief Extends the worklist with the provided slots, using the provided left
+ * and right extents. Does not add a new descriptor if it is already in the
+ * descriptor store.
+ *
+ * @param slots Initial slots of the rules to extend the worklist with.
+ * @param left_extent Left extent of the new descriptors.
+ * @param right_extent Right extent of the new descriptors.
+ */
+void DenseParser::extend_worklist(
+    const std::vector<const GrammarSlot*>& slots,
+    unsigned int left_extent,
+    unsigned int right_extent
+)
+{
+    for (auto slot : slots)
+    {
+        add_to_worklist(Descriptor(slot, left_extent, right_extent));
+    }
+}
+
+/**
+ * @brief Implements the 'match' operation: add a new descriptor and EPN if the
+ * current descriptor matches the correct terminal in the input string.
+ *
+ * @param descriptor Descriptor that is being processed.
+ */
+void DenseParser::match(Descriptor descriptor)
+{
+    Statistics::current().num_match++;
+
+    const std::string& terminal = descriptor.get_next_symbol();
+
+    if (descriptor.right_extent < input.size() && terminal == input[descriptor.right_extent])
+    {
+        Descriptor d = descriptor.copy_and_advance();
+        d.right_extent++;
+
+        add_to_worklist(d);
+
+        epn_set.insert(EPN(d, descriptor.right_extent));
+        enforce_memory_budget(epn_set);
+    }
+}
+
+/**
+ * @brief Implements the 'descend' operation: add a new descriptor for every
+ * valid alternative of the given nonterminal symbol.
+ *
+ * @param symbol Nonterminal symbol to find alternatives of.
+ * @param pivot Pivot of the currently processed descriptor.
+ */
+void DenseParser::descend(
+    const std::string& symbol,
+    unsigned int pivot
+)
+{
+    Statistics::current().num_descend++;
+
+    extend_worklist(
+        grammar.get_initial_slots(symbol),
+        pivot,
+        pivot
+    );
+}
+
+/**
+ * @brief Implements the 'skip' operation: skip over the nonterminal symbol,
+ * using the right extents found in the descriptor store. The right extents
+ * that already have a descriptor are removed from the set in bulk before any
+ * descriptor is created.
+ *
+ * @param descriptor Descriptor currently being processed, with nonterminal skip.
+ */
+void DenseParser::skip(Descriptor descriptor)
+{
+    ThreadStatistics& counters = Statistics::current();
+    std::vector<EPN> epns;
+
+    counters.num_skip++;
+
+    size_t num_extents = ExtentSet::count_bits(right_extents);
+    size_t num_new = descriptor_store
+        .get_right_extents(descriptor.slot, descriptor.left_extent)
+        .subtract_from(right_extents, new_extents);
+
+    counters.num_duplicates += num_extents - num_new;
+
+    ExtentSet::for_each_bit(new_extents, [&](unsigned int right_extent) {
+        add_new_to_worklist(Descriptor(descriptor.slot, descriptor.left_extent, right_extent));
+    });
+
+    epns.reserve(num_extents);
+
+    ExtentSet::for_each_bit(right_extents, [&](unsigned int right_extent) {
+        epns.push_back(EPN(descriptor.slot, descriptor.left_extent, descriptor.right_extent, right_extent));
+    });
+
+    epn_set.insert(epns.begin(), epns.end());
+    enforce_memory_budget(epn_set);
+}
+
+/**
+ * @brief Implements the 'ascend' operation: a production rule has been parsed,
+ * and every descriptor that waits for its left-hand side at its left extent is
+ * advanced to its right extent. For each waiting slot, the left extents that
+ * already have an advanced descriptor are filtered out in bulk.
+ *
+ * @param descriptor Completed descriptor that is being processed.
+ */
+void DenseParser::ascend(Descriptor descriptor)
+{
+    ThreadStatistics& counters = Statistics::current();
+    std::vector<EPN> epns;
+
+    counters.num_ascend++;
+
+    if (edit && descriptor.left_extent < edit->begin)
+    {
+        load_waiting(descriptor.slot->lhs_id, descriptor.left_extent);
+    }
+
+    for (auto slot : grammar.get_waiting_slots(descriptor.slot->lhs_id))
+    {
+        const ExtentSet& left_extents = descriptor_store.get_left_extents(slot, descriptor.left_extent);
+
+        if (left_extents.empty())
+        {
+            continue;
+        }
+
+        const ExtentSet& known = descriptor_store.get_left_extents(slot->next, descriptor.right_extent);
+
+        counters.num_duplicates += left_extents.for_each_new(known, new_extents, [&](unsigned int left_extent) {
+            add_new_to_worklist(Descriptor(slot->next, left_extent, descriptor.right_extent));
+        });
+
+        epns.reserve(epns.size() + left_extents.size());
+
+        left_extents.for_each([&](unsigned int left_extent) {
+            epns.push_back(EPN(slot->next, left_extent, descriptor.left_extent, descriptor.right_extent));
+        });
+    }
+
+    epn_set.insert(epns.begin(), epns.end());
+    enforce_memory_budget(epn_set);
+}
+
+/**
+ * @brief Processes a descriptor. Chooses one of 'match', 'ascend', 'descend',
+ * 'skip' and calls the function for the chosen operation.
+ *
+ * @param descriptor Descriptor to be processed.
+ */
+void DenseParser::process_descriptor(Descriptor descriptor)
+{
+    if (!descriptor.is_completed())
+    {
+        if (descriptor.slot->next_is_terminal)
+        {
+            match(descriptor);
+            return;
+        }
+
+        if (edit && descriptor.right_extent >= edit_end)
+        {
+            reuse(descriptor.slot->next_symbol_id, descriptor.right_extent);
+        }
+
+        bool found = false;
+        std::fill(right_extents.begin(), right_extents.end(), 0);
+
+        for (auto slot : grammar.get_completed_slots(descriptor.slot->next_symbol_id))
+        {
+            found |= descriptor_store.add_right_extents(slot, descriptor.right_extent, right_extents);
+        }
+
+        if (!found)
+        {
+            descend(descriptor.get_next_symbol(), descriptor.right_extent);
+        }
+        else
+        {
+            skip(descriptor.copy_and_advance());
+        }
+    }
+    else
+    {
+        ascend(descriptor);
+
+        if (descriptor.is_empty())
+        {
+            epn_set.insert(EPN(descriptor));
+            enforce_memory_budget(epn_set);
+        }
+    }
+}
+
+/**
+ * @brief Copies the descriptors and EPNs of a nonterminal at a position after
+ * the edit from the previous result, if the previous parse descended into it,
+ * and those of the nonterminals that they descend into. The copies are not
+ * processed again, and only the completed descriptors of the nonterminal are
+ * added to the descriptor store, for 'skip'. The others never take part in
+ * 'skip' or 'ascend' again: a nonterminal that was descended into is complete.
+ *
+ * @param symbol_id Symbol id of the nonterminal.
+ * @param position Position in the edited input, at or after the edit.
+ */
+void DenseParser::reuse(unsigned int symbol_id, unsigned int position)
+{
+    std::vector<std::pair<unsigned int, unsigned int>> stack = { { symbol_id, position } };
+
+    while (!stack.empty())
+    {
+        auto pair = stack.back();
+        stack.pop_back();
+
+        if (!reused.insert(make_key(pair.first, pair.second)).second)
+        {
+            continue;
+        }
+
+        uint64_t previous_key = make_key(pair.first, static_cast<unsigned int>(pair.second - shift));
+        auto descriptors = reusable_descriptors.find(previous_key);
+
+        if (descriptors == reusable_descriptors.end())
+        {
+            continue;
+        }
+
+        for (auto& descriptor : descriptors->second)
+        {
+            Descriptor shifted(
+                descriptor.slot,
+                static_cast<unsigned int>(descriptor.left_extent + shift),
+                static_cast<unsigned int>(descriptor.right_extent + shift)
+            );
+
+            reused_descriptors.insert(shifted);
+
+            if (!shifted.is_completed() && !shifted.slot->next_is_terminal)
+            {
+                stack.push_back(std::make_pair(shifted.slot->next_symbol_id, shifted.right_extent));
+            }
+        }
+
+        auto epns = reusable_epns.find(previous_key);
+
+        if (epns != reusable_epns.end())
+        {
+            for (auto& epn : epns->second)
+            {
+                epn_set.insert(EPN(
+                    epn.slot,
+                    static_cast<unsigned int>(epn.left_extent + shift),
+                    static_cast<unsigned int>(epn.pivot + shift),
+                    static_cast<unsigned int>(epn.right_extent + shift)
+                ));
+            }
+
+            enforce_memory_budget(epn_set);
+        }
+    }
+
+    if (!loaded.insert(make_key(symbol_id, position)).second)
+    {
+        return;
+    }
+
+    auto descriptors = reusable_descriptors.find(make_key(symbol_id, static_cast<unsigned int>(position - shift)));
+
+    if (descriptors != reusable_descriptors.end())
+    {
+        for (auto& descriptor : descriptors->second)
+        {
+            if (descriptor.is_completed())
+            {
+                descriptor_store.insert(Descriptor(
+                    descriptor.slot,
+                    static_cast<unsigned int>(descriptor.left_extent + shift),
+                    static_cast<unsigned int>(descriptor.right_extent + shift)
+                ));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds the kept descriptors that wait for a nonterminal at a position
+ * before the edit to the descriptor store, for 'ascend'.
+ *
+ * @param symbol_id Symbol id of the nonterminal.
+ * @param position Position before the edit.
+ */
+void DenseParser::load_waiting(unsigned int symbol_id, unsigned int position)
+{
+    uint64_t key = make_key(symbol_id, position);
+
+    if (!loaded.insert(key).second)
+    {
+        return;
+    }
+
+    auto descriptors = waiting_before_edit.find(key);
+
+    if (descriptors != waiting_before_edit.end())
+    {
+        for (auto& descriptor : descriptors->second)
+        {
+            descriptor_store.insert(descriptor);
+        }
+    }
+}
+
+/**
+ * @brief Keeps the part of the previous result before the edit, puts the
+ * descriptors that end at the start of the edit in the worklist, and indexes
+ * the rest for reuse() and load_waiting(). Kept descriptors are only added to
+ * the descriptor store when needed.
+ */
+void DenseParser::seed_from_previous_result()
+{
+    unsigned int edit_begin = static_cast<unsigned int>(edit->begin);
+    unsigned int previous_end = static_cast<unsigned int>(edit->end);
+
+    reused_descriptors.reserve(previous_result->descriptors.size());
+
+    for (auto& previous : previous_result->descriptors)
+    {
+        Descriptor descriptor(grammar.get_slot(previous.slot->id), previous.left_extent, previous.right_extent);
+
+        if (descriptor.right_extent < edit_begin)
+        {
+            reused_descriptors.insert(descriptor);
+
+            if (!descriptor.is_completed() && !descriptor.slot->next_is_terminal)
+            {
+                waiting_before_edit[make_key(descriptor.slot->next_symbol_id, descriptor.right_extent)].push_back(descriptor);
+            }
+        }
+        else if (descriptor.right_extent == edit_begin)
+        {
+            add_new_to_worklist(descriptor);
+        }
+
+        if (descriptor.left_extent >= previous_end)
+        {
+            reusable_descriptors[make_key(descriptor.slot->lhs_id, descriptor.left_extent)].push_back(descriptor);
+        }
+    }
+
+    for (auto& previous : previous_result->epns)
+    {
+        EPN epn(grammar.get_slot(previous.slot->id), previous.left_extent, previous.pivot, previous.right_extent);
+
+        if (epn.right_extent <= edit_begin)
+        {
+            epn_set.insert(epn);
+        }
+
+        if (epn.left_extent >= previous_end)
+        {
+            reusable_epns[make_key(epn.slot->lhs_id, epn.left_extent)].push_back(epn);
+        }
+    }
+
+    enforce_memory_budget(epn_set);
+}
+
+/**
+ * @brief Parses an input after an edit, reusing the previous result before and
+ * after the edit.
+ *
+ * @param previous_input Input before the edit.
+ * @param previous Result of parsing the previous input with the same grammar,
+ *                 with all of its EPNs.
+ * @param token_edit Edit of the previous input, valid for its length.
+ *
+ * @return Descriptors and EPNs of the edited input, equal to those
+ * of parsing it from scratch.
+ */
+ParseResult DenseParser::reparse(
+    const std::vector<std::string>& previous_input,
+    const ParseResult& previous,
+    const TokenEdit& token_edit
+)
+{
+    previous_result = &previous;
+    edit = &token_edit;
+    edit_end = static_cast<unsigned int>(token_edit.begin + token_edit.tokens.size());
+    shift = static_cast<long>(edit_end) - static_cast<long>(token_edit.end);
+
+    auto result = Parser::parse(token_edit.apply(previous_input));
+
+    previous_result = nullptr;
+    edit = nullptr;
+    reused_descriptors = descriptor_set_t();
+    reusable_descriptors.clear();
+    reusable_epns.clear();
+    waiting_before_edit.clear();
+    reused.clear();
+    loaded.clear();
+
+    return result;
+}
+
+/**
+ * @brief Call the parse method of the base class.
+ */
+ParseResult DenseParser::parse(std::vector<std::string> input_sequence)
+{
+    return Parser::parse(std::move(input_sequence));
+}
+
+/**
+ * @brief Processes descriptors one by one, taking them from the worklist in
+ * the order of its policy.
+ */
+void DenseParser::loop()
+{
+    /* Clear the output of a previous parse, and the worklist of one that was
+       stopped. */
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+    worklist = Worklist(worklist_policy, false);
+#else
+    worklist = Worklist(worklist_policy);
+#endif
+    descriptor_store.reset(grammar.num_slots(), input.size());
+    epn_set.clear();
+    right_extents.assign(descriptor_store.bitvector_words(), 0);
+
+    ThreadStatistics& counters = Statistics::current();
+
+    statistics.worklist_policy = worklist_policy;
+
+    if (edit)
+    {
+        seed_from_previous_result();
+
+        /* Kept descriptors are not in the descriptor store, so adding the
+           kept start descriptors again would parse the whole input before the
+           edit again. */
+        for (auto slot : grammar.get_initial_slots(grammar.start_symbol))
+        {
+            if (!reused_descriptors.count(Descriptor(slot, 0, 0)))
+            {
+                add_to_worklist(Descriptor(slot, 0, 0));
+            }
+        }
+    }
+    else
+    {
+        extend_worklist(
+            grammar.get_initial_slots(grammar.start_symbol)
+        );
+    }
+
+    while (!worklist.empty() && !should_stop())
+    {
+        counters.record_queue_depth(worklist.size());
+
+        Descriptor d = worklist.take();
+#ifndef OPTIMISATION_INSERT_ON_DISCOVER
+        descriptor_store.insert(d);
+#endif
+
+        process_descriptor(d);
+
+        counters.num_processed++;
+    }
+}
+
+/**
+ * @return The descriptors in the store as a set, with the reused descriptors
+ * during reparse(), and the EPN set, moved out of the parser.
+ */
+ParseResult DenseParser::get_result()
+{
+    descriptor_set_t descriptors = descriptor_store.to_set(grammar);
+
+    if (edit)
+    {
+        descriptors.insert(reused_descriptors.begin(), reused_descriptors.end());
+    }
+
+    return ParseResult(std::move(descriptors), std::move(epn_set));
+}
+
+/**
+ * @brief Print data for experiments.
+ */
+void DenseParser::print_data(const ParseResult& result)
+{
+    std::cout << input.size()
+              << "," << timer.elapsedMilliseconds()
+              << "," << statistics.total().num_processed
+              << "," << 1
+              << "," << result.descriptors.size()
+              << "," << num_epns(result.epns)
+              << std::endl;
+}
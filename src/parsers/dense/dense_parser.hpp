@@ -0,0 +1,85 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with the serial parser that keeps its descriptors in a dense
+ *   descriptor store.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include "../../components/parser.hpp"
+#include "../../components/descriptor_store.hpp"
+
+class DenseParser : public Parser
+{
+public:
+    Worklist worklist;
+    DescriptorStore descriptor_store;
+    epn_set_t epn_set;
+private:
+    /* Right extents found by the last 'skip' lookup. */
+    std::vector<uint64_t> right_extents;
+    /* Extents of 'skip' and 'ascend' that do not have a descriptor yet. */
+    std::vector<uint64_t> new_extents;
+    /* Result of the previous input and the edit during reparse(), or null. */
+    const ParseResult* previous_result = nullptr;
+    const TokenEdit* edit = nullptr;
+    /* Position after the new tokens of the edit, and the difference between
+       the positions after the edit in the edited and the previous input. */
+    unsigned int edit_end = 0;
+    long shift = 0;
+    /* Descriptors of the result that were kept or copied from the previous
+       result instead of processed. Only some are in the descriptor store. */
+    descriptor_set_t reused_descriptors;
+    /* Descriptors and EPNs of the previous result that start after the edit,
+       by the key of their left-hand side and left extent. */
+    std::unordered_map<uint64_t, std::vector<Descriptor>> reusable_descriptors;
+    std::unordered_map<uint64_t, std::vector<EPN>> reusable_epns;
+    /* Kept descriptors that end before the edit and wait for a nonterminal,
+       by the key of the nonterminal and their right extent. */
+    std::unordered_map<uint64_t, std::vector<Descriptor>> waiting_before_edit;
+    /* Keys of the nonterminals after the edit whose descriptors were copied. */
+    std::unordered_set<uint64_t> reused;
+    /* Keys of the nonterminals whose reused descriptors needed by 'skip' or
+       'ascend' were added to the descriptor store. */
+    std::unordered_set<uint64_t> loaded;
+public:
+    DenseParser(Grammar g) : Parser(g) {};
+public:
+    ParseResult parse(std::vector<std::string> input_sequence);
+    ParseResult reparse(
+        const std::vector<std::string>& previous_input,
+        const ParseResult& previous,
+        const TokenEdit& token_edit
+    ) override;
+private:
+    void loop() override;
+    ParseResult get_result() override;
+    void print_data(const ParseResult& result) override;
+    void process_descriptor(Descriptor descriptor);
+    void match(Descriptor descriptor);
+    void descend(const std::string& symbol, unsigned int pivot);
+    void skip(Descriptor descriptor);
+    void ascend(Descriptor descriptor);
+    void add_to_worklist(Descriptor descriptor);
+    void add_new_to_worklist(Descriptor descriptor);
+    void extend_worklist(
+        const std::vector<const GrammarSlot*>& slots,
+        unsigned int left_extent = 0,
+        unsigned int right_extent = 0
+    );
+    void seed_from_previous_result();
+    void reuse(unsigned int symbol_id, unsigned int position);
+    void load_waiting(unsigned int symbol_id, unsigned int position);
+
+    /**
+     * @return Key of a nonterminal at a position.
+     */
+    static uint64_t make_key(unsigned int symbol_id, unsigned int position)
+    {
+        return (static_cast<uint64_t>(position) << 32) | symbol_id;
+    }
+};
@@ -8,136 +8,100 @@
 
 #include <iostream>
 #include <thread>
+#include <chrono>
 #include "../../utilities/print.hpp"
 #include "parallel_pool.hpp"
 
 #include <algorithm>
 
-/* Number of threads to spawn. */
-#define NUM_THREADS 16
-/* Define when getting thread usage data. */
-#define WORKING_THREADS_DATA
-/* Define when getting action usage data. */
-// #define ACTIONS_DATA
-
-namespace
-{
-#ifdef WORKING_THREADS_DATA
-    std::array<unsigned long, NUM_THREADS + 1> working_treads_data;
-#endif
-#ifdef ACTIONS_DATA
-    std::array<int, 4> actions_data;
-#endif
-    std::mutex epn_set_mutex;
-#ifndef OPTIMISATION_POOL_QUEUES
-    descriptor_set_t worklist;
-    std::mutex worklist_mutex;
-#endif
-    descriptor_set_t descriptor_set;
-#ifdef OPTIMISATION_POOL_SHARED_LOCKS
-    std::shared_mutex descriptor_set_mutex;
-#else
-    std::mutex descriptor_set_mutex;
-#endif
-    epn_set_t epn_set;
-    std::atomic<int> num_descriptors;
-    std::atomic<int> working_threads;
-    std::atomic<bool> stop_threads;
-    std::condition_variable thread_cv;
-    std::mutex thread_cv_mutex;
-    std::condition_variable main_cv;
-    std::mutex main_cv_mutex;
-#ifdef OPTIMISATION_POOL_GLL_P
-    std::unordered_map<
-        std::string,
-        std::pair<
-            std::unordered_map<unsigned int, std::pair<std::unordered_set<unsigned int>, std::unique_ptr<std::shared_mutex>>>,
-            std::unique_ptr<std::shared_mutex>
-        >
-    > right_extents_map;
-#endif
-#ifdef OPTIMISATION_POOL_QUEUES
-    std::vector<std::mutex> worklist_mutexes;
-    std::vector<descriptor_set_t> worklists;
-    std::mutex global_worklist_mutex;
-    descriptor_set_t global_worklist;
-    size_t rr_thread_id;
-#endif
-}
-
 /**
  * @brief Call the parse method of the base class.
  */
-std::tuple<descriptor_set_t, epn_set_t> ThreadPoolParser::parse(std::vector<std::string> input_sequence)
+ParseResult ThreadPoolParser::parse(std::vector<std::string> input_sequence)
 {
-    return Parser::parse(input_sequence);
+    return Parser::parse(std::move(input_sequence));
 }
 
 /**
- * @brief Spawn threads at the start, then add descriptors for the start
- * symbol to the worklist. The main thread blocks until its condition variable
- * is notified, then it joins all threads and returns the output of the parser.
+ * @brief Starts the worker threads of the parser, then adds descriptors for
+ * the start symbol to the worklist. The main thread blocks until its
+ * condition variable is notified, then it waits for all threads.
  */
-std::tuple<descriptor_set_t, epn_set_t> ThreadPoolParser::loop()
+void ThreadPoolParser::loop()
 {
-    std::vector<std::thread> threads;
-    unsigned int num_threads = NUM_THREADS;
-
-    num_descriptors = 0;
+    /* Clear the state left behind by a previous parse. */
+    descriptor_set.clear();
+    epn_set.clear();
     working_threads = 0;
     stop_threads = false;
+    statistics.working_threads.assign(num_threads + 1, 0);
+    statistics.worklist_policy = worklist_policy;
+#ifdef OPTIMISATION_POOL_GLL_P
+    right_extents_map.clear();
+#endif
 
 #ifdef OPTIMISATION_POOL_QUEUES
     rr_thread_id = 0;
-    std::vector<std::mutex> tmp(num_threads);
+    std::vector<ProfiledMutex> tmp(num_threads);
     worklist_mutexes.swap(tmp);
-#endif
 
-    for (unsigned int i = 0; i < num_threads; i++)
+    for (auto& mutex : worklist_mutexes)
     {
+        mutex.set_name(statistics.locks, "pool.worklist_mutexes");
+    }
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+    worklists.assign(num_threads, Worklist(worklist_policy, false));
+    global_worklist = Worklist(worklist_policy, false);
+#else
+    worklists.assign(num_threads, Worklist(worklist_policy));
+    global_worklist = Worklist(worklist_policy);
+#endif
+#elif defined(OPTIMISATION_INSERT_ON_DISCOVER)
+    worklist = Worklist(worklist_policy, false);
+#else
+    worklist = Worklist(worklist_policy);
+#endif
+
 #ifdef OPTIMISATION_POOL_QUEUES
-        worklists.push_back(descriptor_set_t());
-        threads.push_back(std::thread(&ThreadPoolParser::thread_function, this, i));
+    worker_threads.start(num_threads, [this](size_t i) { thread_function(static_cast<unsigned int>(i)); });
 #else
-        threads.push_back(std::thread(&ThreadPoolParser::thread_function, this));
+    worker_threads.start(num_threads, [this](size_t) { thread_function(); });
 #endif
-    }
 
     extend_worklist(
-        grammar.get_production_rules(grammar.start_symbol)
+        grammar.get_initial_slots(grammar.start_symbol)
     );
 
 
 #ifndef OPTIMISATION_POOL_QUEUES
     {
         std::unique_lock<std::mutex> lock(main_cv_mutex);
-        main_cv.wait(lock);
+        main_cv.wait(lock, [this]() { return stop_threads.load(); });
     }
 #else
-    while(!(all_worklists_empty() && working_threads.load() == 0 && global_worklist.empty()))
+    while(!stop_threads.load() && !(all_worklists_empty() && working_threads.load() == 0 && global_worklist.empty()))
     {
-#ifdef WORKING_THREADS_DATA
-        working_treads_data[working_threads.load()]++;
-#endif
+        statistics.working_threads[working_threads.load()]++;
 
         if (global_worklist.empty())
         {
             continue;
         }
 
-        std::lock_guard<std::mutex> lock(global_worklist_mutex);
+        std::lock_guard<ProfiledMutex> lock(global_worklist_mutex);
         {
-            for (auto item : global_worklist)
+            /* Hand out the descriptors in the order of the policy. */
+            while (!global_worklist.empty())
             {
+                Descriptor item = global_worklist.take();
+
                 {
-                    std::lock_guard<std::mutex> lock_local(worklist_mutexes[rr_thread_id]);
+                    std::lock_guard<ProfiledMutex> lock_local(worklist_mutexes[rr_thread_id]);
                     worklists[rr_thread_id++].insert(item);
                 }
 
                 rr_thread_id %= num_threads;
             }
-
-            global_worklist.clear();
         }
 
         thread_cv.notify_all();
@@ -147,46 +111,29 @@ std::tuple<descriptor_set_t, epn_set_t> ThreadPoolParser::loop()
     thread_cv.notify_all();
 #endif
 
-    for (auto& thread : threads)
-    {
-        thread.join();
-    }
+    worker_threads.wait();
+}
 
-    return std::make_tuple(descriptor_set, epn_set);
+/**
+ * @return The descriptor set and EPN set, moved out of the parser.
+ */
+ParseResult ThreadPoolParser::get_result()
+{
+    return ParseResult(std::move(descriptor_set), std::move(epn_set));
 }
 
 /**
  * @brief Print data for experiments.
  */
-void ThreadPoolParser::print_data()
+void ThreadPoolParser::print_data(const ParseResult& result)
 {
-#ifdef WORKING_THREADS_DATA
-    std::cout << input.size();
-    for (auto element : working_treads_data)
-    {
-        std::cout << "," << element;
-    }
-
-    std::cout << std::endl;
-#else
-#ifdef ACTIONS_DATA
-    std::cout << input.size();
-    for (auto element : actions_data)
-    {
-        std::cout << "," << element;
-    }
-
-    std::cout << std::endl;
-#else
     std::cout << input.size()
               << "," << timer.elapsedMilliseconds()
-              << "," << num_descriptors
-              << "," << NUM_THREADS
-              << "," << descriptor_set.size()
-              << "," << epn_set.size()
+              << "," << statistics.total().num_processed
+              << "," << num_threads
+              << "," << result.descriptors.size()
+              << "," << num_epns(result.epns)
               << std::endl;
-#endif
-#endif
 }
 
 /**
@@ -194,7 +141,8 @@ void ThreadPoolParser::print_data()
  * true. Each loop the thread blocks until its condition variable is notified,
  * unless signalled to stop or the worklist is not empty.
  * It processed a descriptor from the worklist and at the end of each iteration,
- * it signals all threads to stop when the conditions are right.
+ * it signals all threads to stop when the conditions are right, or when the
+ * parse exceeds one of its limits.
  */
 #ifdef OPTIMISATION_POOL_QUEUES
 void ThreadPoolParser::thread_function(unsigned int thread_id)
@@ -204,6 +152,7 @@ void ThreadPoolParser::thread_function()
 {
     Descriptor d;
     bool process;
+    ThreadStatistics& counters = statistics.add_thread();
 #ifndef OPTIMISATION_POOL_QUEUES
     int working_threads_count;
 #endif
@@ -216,6 +165,7 @@ void ThreadPoolParser::thread_function()
 #ifndef OPTIMISATION_POOL_QUEUES
             std::unique_lock<std::mutex> lock(thread_cv_mutex);
 #endif
+            auto idle_start = std::chrono::steady_clock::now();
 
             /* Wait for notification that new item was added to the work list,
                or that all threads need to stop. */
@@ -229,6 +179,10 @@ void ThreadPoolParser::thread_function()
                 thread_cv.wait(lock);
 #endif
             }
+
+            counters.idle_time += static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - idle_start
+            ).count());
         }
 
         /* Break out of the loop if signalled to stop. */
@@ -239,9 +193,9 @@ void ThreadPoolParser::thread_function()
 
         {
 #ifdef OPTIMISATION_POOL_QUEUES
-            std::lock_guard<std::mutex> lock(worklist_mutexes[thread_id]);
+            std::lock_guard<ProfiledMutex> lock(worklist_mutexes[thread_id]);
 #else
-            std::lock_guard<std::mutex> lock(worklist_mutex);
+            std::lock_guard<ProfiledMutex> lock(worklist_mutex);
 #endif
 
             /* Necessary because other threads could have emptied the worklist. */
@@ -256,21 +210,39 @@ void ThreadPoolParser::thread_function()
 
             working_threads.fetch_add(1);
 
-            /* Get the first item from the worklist and remove it. */
+            /* Take the next item from the worklist. */
 #ifdef OPTIMISATION_POOL_QUEUES
-            d = *worklists[thread_id].begin();
-            worklists[thread_id].erase(d);
+            counters.record_queue_depth(worklists[thread_id].size());
+            d = worklists[thread_id].take();
 #else
-            d = *worklist.begin();
-            worklist.erase(d);
+            counters.record_queue_depth(worklist.size());
+            d = worklist.take();
 #endif
         }
 
+        /* Stop all threads if the parse exceeded a limit. */
+        if (should_stop())
+        {
+            working_threads.fetch_sub(1);
+            {
+                std::lock_guard<std::mutex> lock(main_cv_mutex);
+                stop_threads.store(true);
+            }
+            main_cv.notify_one();
+            thread_cv.notify_all();
+            break;
+        }
+
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+        /* The thread that discovered the descriptor added it to the set, and
+           no other thread took it from a worklist. */
+        process = true;
+#else
         {
 #ifdef OPTIMISATION_POOL_SHARED_LOCKS
-            std::unique_lock<std::shared_mutex> lock(descriptor_set_mutex);
+            std::unique_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
 #else
-            std::lock_guard<std::mutex> lock(descriptor_set_mutex);
+            std::lock_guard<ProfiledMutex> lock(descriptor_set_mutex);
 #endif
 
             /* Necessary because some other threads may have added the descriptor
@@ -281,11 +253,16 @@ void ThreadPoolParser::thread_function()
                 process = true;
             }
         }
+#endif
 
         if (process)
         {
             process_descriptor(d);
-            num_descriptors.fetch_add(1);
+            counters.num_processed++;
+        }
+        else
+        {
+            counters.num_duplicates++;
         }
 
         /* Notify the main thread if all threads are idle and the worklist is empty. */
@@ -296,13 +273,18 @@ void ThreadPoolParser::thread_function()
 
         if (working_threads_count - 1 == 0 && worklist.empty())
         {
-            stop_threads.store(true);
+            {
+                std::lock_guard<std::mutex> lock(main_cv_mutex);
+                stop_threads.store(true);
+            }
             main_cv.notify_one();
             thread_cv.notify_all();
             break;
         }
 #endif
     }
+
+    counters.stop_cpu_clock();
 }
 
 /**
@@ -315,10 +297,10 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
 {
     if (!descriptor.is_completed())
     {
-        std::unordered_set<unsigned int> right_extents;
-        std::string symbol = descriptor.get_next_symbol();
+        pooled_set_t<unsigned int> right_extents;
+        const std::string& symbol = descriptor.get_next_symbol();
 
-        if (grammar.terminals.count(symbol))
+        if (descriptor.slot->next_is_terminal)
         {
             match(descriptor);
         }
@@ -329,11 +311,11 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
             {
                 auto& outer = right_extents_map.at(symbol);
                 {
-                    std::shared_lock<std::shared_mutex> lock_outer(*outer.second.get());
+                    std::shared_lock<ProfiledSharedMutex> lock_outer(*outer.second.get());
                     auto& inner = outer.first.at(descriptor.right_extent);
 
                     {
-                        std::shared_lock<std::shared_mutex> lock_inner(*inner.second.get());
+                        std::shared_lock<ProfiledSharedMutex> lock_inner(*inner.second.get());
                         right_extents = inner.first;
                     }
                 }
@@ -342,14 +324,14 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
 #else
             {
 #ifdef OPTIMISATION_POOL_SHARED_LOCKS
-                std::shared_lock<std::shared_mutex> lock(descriptor_set_mutex);
+                std::shared_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
 #else
-                std::lock_guard<std::mutex> lock(descriptor_set_mutex);
+                std::lock_guard<ProfiledMutex> lock(descriptor_set_mutex);
 #endif
 
                 for (auto d : descriptor_set)
                 {
-                    if (d.lhs == symbol && d.left_extent == descriptor.right_extent && d.is_completed())
+                    if (d.slot->lhs_id == descriptor.slot->next_symbol_id && d.left_extent == descriptor.right_extent && d.is_completed())
                     {
                         right_extents.insert(d.right_extent);
                     }
@@ -373,14 +355,14 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
 
         {
 #ifdef OPTIMISATION_POOL_SHARED_LOCKS
-            std::shared_lock<std::shared_mutex> lock(descriptor_set_mutex);
+            std::shared_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
 #else
-            std::lock_guard<std::mutex> lock(descriptor_set_mutex);
+            std::lock_guard<ProfiledMutex> lock(descriptor_set_mutex);
 #endif
 
             for (auto d : descriptor_set)
             {
-                if (!d.is_completed() && d.get_next_symbol() == descriptor.lhs && d.right_extent == descriptor.left_extent)
+                if (!d.is_completed() && d.slot->next_symbol_id == descriptor.slot->lhs_id && d.right_extent == descriptor.left_extent)
                 {
                     descriptors.insert(d.copy_and_advance());
                 }
@@ -388,28 +370,28 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
         }
 
 #ifdef OPTIMISATION_POOL_GLL_P
-        if (!right_extents_map.count(descriptor.lhs))
+        if (!right_extents_map.count(descriptor.lhs()))
         {
             right_extents_map.insert(
                 std::make_pair(
-                    descriptor.lhs, std::make_pair(
-                        std::unordered_map<unsigned int, std::pair<std::unordered_set<unsigned int>, std::unique_ptr<std::shared_mutex>>>(),
-                        std::make_unique<std::shared_mutex>()
+                    descriptor.lhs(), std::make_pair(
+                        std::unordered_map<unsigned int, std::pair<pooled_set_t<unsigned int>, std::unique_ptr<ProfiledSharedMutex>>>(),
+                        std::make_unique<ProfiledSharedMutex>(statistics.locks, "pool.right_extents_map")
                     )
                 )
             );
         }
 
         {
-            std::unique_lock<std::shared_mutex> lock(*right_extents_map[descriptor.lhs].second.get());
+            std::unique_lock<ProfiledSharedMutex> lock(*right_extents_map[descriptor.lhs()].second.get());
 
-            if (!right_extents_map[descriptor.lhs].first.count(descriptor.left_extent))
+            if (!right_extents_map[descriptor.lhs()].first.count(descriptor.left_extent))
             {
-                right_extents_map[descriptor.lhs].first.insert(
+                right_extents_map[descriptor.lhs()].first.insert(
                     std::make_pair(
                         descriptor.left_extent, std::make_pair(
-                            std::unordered_set<unsigned int>(),
-                            std::make_unique<std::shared_mutex>()
+                            pooled_set_t<unsigned int>(),
+                            std::make_unique<ProfiledSharedMutex>(statistics.locks, "pool.right_extents_map_entry")
                         )
                     )
                 );
@@ -417,8 +399,8 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
         }
 
         {
-            std::unique_lock<std::shared_mutex> lock(*right_extents_map[descriptor.lhs].first[descriptor.left_extent].second.get());
-            right_extents_map[descriptor.lhs].first[descriptor.left_extent].first.insert(descriptor.right_extent);
+            std::unique_lock<ProfiledSharedMutex> lock(*right_extents_map[descriptor.lhs()].first[descriptor.left_extent].second.get());
+            right_extents_map[descriptor.lhs()].first[descriptor.left_extent].first.insert(descriptor.right_extent);
         }
 #endif
 
@@ -427,8 +409,9 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
         if (descriptor.is_empty())
         {
             {
-                std::lock_guard<std::mutex> lock(epn_set_mutex);
+                std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
                 epn_set.insert(EPN(descriptor));
+                enforce_memory_budget(epn_set);
             }
         }
     }
@@ -442,13 +425,11 @@ void ThreadPoolParser::process_descriptor(Descriptor descriptor)
  */
 void ThreadPoolParser::match(Descriptor descriptor)
 {
-    std::string terminal = descriptor.get_next_symbol();
+    const std::string& terminal = descriptor.get_next_symbol();
 
-#ifdef ACTIONS_DATA
-    actions_data[0]++;
-#endif
+    Statistics::current().num_match++;
 
-    if (input.size() > 0 && terminal == input[descriptor.right_extent])
+    if (descriptor.right_extent < input.size() && terminal == input[descriptor.right_extent])
     {
         Descriptor d = descriptor.copy_and_advance();
         d.right_extent++;
@@ -456,8 +437,9 @@ void ThreadPoolParser::match(Descriptor descriptor)
         add_to_worklist(d);
 
         {
-            std::lock_guard<std::mutex> lock(epn_set_mutex);
+            std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
             epn_set.insert(EPN(d, descriptor.right_extent));
+            enforce_memory_budget(epn_set);
         }
     }
 }
@@ -469,14 +451,12 @@ void ThreadPoolParser::match(Descriptor descriptor)
  * @param symbol Symbol use to get production rules from the grammar.
  * @param pivot Pivot of the processed descriptor.
  */
-void ThreadPoolParser::descend(std::string symbol, unsigned int pivot)
+void ThreadPoolParser::descend(const std::string& symbol, unsigned int pivot)
 {
-#ifdef ACTIONS_DATA
-    actions_data[1]++;
-#endif
+    Statistics::current().num_descend++;
 
     extend_worklist(
-        grammar.get_production_rules(symbol),
+        grammar.get_initial_slots(symbol),
         pivot,
         pivot
     );
@@ -489,23 +469,26 @@ void ThreadPoolParser::descend(std::string symbol, unsigned int pivot)
  * @param descriptor Descriptor to process.
  * @param right_extents Right extents to apply to the new descriptors.
  */
-void ThreadPoolParser::skip(Descriptor descriptor, std::unordered_set<unsigned int> right_extents)
+void ThreadPoolParser::skip(Descriptor descriptor, const pooled_set_t<unsigned int>& right_extents)
 {
-#ifdef ACTIONS_DATA
-    actions_data[3]++;
-#endif
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_skip++;
 
-    for (int right_extent : right_extents)
+    for (unsigned int right_extent : right_extents)
     {
         Descriptor new_descriptor(descriptor);
         new_descriptor.right_extent = right_extent;
 
         add_to_worklist(new_descriptor);
 
-        {
-            std::lock_guard<std::mutex> lock(epn_set_mutex);
-            epn_set.insert(EPN(new_descriptor, descriptor.right_extent));
-        }
+        epns.push_back(EPN(new_descriptor, descriptor.right_extent));
+    }
+
+    {
+        std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
+        epn_set.insert(epns.begin(), epns.end());
+        enforce_memory_budget(epn_set);
     }
 }
 
@@ -516,11 +499,11 @@ void ThreadPoolParser::skip(Descriptor descriptor, std::unordered_set<unsigned i
  * @param descriptors Descriptors to process.
  * @param right_extent Right extent to apply to the new descriptors.
  */
-void ThreadPoolParser::ascend(descriptor_set_t descriptors, unsigned int right_extent)
+void ThreadPoolParser::ascend(const descriptor_set_t& descriptors, unsigned int right_extent)
 {
-#ifdef ACTIONS_DATA
-    actions_data[2]++;
-#endif
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_ascend++;
 
     for (auto descriptor : descriptors)
     {
@@ -529,35 +512,40 @@ void ThreadPoolParser::ascend(descriptor_set_t descriptors, unsigned int right_e
 
         add_to_worklist(new_descriptor);
 
-        {
-            std::lock_guard<std::mutex> lock(epn_set_mutex);
-            epn_set.insert(EPN(new_descriptor, descriptor.right_extent));
-        }
+        epns.push_back(EPN(new_descriptor, descriptor.right_extent));
+    }
+
+    {
+        std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
+        epn_set.insert(epns.begin(), epns.end());
+        enforce_memory_budget(epn_set);
     }
 }
 
 /**
  * @brief Adds new descriptors to the worklist.
  *
- * @param rules Production rules used to make new descriptors.
+ * @param slots Initial slots of the production rules used to make new descriptors.
  * @param left_extent Left extent.
  * @param right_extent Right extent.
  */
 void ThreadPoolParser::extend_worklist(
-    std::vector<production_rule_t> rules,
-    int left_extent,
-    int right_extent
+    const std::vector<const GrammarSlot*>& slots,
+    unsigned int left_extent,
+    unsigned int right_extent
 )
 {
-    for (auto rule : rules)
+    for (auto slot : slots)
     {
-        add_to_worklist(Descriptor(rule.first, rule.second, 0, left_extent, right_extent));
+        add_to_worklist(Descriptor(slot, left_extent, right_extent));
     }
 }
 
 /**
  * @brief Adds a new descriptor to the worklist. Critical code blocks are
- * locked.
+ * locked. With OPTIMISATION_INSERT_ON_DISCOVER, the descriptor is added to the
+ * descriptor set here, and to the worklist only by the thread that added it to
+ * the set.
  *
  * @param descriptor Descriptor to add.
  */
@@ -566,27 +554,39 @@ void ThreadPoolParser::add_to_worklist(Descriptor descriptor)
     size_t count;
 
     {
-#ifdef OPTIMISATION_POOL_SHARED_LOCKS
-        std::shared_lock<std::shared_mutex> lock(descriptor_set_mutex);
+#if defined(OPTIMISATION_INSERT_ON_DISCOVER) && defined(OPTIMISATION_POOL_SHARED_LOCKS)
+        std::unique_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
+        count = !descriptor_set.insert(descriptor).second;
+#elif defined(OPTIMISATION_INSERT_ON_DISCOVER)
+        std::lock_guard<ProfiledMutex> lock(descriptor_set_mutex);
+        count = !descriptor_set.insert(descriptor).second;
+#elif defined(OPTIMISATION_POOL_SHARED_LOCKS)
+        std::shared_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
+        count = descriptor_set.count(descriptor);
 #else
-        std::lock_guard<std::mutex> lock(descriptor_set_mutex);
-#endif
+        std::lock_guard<ProfiledMutex> lock(descriptor_set_mutex);
         count = descriptor_set.count(descriptor);
+#endif
     }
 
     if (!count)
     {
         {
 #ifdef OPTIMISATION_POOL_QUEUES
-            std::lock_guard<std::mutex> lock(global_worklist_mutex);
-            global_worklist.insert(descriptor);
+            std::lock_guard<ProfiledMutex> lock(global_worklist_mutex);
+            count = !global_worklist.insert(descriptor);
 #else
-            std::lock_guard<std::mutex> lock(worklist_mutex);
-            worklist.insert(descriptor);
+            std::lock_guard<ProfiledMutex> lock(worklist_mutex);
+            count = !worklist.insert(descriptor);
             thread_cv.notify_one();
 #endif
         }
     }
+
+    if (count)
+    {
+        Statistics::current().num_duplicates++;
+    }
 }
 
 #ifdef OPTIMISATION_POOL_QUEUES
@@ -12,7 +12,14 @@
 #include <shared_mutex>
 #include <mutex>
 #include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
 #include "../../components/parser.hpp"
+#include "../../utilities/pool_allocator.hpp"
+#include "../../utilities/profiled_mutex.hpp"
+
+/* Default number of threads to spawn. */
+#define NUM_THREADS 16
 
 /**
  * Represents the Thread Pool parser. Derived from the Parser class.
@@ -20,56 +27,61 @@
 class ThreadPoolParser : public Parser
 {
 public:
-// #ifndef OPTIMISATION_POOL_QUEUES
-//     descriptor_set_t worklist;
-//     std::mutex worklist_mutex;
-// #endif
-//     descriptor_set_t descriptor_set;
-// #ifdef OPTIMISATION_POOL_SHARED_LOCKS
-//     std::shared_mutex descriptor_set_mutex;
-// #else
-//     std::mutex descriptor_set_mutex;
-// #endif
-//     epn_set_t epn_set;
-//     std::atomic<int> num_descriptors;
-//     std::atomic<int> working_threads;
-//     std::atomic<bool> stop_threads;
-//     std::condition_variable thread_cv;
-//     std::mutex thread_cv_mutex;
-//     std::condition_variable main_cv;
-//     std::mutex main_cv_mutex;
-// #ifdef OPTIMISATION_POOL_GLL_P
-//     std::unordered_map<
-//         std::string,
-//         std::pair<
-//             std::unordered_map<unsigned int, std::pair<std::unordered_set<unsigned int>, std::unique_ptr<std::shared_mutex>>>,
-//             std::unique_ptr<std::shared_mutex>
-//         >
-//     > right_extents_map;
-// #endif
-// #ifdef OPTIMISATION_POOL_QUEUES
-//     std::vector<std::mutex> worklist_mutexes;
-//     std::vector<descriptor_set_t> worklists;
-//     std::mutex global_worklist_mutex;
-//     descriptor_set_t global_worklist;
-//     size_t rr_thread_id;
-// #endif
+    /* Number of threads to spawn. */
+    unsigned int num_threads;
+private:
+    /* State of a parse, shared by the threads of this parser only. */
+    ProfiledMutex epn_set_mutex{statistics.locks, "pool.epn_set_mutex"};
+#ifndef OPTIMISATION_POOL_QUEUES
+    Worklist worklist;
+    ProfiledMutex worklist_mutex{statistics.locks, "pool.worklist_mutex"};
+#endif
+    descriptor_set_t descriptor_set;
+#ifdef OPTIMISATION_POOL_SHARED_LOCKS
+    ProfiledSharedMutex descriptor_set_mutex{statistics.locks, "pool.descriptor_set_mutex"};
+#else
+    ProfiledMutex descriptor_set_mutex{statistics.locks, "pool.descriptor_set_mutex"};
+#endif
+    epn_set_t epn_set;
+    std::atomic<int> working_threads{0};
+    std::atomic<bool> stop_threads{false};
+    std::condition_variable thread_cv;
+    std::mutex thread_cv_mutex;
+    std::condition_variable main_cv;
+    std::mutex main_cv_mutex;
+#ifdef OPTIMISATION_POOL_GLL_P
+    std::unordered_map<
+        std::string,
+        std::pair<
+            std::unordered_map<unsigned int, std::pair<pooled_set_t<unsigned int>, std::unique_ptr<ProfiledSharedMutex>>>,
+            std::unique_ptr<ProfiledSharedMutex>
+        >
+    > right_extents_map;
+#endif
+#ifdef OPTIMISATION_POOL_QUEUES
+    std::vector<ProfiledMutex> worklist_mutexes;
+    std::vector<Worklist> worklists;
+    ProfiledMutex global_worklist_mutex{statistics.locks, "pool.global_worklist_mutex"};
+    Worklist global_worklist;
+    size_t rr_thread_id = 0;
+#endif
 public:
-    ThreadPoolParser(Grammar g) : Parser(g) { /*num_descriptors = 0;*/ };
+    ThreadPoolParser(Grammar g, unsigned int t = NUM_THREADS) : Parser(g), num_threads(t) {};
 public:
-    std::tuple<descriptor_set_t, epn_set_t> parse(std::vector<std::string> input_sequence);
+    ParseResult parse(std::vector<std::string> input_sequence);
 private:
-    std::tuple<descriptor_set_t, epn_set_t> loop() override;
-    void print_data() override;
+    void loop() override;
+    ParseResult get_result() override;
+    void print_data(const ParseResult& result) override;
     void process_descriptor(Descriptor descriptor);
     void match(Descriptor descriptor);
-    void descend(std::string symbol, unsigned int pivot);
-    void skip(Descriptor descriptor, std::unordered_set<unsigned int> right_extents);
-    void ascend(descriptor_set_t descriptors, unsigned int right_extent);
+    void descend(const std::string& symbol, unsigned int pivot);
+    void skip(Descriptor descriptor, const pooled_set_t<unsigned int>& right_extents);
+    void ascend(const descriptor_set_t& descriptors, unsigned int right_extent);
     void extend_worklist(
-        std::vector<production_rule_t> rules,
-        int left_extent = 0,
-        int right_extent = 0
+        const std::vector<const GrammarSlot*>& slots,
+        unsigned int left_extent = 0,
+        unsigned int right_extent = 0
     );
 #ifdef OPTIMISATION_POOL_QUEUES
     void thread_function(unsigned int thread_id);
@@ -9,6 +9,7 @@
 
 #include <iostream>
 #include <thread>
+#include <chrono>
 #include <mutex>
 #include <shared_mutex>
 #include <algorithm>
@@ -20,104 +21,106 @@
 // thread_local bool force = false;
 #endif
 
-thread_local descriptor_set_t worklist;
-thread_local descriptor_set_t descriptor_set;
-thread_local std::vector<std::thread> threads;
-#ifdef OPTIMISATION_TREE_FUTURE
-thread_local std::vector<std::promise<descriptor_set_t>> promises;
-thread_local std::vector<std::future<descriptor_set_t>> futures;
-#endif
-std::mutex epn_set_mutex;
-#ifndef OPTIMISATION_TREE_FUTURE
-std::shared_mutex descriptor_set_mutex;
-descriptor_set_t descriptor_set_global;
-#endif
-#ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
-std::shared_mutex descended_set_mutex;
-std::vector<Descriptor> descended_descriptors;
-std::shared_mutex ascended_set_mutex;
-std::vector<Descriptor> ascended_descriptors;
-#endif
-#ifdef OPTIMISATION_TREE_BETTER_LOCAL_SET
-thread_local size_t global_set_index = 0;
-std::shared_mutex global_set_mutex;
-std::vector<Descriptor> global_descriptors;
-#endif
-
 /**
  * @brief Call the parse method of the base class.
  */
-std::tuple<descriptor_set_t, epn_set_t> ThreadTreeParser::parse(std::vector<std::string> input_sequence)
+ParseResult ThreadTreeParser::parse(std::vector<std::string> input_sequence)
 {
-    return Parser::parse(input_sequence);
+    return Parser::parse(std::move(input_sequence));
 }
 
 /**
- * @brief Populate the worklist and descriptor set, then add one thread for each
- * descriptor in the set. Add all promised descriptor sets to the current set
- * and return it in the output.
+ * @brief Populate the worklist and descriptor set of the root node, then add
+ * one thread for each descriptor in the set. Add all promised descriptor sets
+ * to the set of the root node.
  */
-std::tuple<descriptor_set_t, epn_set_t> ThreadTreeParser::loop()
+void ThreadTreeParser::loop()
 {
+    /* Clear the state left behind by a previous parse. */
+    root.worklist = Worklist(worklist_policy);
+    root.descriptor_set.clear();
+    root.threads.clear();
+    epn_set.clear();
+    num_threads = 0;
+    statistics.worklist_policy = worklist_policy;
+#ifdef OPTIMISATION_TREE_FUTURE
+    root.promises.clear();
+    root.futures.clear();
+#else
+    descriptor_set_global.clear();
+#endif
+#ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
+    descended_descriptors.clear();
+    ascended_descriptors.clear();
+#endif
+#ifdef OPTIMISATION_TREE_BETTER_LOCAL_SET
+    root.global_set_index = 0;
+    global_descriptors.clear();
+#endif
+
     extend_worklist(
-        grammar.get_production_rules(grammar.start_symbol)
+        root,
+        grammar.get_initial_slots(grammar.start_symbol)
     );
 
-    for (auto descriptor : worklist)
+    for (auto descriptor : root.worklist)
     {
-        descriptor_set.insert(descriptor);
+        root.descriptor_set.insert(descriptor);
     }
 
-    for (auto descriptor : descriptor_set)
+    for (auto descriptor : root.descriptor_set)
     {
-        add_thread(descriptor);
+        add_thread(root, descriptor);
     }
 
 #ifdef OPTIMISATION_TREE_FUTURE
-    for (auto& future : futures)
+    for (auto& future : root.futures)
     {
         for (auto item : future.get())
         {
-            descriptor_set.insert(item);
+            root.descriptor_set.insert(item);
         }
     }
 #endif
 
-    for (size_t i = 0; i < threads.size(); i++)
+    for (size_t i = 0; i < root.threads.size(); i++)
     {
-        threads[i].join();
+        root.threads[i].join();
     }
+}
 
+/**
+ * @return The descriptor set and EPN set, moved out of the parser.
+ */
+ParseResult ThreadTreeParser::get_result()
+{
 #ifdef OPTIMISATION_TREE_FUTURE
-    return std::make_tuple(descriptor_set, epn_set);
+    return ParseResult(std::move(root.descriptor_set), std::move(epn_set));
 #else
-    return std::make_tuple(descriptor_set_global, epn_set);
+    return ParseResult(std::move(descriptor_set_global), std::move(epn_set));
 #endif
 }
 
 /**
  * @brief Print data for experiments.
  */
-void ThreadTreeParser::print_data()
+void ThreadTreeParser::print_data(const ParseResult& result)
 {
     std::cout << input.size()
               << "," << timer.elapsedMilliseconds()
-              << "," << num_descriptors
+              << "," << statistics.total().num_processed
               << "," << num_threads
-#ifdef OPTIMISATION_TREE_FUTURE
-              << ","<< descriptor_set.size()
-#else
-              << ","<< descriptor_set_global.size()
-#endif
-              << "," << epn_set.size()
+              << "," << result.descriptors.size()
+              << "," << num_epns(result.epns)
               << std::endl;
 }
 
 /**
  * @brief Function that is used to spawn threads. Loops until there is no more
- * work to be done. Creates a new thread for all but one new descriptor once the
- * size of the worklist hits a certain threshold. The one descriptor that does not
- * get a new thread is processed by the current thread.
+ * work to be done or the parse is stopped. Creates a new thread for all but
+ * one new descriptor once the size of the worklist hits a certain threshold.
+ * The one descriptor that does not get a new thread is processed by the
+ * current thread.
  * Once all items have been processed, the promises of the child threads are
  * are collected and sent to the parent thread.
  */
@@ -128,54 +131,57 @@ void ThreadTreeParser::thread_function(Descriptor descriptor, descriptor_set_t d
 #endif
 {
     Descriptor d;
+    TreeNode node;
+    ThreadStatistics& counters = statistics.add_thread();
 
-    worklist.insert(descriptor);
-    descriptor_set = descriptors_parent;
+    node.worklist = Worklist(worklist_policy);
+    node.worklist.insert(descriptor);
+    node.descriptor_set = std::move(descriptors_parent);
 
-    while (!worklist.empty())
+    while (!node.worklist.empty() && !should_stop())
     {
-        auto worklist_begin = worklist.begin();
+        counters.record_queue_depth(node.worklist.size());
+
 #ifdef CORRECTNESS_FIX
         force = false;
 #endif
 #ifdef OPTIMISATION_TREE_BETTER_LOCAL_SET
         {
-            std::shared_lock<std::shared_mutex> lock(global_set_mutex);
+            std::shared_lock<ProfiledSharedMutex> lock(global_set_mutex);
 
-            for (size_t i = global_set_index; i < global_descriptors.size(); i++)
+            for (size_t i = node.global_set_index; i < global_descriptors.size(); i++)
             {
-                descriptor_set.insert(global_descriptors[i]);
+                node.descriptor_set.insert(global_descriptors[i]);
             }
 
             std::cout << "SIZE: " << global_descriptors.size() << std::endl;
 
-            global_set_index = global_descriptors.size() - 1L;
+            node.global_set_index = global_descriptors.size() - 1L;
         }
 #endif
 
-        if (worklist.size() >= WORKLIST_SIZE_THRESHOLD)
+        if (node.worklist.size() >= WORKLIST_SIZE_THRESHOLD)
         {
 #ifdef OPTIMISATION_TREE_COST_REDUCTION_LOCAL_DESCRIPTORS
-            for (auto item : worklist)
+            for (auto item : node.worklist)
             {
-                descriptor_set.insert(item);
+                node.descriptor_set.insert(item);
             }
 #endif
 
-            for (size_t i = 0; i < worklist.size() - WORKLIST_SIZE_THRESHOLD + 1; i++)
+            for (size_t i = 0; i < node.worklist.size() - WORKLIST_SIZE_THRESHOLD + 1; i++)
             {
-                d = *worklist_begin++;
-                add_thread(d);
-                worklist.erase(d);
+                d = node.worklist.take();
+                add_thread(node, d);
             }
         }
 
-        d = *worklist_begin;
-        descriptor_set.insert(d);
+        d = node.worklist.take();
+        node.descriptor_set.insert(d);
 
 #ifdef OPTIMISATION_TREE_BETTER_LOCAL_SET
         {
-            std::unique_lock<std::shared_mutex> lock(global_set_mutex);
+            std::unique_lock<ProfiledSharedMutex> lock(global_set_mutex);
             global_descriptors.push_back(d);
         }
 #endif
@@ -183,7 +189,7 @@ void ThreadTreeParser::thread_function(Descriptor descriptor, descriptor_set_t d
 #ifndef OPTIMISATION_TREE_FUTURE
         /* Necessary because a write/write conflict can occur. */
         {
-            std::unique_lock<std::shared_mutex> lock(descriptor_set_mutex);
+            std::unique_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
 #ifdef OPTIMISATION_TREE_COST_REDUCTION_GLOBAL_DESCRIPTORS
             bool success = descriptor_set_global.insert(d).second;
 
@@ -193,7 +199,7 @@ void ThreadTreeParser::thread_function(Descriptor descriptor, descriptor_set_t d
 #endif
             )
             {
-                worklist.erase(d);
+                counters.num_duplicates++;
                 continue;
             }
 #else
@@ -201,33 +207,40 @@ void ThreadTreeParser::thread_function(Descriptor descriptor, descriptor_set_t d
 #endif
         }
 #endif
-        process_descriptor(d);
+        process_descriptor(node, d);
 
-        num_descriptors.fetch_add(1);
-        worklist.erase(d);
+        counters.num_processed++;
     }
 
 #ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
     working_threads.fetch_sub(1);
 #endif
 
+    /* Time spent waiting for the child threads counts as idle time. */
+    auto idle_start = std::chrono::steady_clock::now();
+
 #ifdef OPTIMISATION_TREE_FUTURE
-    for (auto& future : futures)
+    for (auto& future : node.futures)
     {
         for (auto item : future.get())
         {
-            descriptor_set.insert(item);
+            node.descriptor_set.insert(item);
         }
     }
 #endif
 
-    for (size_t i = 0; i < threads.size(); i++)
+    for (size_t i = 0; i < node.threads.size(); i++)
     {
-        threads[i].join();
+        node.threads[i].join();
     }
 
+    counters.idle_time += static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - idle_start
+    ).count());
+    counters.stop_cpu_clock();
+
 #ifdef OPTIMISATION_TREE_FUTURE
-    promise.set_value(descriptor_set);
+    promise.set_value(std::move(node.descriptor_set));
 #endif
 }
 
@@ -235,9 +248,10 @@ void ThreadTreeParser::thread_function(Descriptor descriptor, descriptor_set_t d
  * @brief Processes a descriptor. Chooses one of 'match', 'ascend', 'descend',
  * 'skip' and calls the function for the chosen operation.
  *
+ * @param node Node of the thread that processes the descriptor.
  * @param descriptor Descriptor to be processed.
  */
-void ThreadTreeParser::process_descriptor(Descriptor descriptor)
+void ThreadTreeParser::process_descriptor(TreeNode& node, Descriptor descriptor)
 {
 #ifdef CORRECTNESS_FIX
     if (descriptor.force_process)
@@ -248,24 +262,24 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
 
     if (!descriptor.is_completed())
     {
-        std::unordered_set<unsigned int> right_extents;
+        pooled_set_t<unsigned int> right_extents;
 #ifdef CORRECTNESS_FIX
-        std::vector<production_rule_t> skipped_rules;
+        std::vector<const GrammarSlot*> skipped_slots;
 #endif
-        std::string symbol = descriptor.get_next_symbol();
+        const std::string& symbol = descriptor.get_next_symbol();
 
-        if (grammar.terminals.count(symbol))
+        if (descriptor.slot->next_is_terminal)
         {
-            match(descriptor);
+            match(node, descriptor);
         }
         else
         {
 #ifdef OPTIMISATION_TREE_GLOBAL_DESCRIPTORS
             {
-                std::shared_lock<std::shared_mutex> lock(descriptor_set_mutex);
+                std::shared_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
                 for (auto d : descriptor_set_global)
                 {
-                    if (d.lhs == symbol && d.left_extent == descriptor.right_extent && d.is_completed())
+                    if (d.slot->lhs_id == descriptor.slot->next_symbol_id && d.left_extent == descriptor.right_extent && d.is_completed())
                     {
                         right_extents.insert(d.right_extent);
                     }
@@ -274,10 +288,10 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
 #else
 #ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
             {
-                std::shared_lock<std::shared_mutex> lock(ascended_set_mutex);
+                std::shared_lock<ProfiledSharedMutex> lock(ascended_set_mutex);
                 for (auto d : ascended_descriptors)
                 {
-                    if (d.lhs == symbol && d.left_extent == descriptor.right_extent)
+                    if (d.slot->lhs_id == descriptor.slot->next_symbol_id && d.left_extent == descriptor.right_extent)
                     {
                         right_extents.insert(d.right_extent);
                     }
@@ -285,13 +299,13 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
             }
 
 #else
-            for (auto d : descriptor_set)
+            for (auto d : node.descriptor_set)
             {
-                if (d.lhs == symbol && d.left_extent == descriptor.right_extent && d.is_completed())
+                if (d.slot->lhs_id == descriptor.slot->next_symbol_id && d.left_extent == descriptor.right_extent && d.is_completed())
                 {
                     right_extents.insert(d.right_extent);
 #ifdef CORRECTNESS_FIX
-                    skipped_rules.push_back(std::make_pair(symbol, d.rhs));
+                    skipped_slots.push_back(grammar.get_slot(d.lhs(), d.rhs(), 0));
 #endif
                 }
             }
@@ -300,30 +314,30 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
 
 #ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
             {
-                std::unique_lock<std::shared_mutex> lock(descended_set_mutex);
+                std::unique_lock<ProfiledSharedMutex> lock(descended_set_mutex);
                 descended_descriptors.push_back(descriptor);
             }
 #endif
             if (right_extents.size() == 0)
             {
-                descend(symbol, descriptor.right_extent);
+                descend(node, symbol, descriptor.right_extent);
             }
             else
             {
 #ifdef CORRECTNESS_FIX
-                std::vector<production_rule_t> rules = grammar.get_production_rules(symbol);
-                std::vector<production_rule_t> remaining_rules;
+                std::vector<const GrammarSlot*> slots = grammar.get_initial_slots(symbol);
+                std::vector<const GrammarSlot*> remaining_slots;
 
-                std::set_difference(rules.begin(), rules.end(), skipped_rules.begin(), skipped_rules.end(), std::inserter(remaining_rules, remaining_rules.begin()));
+                std::set_difference(slots.begin(), slots.end(), skipped_slots.begin(), skipped_slots.end(), std::inserter(remaining_slots, remaining_slots.begin()));
 
-                for(auto rule : remaining_rules)
+                for(auto slot : remaining_slots)
                 {
-                    Descriptor d(rule.first, rule.second, 0, descriptor.right_extent, descriptor.right_extent, true);
-                    worklist.insert(d);
-                    descriptor_set.erase(d);
+                    Descriptor d(slot, descriptor.right_extent, descriptor.right_extent, true);
+                    node.worklist.insert(d);
+                    node.descriptor_set.erase(d);
                 }
 #endif
-                skip(descriptor.copy_and_advance(), right_extents);
+                skip(node, descriptor.copy_and_advance(), right_extents);
             }
         }
     }
@@ -333,11 +347,11 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
 
 #ifdef OPTIMISATION_TREE_GLOBAL_DESCRIPTORS
         {
-            std::shared_lock<std::shared_mutex> lock(descriptor_set_mutex);
+            std::shared_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
 
             for (auto d : descriptor_set_global)
             {
-                if (!d.is_completed() && d.get_next_symbol() == descriptor.lhs && d.right_extent == descriptor.left_extent)
+                if (!d.is_completed() && d.slot->next_symbol_id == descriptor.slot->lhs_id && d.right_extent == descriptor.left_extent)
                 {
                     descriptors.insert(d.copy_and_advance());
                 }
@@ -346,11 +360,11 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
 #else
 #ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
         {
-            std::shared_lock<std::shared_mutex> lock(descended_set_mutex);
+            std::shared_lock<ProfiledSharedMutex> lock(descended_set_mutex);
 
             for (auto d : descended_descriptors)
             {
-                if (d.get_next_symbol() == descriptor.lhs && d.right_extent == descriptor.left_extent)
+                if (d.slot->next_symbol_id == descriptor.slot->lhs_id && d.right_extent == descriptor.left_extent)
                 {
                     descriptors.insert(d.copy_and_advance());
                 }
@@ -358,26 +372,27 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
         }
 
         {
-            std::unique_lock<std::shared_mutex> lock(ascended_set_mutex);
+            std::unique_lock<ProfiledSharedMutex> lock(ascended_set_mutex);
             ascended_descriptors.push_back(descriptor);
         }
 #else
-        for (auto d : descriptor_set)
+        for (auto d : node.descriptor_set)
         {
-            if (!d.is_completed() && d.get_next_symbol() == descriptor.lhs && d.right_extent == descriptor.left_extent)
+            if (!d.is_completed() && d.slot->next_symbol_id == descriptor.slot->lhs_id && d.right_extent == descriptor.left_extent)
             {
                 descriptors.insert(d.copy_and_advance());
             }
         }
 #endif
 #endif
-        ascend(descriptors, descriptor.right_extent);
+        ascend(node, descriptors, descriptor.right_extent);
 
         if (descriptor.is_empty())
         {
             {
-                std::lock_guard<std::mutex> lock(epn_set_mutex);
+                std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
                 epn_set.insert(EPN(descriptor));
+                enforce_memory_budget(epn_set);
             }
         }
     }
@@ -387,22 +402,26 @@ void ThreadTreeParser::process_descriptor(Descriptor descriptor)
  * @brief Implements the 'match' operation: add a new descriptor and EPN if the
  * current descriptor matches the correct terminal in the input string.
  *
+ * @param node Node of the thread that processes the descriptor.
  * @param descriptor Descriptor that is being processed.
  */
-void ThreadTreeParser::match(Descriptor descriptor)
+void ThreadTreeParser::match(TreeNode& node, Descriptor descriptor)
 {
-    std::string terminal = descriptor.get_next_symbol();
+    Statistics::current().num_match++;
+
+    const std::string& terminal = descriptor.get_next_symbol();
 
-    if (input.size() > 0 && terminal == input[descriptor.right_extent])
+    if (descriptor.right_extent < input.size() && terminal == input[descriptor.right_extent])
     {
         Descriptor d = descriptor.copy_and_advance();
         d.right_extent++;
 
-        add_to_worklist(d);
+        add_to_worklist(node, d);
 
         {
-            std::lock_guard<std::mutex> lock(epn_set_mutex);
+            std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
             epn_set.insert(EPN(d, descriptor.right_extent));
+            enforce_memory_budget(epn_set);
         }
     }
 }
@@ -411,16 +430,21 @@ void ThreadTreeParser::match(Descriptor descriptor)
  * @brief Implements the 'match' operation: add a new descriptor for every valid
  * alternative of the given nonterminal symbol.
  *
+ * @param node Node of the thread that processes the descriptor.
  * @param symbol Nonterminal symbol to find alternatives of.
  * @param pivot Pivot of the currently processed descriptor.
  */
 void ThreadTreeParser::descend(
-    std::string symbol,
+    TreeNode& node,
+    const std::string& symbol,
     unsigned int pivot
 )
 {
+    Statistics::current().num_descend++;
+
     extend_worklist(
-        grammar.get_production_rules(symbol),
+        node,
+        grammar.get_initial_slots(symbol),
         pivot,
         pivot
     );
@@ -430,100 +454,124 @@ void ThreadTreeParser::descend(
  * @brief Implements the 'skip' operation: skip over the nonterminal symbol
  * and find the valid descriptors.
  *
+ * @param node Node of the thread that processes the descriptor.
  * @param descriptor Descriptor currently being processed, with nonterminal skip.
  * @param right_extents Set of valid right extents for new descriptors.
  */
 void ThreadTreeParser::skip(
+    TreeNode& node,
     Descriptor descriptor,
-    std::unordered_set<unsigned int> right_extents
+    const pooled_set_t<unsigned int>& right_extents
 )
 {
-    for (int right_extent : right_extents)
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_skip++;
+
+    for (unsigned int right_extent : right_extents)
     {
         Descriptor new_descriptor(descriptor);
         new_descriptor.right_extent = right_extent;
 
-        add_to_worklist(new_descriptor);
+        add_to_worklist(node, new_descriptor);
 
-        {
-            std::lock_guard<std::mutex> lock(epn_set_mutex);
-            epn_set.insert(EPN(new_descriptor, descriptor.right_extent));
-        }
+        epns.push_back(EPN(new_descriptor, descriptor.right_extent));
+    }
+
+    {
+        std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
+        epn_set.insert(epns.begin(), epns.end());
+        enforce_memory_budget(epn_set);
     }
 }
 
 /**
  * @brief Implements the 'ascend' operation: a production rules has been parsed
- * and the next valid descriptors are added to the worklist.
+ * and the next valid descriptors are added to the node.worklist.
  *
+ * @param node Node of the thread that processes the descriptor.
  * @param descriptor_set Set of valid descriptors to be added, with incorrect
  *                       right extent.
  * @param right_extent Right extent for the new descriptors.
  */
 void ThreadTreeParser::ascend(
-    descriptor_set_t descriptors,
+    TreeNode& node,
+    const descriptor_set_t& descriptors,
     unsigned int right_extent
 )
 {
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_ascend++;
+
     for (auto descriptor : descriptors)
     {
         Descriptor new_descriptor(descriptor);
         new_descriptor.right_extent = right_extent;
 
-        add_to_worklist(new_descriptor);
+        add_to_worklist(node, new_descriptor);
 
+        epns.push_back(EPN(new_descriptor, descriptor.right_extent));
+    }
 
-        {
-            std::lock_guard<std::mutex> lock(epn_set_mutex);
-            epn_set.insert(EPN(new_descriptor, descriptor.right_extent));
-        }
+    {
+        std::lock_guard<ProfiledMutex> lock(epn_set_mutex);
+        epn_set.insert(epns.begin(), epns.end());
+        enforce_memory_budget(epn_set);
     }
 }
 
-void ThreadTreeParser::add_to_worklist(Descriptor descriptor)
+void ThreadTreeParser::add_to_worklist(TreeNode& node, Descriptor descriptor)
 {
     size_t count;
 #ifdef OPTIMISATION_TREE_GLOBAL_DESCRIPTORS
     {
-        std::shared_lock<std::shared_mutex> lock(descriptor_set_mutex);
+        std::shared_lock<ProfiledSharedMutex> lock(descriptor_set_mutex);
         count = descriptor_set_global.count(descriptor);
     }
 #else
-    count = descriptor_set.count(descriptor);
+    count = node.descriptor_set.count(descriptor);
 #endif
     if (!count)
     {
-        worklist.insert(descriptor.copy_and_force());
+        count = !node.worklist.insert(descriptor.copy_and_force());
     }
     /* The descriptor might not be in the local descriptor set, so it is added. */
 #if defined(OPTIMISATION_TREE_GLOBAL_DESCRIPTORS) || defined(OPTIMISATION_TREE_BETTER_LOCAL_SET)
     else
     {
-        descriptor_set.insert(descriptor);
+        node.descriptor_set.insert(descriptor);
     }
 #endif
+
+    if (count)
+    {
+        Statistics::current().num_duplicates++;
+    }
 }
 
 /**
- * @brief Extends the worklist with the provided rules, using the provided left
+ * @brief Extends the node.worklist with the provided slots, using the provided left
  * and right extents. Does not add a new descriptor if it is already in the
  * descriptors set.
  *
- * @param rules Rules to extend the worklist with.
+ * @param node Node of the thread that processes the descriptor.
+ * @param slots Initial slots of the rules to extend the worklist with.
  * @param left_extent Left extent of the new descriptors.
  * @param right_extent Right extent of the new descriptors.
  */
 void ThreadTreeParser::extend_worklist(
-    std::vector<production_rule_t> rules,
-    int left_extent,
-    int right_extent
+    TreeNode& node,
+    const std::vector<const GrammarSlot*>& slots,
+    unsigned int left_extent,
+    unsigned int right_extent
 )
 {
-    for(auto rule : rules)
+    for(auto slot : slots)
     {
-        Descriptor descriptor = Descriptor(rule.first, rule.second, 0, left_extent, right_extent);
+        Descriptor descriptor = Descriptor(slot, left_extent, right_extent);
 
-        add_to_worklist(descriptor);
+        add_to_worklist(node, descriptor);
     }
 }
 
@@ -531,19 +579,20 @@ void ThreadTreeParser::extend_worklist(
  * @brief Add a new thread to the tree. Each thread gets its own promise that it
  * needs to fulfill.
  *
+ * @param node Node of the thread that adds the child thread.
  * @param descriptor Descriptor to pass to the new thread.
  */
-void ThreadTreeParser::add_thread(Descriptor descriptor)
+void ThreadTreeParser::add_thread(TreeNode& node, Descriptor descriptor)
 {
 #ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
     working_threads.fetch_add(1);
 #endif
 #ifdef OPTIMISATION_TREE_FUTURE
-    promises.push_back(std::promise<descriptor_set_t>());
-    futures.push_back(promises[promises.size() - 1].get_future());
-    threads.push_back(std::thread(&ThreadTreeParser::thread_function, this, std::move(promises[promises.size() - 1]), descriptor, descriptor_set));
+    node.promises.push_back(std::promise<descriptor_set_t>());
+    node.futures.push_back(node.promises[node.promises.size() - 1].get_future());
+    node.threads.push_back(std::thread(&ThreadTreeParser::thread_function, this, std::move(node.promises[node.promises.size() - 1]), descriptor, node.descriptor_set));
 #else
-    threads.push_back(std::thread(&ThreadTreeParser::thread_function, this, descriptor, descriptor_set));
+    node.threads.push_back(std::thread(&ThreadTreeParser::thread_function, this, descriptor, node.descriptor_set));
 #endif
     num_threads.fetch_add(1);
 }
\ No newline at end of file
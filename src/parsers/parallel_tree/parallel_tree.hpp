@@ -12,7 +12,29 @@
 #ifdef OPTIMISATION_TREE_FUTURE
 #include <future>
 #endif
+#include <thread>
+#include <vector>
 #include "../../components/parser.hpp"
+#include "../../utilities/pool_allocator.hpp"
+#include "../../utilities/profiled_mutex.hpp"
+
+/**
+ * State of one thread of the Thread Tree parser: a node of the tree, with its
+ * own worklist, the descriptors it knows of and its child threads.
+ */
+struct TreeNode
+{
+    Worklist worklist;
+    descriptor_set_t descriptor_set;
+    std::vector<std::thread> threads;
+#ifdef OPTIMISATION_TREE_FUTURE
+    std::vector<std::promise<descriptor_set_t>> promises;
+    std::vector<std::future<descriptor_set_t>> futures;
+#endif
+#ifdef OPTIMISATION_TREE_BETTER_LOCAL_SET
+    size_t global_set_index = 0;
+#endif
+};
 
 /**
  * Represents the Thread Tree parser. Derived from the Parser class.
@@ -24,35 +46,55 @@ public:
 #ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
     std::atomic<int> working_threads;
 #endif
-    std::atomic<int> num_descriptors;
     std::atomic<int> num_threads;
+private:
+    /* Node of the thread that calls loop(). */
+    TreeNode root;
+    /* State of a parse, shared by the threads of this parser only. */
+    ProfiledMutex epn_set_mutex{statistics.locks, "tree.epn_set_mutex"};
+#ifndef OPTIMISATION_TREE_FUTURE
+    ProfiledSharedMutex descriptor_set_mutex{statistics.locks, "tree.descriptor_set_mutex"};
+    descriptor_set_t descriptor_set_global;
+#endif
+#ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
+    ProfiledSharedMutex descended_set_mutex{statistics.locks, "tree.descended_set_mutex"};
+    std::vector<Descriptor> descended_descriptors;
+    ProfiledSharedMutex ascended_set_mutex{statistics.locks, "tree.ascended_set_mutex"};
+    std::vector<Descriptor> ascended_descriptors;
+#endif
+#ifdef OPTIMISATION_TREE_BETTER_LOCAL_SET
+    ProfiledSharedMutex global_set_mutex{statistics.locks, "tree.global_set_mutex"};
+    std::vector<Descriptor> global_descriptors;
+#endif
 public:
     ThreadTreeParser(Grammar g) : Parser(g) {
-        num_descriptors = 0;
+        num_threads = 0;
 #ifdef OPTIMISATION_TREE_GRANULAR_GLOBAL
         working_threads = 0;
 #endif
     };
 public:
-    std::tuple<descriptor_set_t, epn_set_t> parse(std::vector<std::string> input_sequence);
+    ParseResult parse(std::vector<std::string> input_sequence);
 private:
-    std::tuple<descriptor_set_t, epn_set_t> loop() override;
-    void print_data() override;
-    void process_descriptor(Descriptor descriptor);
-    void match(Descriptor descriptor);
-    void descend(std::string symbol, unsigned int pivot);
-    void skip(Descriptor descriptor, std::unordered_set<unsigned int> right_extents);
-    void ascend(descriptor_set_t descriptors, unsigned int right_extent);
+    void loop() override;
+    ParseResult get_result() override;
+    void print_data(const ParseResult& result) override;
+    void process_descriptor(TreeNode& node, Descriptor descriptor);
+    void match(TreeNode& node, Descriptor descriptor);
+    void descend(TreeNode& node, const std::string& symbol, unsigned int pivot);
+    void skip(TreeNode& node, Descriptor descriptor, const pooled_set_t<unsigned int>& right_extents);
+    void ascend(TreeNode& node, const descriptor_set_t& descriptors, unsigned int right_extent);
     void extend_worklist(
-        std::vector<production_rule_t> rules,
-        int left_extent = 0,
-        int right_extent = 0
+        TreeNode& node,
+        const std::vector<const GrammarSlot*>& slots,
+        unsigned int left_extent = 0,
+        unsigned int right_extent = 0
     );
-    void add_to_worklist(Descriptor descriptor);
+    void add_to_worklist(TreeNode& node, Descriptor descriptor);
 #ifdef OPTIMISATION_TREE_FUTURE
     void thread_function(std::promise<descriptor_set_t>&& promise, Descriptor descriptor, descriptor_set_t descriptors);
 #else
     void thread_function(Descriptor descriptor, descriptor_set_t descriptors);
 #endif
-    void add_thread(Descriptor descriptor);
+    void add_thread(TreeNode& node, Descriptor descriptor);
 };
\ No newline at end of file
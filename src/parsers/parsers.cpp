@@ -0,0 +1,181 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Creates parsers by the name of their engine. The available engines are
+ *   'sequential', 'dense' (sequential with a dense descriptor store), 'pool'
+ *   (Thread Pool), 'tree' (Thread Tree), 'chunked' (Chunked), 'sharded'
+ *   (Sharded), 'process' (Sharded with worker processes) and 'chart'
+ *   (bit-parallel chart). The 'auto' engine chooses between 'dense' and
+ *   'chart' by the ambiguity of the grammar on a prefix of the input.
+ */
+
+#include <unordered_map>
+#include "parsers.hpp"
+#include "sequential/sequential_parser.hpp"
+#include "dense/dense_parser.hpp"
+#include "parallel_pool/parallel_pool.hpp"
+#include "parallel_tree/parallel_tree.hpp"
+#include "chunked/chunked_parser.hpp"
+#include "sharded/sharded_parser.hpp"
+#include "process/process_parser.hpp"
+#include "chart/chart_parser.hpp"
+
+/**
+ * @param engine Name of the engine.
+ *
+ * @return True if a parser engine with the given name exists, false otherwise.
+ */
+bool is_parser_engine(std::string engine)
+{
+    return engine == "sequential" || engine == "dense" || engine == "pool" || engine == "tree"
+        || engine == "chunked" || engine == "sharded" || engine == "process"
+        || engine == "chart" || engine == "auto";
+}
+
+/**
+ * @brief All parsers keep their state inside the parser object, so parsers of
+ * any engine can run concurrently in one process. The parallel engines also
+ * spawn threads for every parse.
+ *
+ * @param engine Name of the engine.
+ *
+ * @return True if parsers of the engine use more than one thread, or may do
+ * so in the case of 'auto'.
+ */
+bool is_parallel_engine(std::string engine)
+{
+    return engine != "sequential" && engine != "dense";
+}
+
+/**
+ * @brief Parses a prefix of the input with the Dense parser and measures how
+ * many right extents the descriptors have per slot and left extent. Highly
+ * ambiguous grammars have many, which the chart finds all at once.
+ *
+ * @param grammar Input grammar.
+ * @param input Input sequence.
+ *
+ * @return Average number of right extents per slot and left extent, or 0 if
+ * there are no descriptors.
+ */
+double measure_ambiguity(Grammar grammar, const std::vector<std::string>& input)
+{
+    DenseParser parser(grammar);
+    std::vector<std::string> prefix(input.begin(), input.begin() + static_cast<long>(std::min<size_t>(input.size(), AUTO_PROBE_LENGTH)));
+    std::unordered_map<uint64_t, size_t> right_extents;
+
+    parser.print_experiment_data = false;
+
+    auto result = parser.parse(prefix);
+
+    for (auto& descriptor : result.descriptors)
+    {
+        right_extents[(static_cast<uint64_t>(descriptor.slot->id) << 32) | descriptor.left_extent]++;
+    }
+
+    if (right_extents.empty())
+    {
+        return 0;
+    }
+
+    return static_cast<double>(result.descriptors.size()) / static_cast<double>(right_extents.size());
+}
+
+/**
+ * @brief Resolves the 'auto' engine to the engine to parse an input with: the
+ * Chart parser if the grammar is at least AUTO_AMBIGUITY_THRESHOLD ambiguous
+ * on the input and its chart fits in the memory limit and
+ * AUTO_MAX_CHART_SIZE, the Dense parser otherwise. Other engines are kept.
+ *
+ * @param engine Name of the engine.
+ * @param grammar Input grammar.
+ * @param input Input sequence. Without input the Dense parser is chosen.
+ * @param memory_limit Memory limit of the parse in bytes, or 0 for none.
+ *
+ * @return Name of the engine to use.
+ */
+std::string resolve_engine(std::string engine, Grammar grammar, const std::vector<std::string>& input, size_t memory_limit)
+{
+    if (engine != "auto")
+    {
+        return engine;
+    }
+
+    grammar.compile();
+
+    size_t chart_size = ChartParser::chart_size(grammar, input.size());
+
+    if (chart_size > AUTO_MAX_CHART_SIZE || (memory_limit > 0 && chart_size > memory_limit))
+    {
+        return "dense";
+    }
+
+    if (!input.empty() && measure_ambiguity(grammar, input) >= AUTO_AMBIGUITY_THRESHOLD)
+    {
+        return "chart";
+    }
+
+    return "dense";
+}
+
+/**
+ * @brief Creates a parser.
+ *
+ * @param engine Name of the engine.
+ * @param grammar Input grammar.
+ * @param num_threads Number of threads, used by the Thread Pool, Chunked,
+ * Sharded, Process and Chart parsers.
+ *
+ * @return The parser, or nullptr if the engine does not exist. The 'auto'
+ * engine creates a Dense parser, use resolve_engine() to choose by the input.
+ */
+std::unique_ptr<Parser> make_parser(std::string engine, Grammar grammar, unsigned int num_threads)
+{
+    if (engine == "auto")
+    {
+        engine = resolve_engine(engine, grammar, {});
+    }
+
+    if (engine == "sequential")
+    {
+        return std::make_unique<SequentialParser>(grammar);
+    }
+
+    if (engine == "dense")
+    {
+        return std::make_unique<DenseParser>(grammar);
+    }
+
+    if (engine == "pool")
+    {
+        return std::make_unique<ThreadPoolParser>(grammar, num_threads);
+    }
+
+    if (engine == "tree")
+    {
+        return std::make_unique<ThreadTreeParser>(grammar);
+    }
+
+    if (engine == "chunked")
+    {
+        return std::make_unique<ChunkedParser>(grammar, num_threads);
+    }
+
+    if (engine == "sharded")
+    {
+        return std::make_unique<ShardedParser>(grammar, num_threads);
+    }
+
+    if (engine == "process")
+    {
+        return std::make_unique<ProcessParser>(grammar, num_threads);
+    }
+
+    if (engine == "chart")
+    {
+        return std::make_unique<ChartParser>(grammar, num_threads);
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,27 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface for creating parsers by the name of their engine.
+ */
+
+#pragma once
+
+#include <memory>
+#include "../components/parser.hpp"
+
+/* Number of tokens of the input that the 'auto' engine parses to measure the
+   ambiguity of the grammar. */
+#define AUTO_PROBE_LENGTH 32
+/* Average number of right extents per slot and left extent from which the
+   'auto' engine chooses the Chart parser. */
+#define AUTO_AMBIGUITY_THRESHOLD 3.0
+/* Bytes of the chart above which the 'auto' engine never chooses the Chart
+   parser, whatever the memory limit. */
+#define AUTO_MAX_CHART_SIZE (512UL << 20)
+
+bool is_parser_engine(std::string engine);
+bool is_parallel_engine(std::string engine);
+double measure_ambiguity(Grammar grammar, const std::vector<std::string>& input);
+std::string resolve_engine(std::string engine, Grammar grammar, const std::vector<std::string>& input, size_t memory_limit = 0);
+std::unique_ptr<Parser> make_parser(std::string engine, Grammar grammar, unsigned int num_threads);
@@ -0,0 +1,505 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the Process parser. Every shard of the Sharded parser
+ *   runs in a worker process of its own, so that the workers do not share an
+ *   allocator or a heap. The parent forks the workers after it compiled the
+ *   grammar and read the input, which the workers then share with it until
+ *   they would write to them, which they never do. Descriptors for other
+ *   shards go through a ring buffer in shared memory, one for every pair of
+ *   workers, as slot ids and extents. A full ring does not block the sender:
+ *   it keeps the descriptors and stays busy until they fit. The counter that
+ *   decides when the parse is done, and the limits of the parse, are shared
+ *   as well. The parent only watches the time limit and the cancellation
+ *   token, and waits for the workers. Every worker writes its descriptors and
+ *   EPNs to a temporary file when it is done, and the parent merges those
+ *   into the result. A worker that cannot be forked runs as a thread of the
+ *   parent instead. A worker that dies stops the parse with the reason
+ *   'failed'.
+ */
+
+#include "process_parser.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static_assert(std::atomic<long>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free
+    && std::atomic<bool>::is_always_lock_free, "Atomics in shared memory must be lock-free");
+
+/**
+ * @brief Unmaps the shared memory of the last parse, if it is still mapped.
+ */
+ProcessParser::~ProcessParser()
+{
+    unmap_shared_memory();
+}
+
+/**
+ * @brief Maps memory that the workers share, and constructs the control block,
+ * the counters and the rings in it.
+ *
+ * @param num_workers Number of workers.
+ *
+ * @return True if the memory was mapped, false otherwise.
+ */
+bool ProcessParser::map_shared_memory(size_t num_workers)
+{
+    size_t statistics_offset = sizeof(WorkerControl);
+    size_t rings_offset = statistics_offset + num_workers * sizeof(ThreadStatistics);
+
+    shared_size = rings_offset + num_workers * num_workers * sizeof(DescriptorRing);
+    shared_memory = mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (shared_memory == MAP_FAILED)
+    {
+        std::cerr << "Error: unable to map " << shared_size << " bytes of shared memory" << std::endl;
+        shared_memory = nullptr;
+        return false;
+    }
+
+    char* memory = static_cast<char*>(shared_memory);
+
+    control = new (memory) WorkerControl();
+    worker_statistics = reinterpret_cast<ThreadStatistics*>(memory + statistics_offset);
+    rings = reinterpret_cast<DescriptorRing*>(memory + rings_offset);
+
+    for (size_t index = 0; index < num_workers; index++)
+    {
+        new (&worker_statistics[index]) ThreadStatistics();
+    }
+
+    for (size_t index = 0; index < num_workers * num_workers; index++)
+    {
+        new (&rings[index]) DescriptorRing();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Unmaps the shared memory. Its contents are trivially destructible.
+ */
+void ProcessParser::unmap_shared_memory()
+{
+    if (shared_memory)
+    {
+        munmap(shared_memory, shared_size);
+    }
+
+    shared_memory = nullptr;
+    control = nullptr;
+    worker_statistics = nullptr;
+    rings = nullptr;
+}
+
+/**
+ * @brief Sends as many descriptors collected by a worker for another worker
+ * as fit in the ring between them. They count as work before the receiver
+ * can see them.
+ *
+ * @param from Index of the sending worker.
+ * @param to Index of the receiving worker.
+ */
+void ProcessParser::send(size_t from, size_t to)
+{
+    auto& outbox = shards[from].outboxes[to];
+    DescriptorRing& ring = rings[from * shards.size() + to];
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t space = PROCESS_RING_SIZE - (tail - ring.head.load(std::memory_order_acquire));
+    size_t count = static_cast<size_t>(std::min<uint64_t>(space, outbox.size()));
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    num_active->fetch_add(static_cast<long>(count));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Descriptor& descriptor = outbox[i];
+
+        ring.records[(tail + i) % PROCESS_RING_SIZE] = { descriptor.slot->id, descriptor.left_extent, descriptor.right_extent };
+    }
+
+    ring.tail.store(tail + count, std::memory_order_release);
+    outbox.erase(outbox.begin(), outbox.begin() + static_cast<long>(count));
+}
+
+/**
+ * @brief Receives the descriptors in the rings to a worker and adds them to
+ * the worklist of its shard. A worker that was idle becomes busy again before
+ * the received descriptors stop counting as work.
+ *
+ * @param index Index of the worker.
+ *
+ * @return True if any descriptor was received, false otherwise.
+ */
+bool ProcessParser::receive(size_t index)
+{
+    Shard& shard = shards[index];
+    bool received = false;
+
+    for (size_t from = 0; from < shards.size(); from++)
+    {
+        DescriptorRing& ring = rings[from * shards.size() + index];
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        uint64_t tail = ring.tail.load(std::memory_order_acquire);
+
+        if (from == index || head == tail)
+        {
+            continue;
+        }
+
+        if (!shard.active)
+        {
+            shard.active = true;
+            num_active->fetch_add(1);
+        }
+
+        for (uint64_t position = head; position != tail; position++)
+        {
+            const DescriptorRing::record_t& record = ring.records[position % PROCESS_RING_SIZE];
+
+            accept(shard, Descriptor(&grammar.compiled->slots[record[0]], record[1], record[2]));
+        }
+
+        ring.head.store(tail, std::memory_order_release);
+        num_active->fetch_sub(static_cast<long>(tail - head));
+        received = true;
+    }
+
+    return received;
+}
+
+/**
+ * @brief Counts a descriptor in the shared counter of all workers, and checks
+ * it against the descriptor limit, and the EPN sets of all workers against the
+ * memory limit. The parent checks the other limits.
+ *
+ * @param index Index of the worker.
+ *
+ * @return True if the worker must stop, false otherwise.
+ */
+bool ProcessParser::limit_reached(size_t index)
+{
+    if (control->stopped.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+
+    if (count_epn_memory(shards[index].epn_set, shards[index].epn_bytes, control->epn_bytes))
+    {
+        return stop_workers("memory");
+    }
+
+    unsigned long count = control->num_checks.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (descriptor_limit > 0 && count > descriptor_limit)
+    {
+        return stop_workers("descriptors");
+    }
+
+    return false;
+}
+
+/**
+ * @return True if any worker or the parent stopped the workers.
+ */
+bool ProcessParser::parse_stopped() const
+{
+    return control->stopped.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Stops all workers. Only the first reason is kept.
+ *
+ * @param reason Reason, as for Parser::stop().
+ *
+ * @return True.
+ */
+bool ProcessParser::stop_workers(const char* reason)
+{
+    if (!control->stopped.exchange(true))
+    {
+        std::strncpy(control->stop_reason, reason, sizeof(control->stop_reason) - 1);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Creates the temporary file that a worker writes its result to.
+ *
+ * @return Name of the file, or an empty string if it could not be created.
+ */
+std::string ProcessParser::create_result_file() const
+{
+    std::string name = spill_directory + "/cds-worker-XXXXXX";
+    int descriptor = mkstemp(&name[0]);
+
+    if (descriptor < 0)
+    {
+        std::cerr << "Error: unable to create a temporary file in '" << spill_directory << "'" << std::endl;
+        return "";
+    }
+
+    close(descriptor);
+
+    return name;
+}
+
+/**
+ * @brief Writes the descriptors and EPNs of the shard of a worker to a file:
+ * the number of descriptors, their records, the number of EPNs and their
+ * records.
+ *
+ * @param index Index of the worker.
+ * @param name Name of the file.
+ *
+ * @return True if the file was written, false otherwise.
+ */
+bool ProcessParser::write_result(size_t index, const std::string& name) const
+{
+    const Shard& shard = shards[index];
+    std::ofstream file(name, std::ios::binary | std::ios::trunc);
+    std::vector<DescriptorRing::record_t> descriptors;
+    std::vector<EPNSpill::record_t> epns;
+
+    descriptors.reserve(shard.descriptor_set.size());
+    epns.reserve(shard.epn_set.size());
+
+    for (auto& d : shard.descriptor_set)
+    {
+        descriptors.push_back({ d.slot->id, d.left_extent, d.right_extent });
+    }
+
+    for (auto& e : shard.epn_set)
+    {
+        epns.push_back({ e.slot->id, e.left_extent, e.pivot, e.right_extent });
+    }
+
+    uint64_t num_descriptors = descriptors.size();
+    uint64_t num_epns = epns.size();
+
+    file.write(reinterpret_cast<const char*>(&num_descriptors), sizeof(num_descriptors));
+    file.write(reinterpret_cast<const char*>(descriptors.data()), static_cast<std::streamsize>(descriptors.size() * sizeof(DescriptorRing::record_t)));
+    file.write(reinterpret_cast<const char*>(&num_epns), sizeof(num_epns));
+    file.write(reinterpret_cast<const char*>(epns.data()), static_cast<std::streamsize>(epns.size() * sizeof(EPNSpill::record_t)));
+    file.close();
+
+    return static_cast<bool>(file);
+}
+
+/**
+ * @brief Adds the descriptors and EPNs that a worker wrote to a file to the
+ * result.
+ *
+ * @param name Name of the file.
+ *
+ * @return True if the file could be read, false otherwise.
+ */
+bool ProcessParser::read_result(const std::string& name)
+{
+    std::ifstream file(name, std::ios::binary);
+    std::vector<DescriptorRing::record_t> descriptors;
+    std::vector<EPNSpill::record_t> epns;
+    uint64_t count = 0;
+
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    descriptors.resize(file ? count : 0);
+    file.read(reinterpret_cast<char*>(descriptors.data()), static_cast<std::streamsize>(descriptors.size() * sizeof(DescriptorRing::record_t)));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    epns.resize(file ? count : 0);
+    file.read(reinterpret_cast<char*>(epns.data()), static_cast<std::streamsize>(epns.size() * sizeof(EPNSpill::record_t)));
+
+    if (!file)
+    {
+        return false;
+    }
+
+    for (auto& record : descriptors)
+    {
+        descriptor_set.insert(Descriptor(&grammar.compiled->slots[record[0]], record[1], record[2]));
+    }
+
+    for (auto& record : epns)
+    {
+        epn_set.insert(EPN(&grammar.compiled->slots[record[0]], record[1], record[2], record[3]));
+    }
+
+    enforce_memory_budget(epn_set);
+
+    return true;
+}
+
+/**
+ * @brief Runs the shard of a worker in a forked process, and leaves its
+ * counters in shared memory and its result in a file. Exits the process with
+ * status 0 if the result was written, 1 otherwise.
+ *
+ * @param index Index of the worker.
+ * @param name Name of the file for its result.
+ */
+void ProcessParser::run_worker(size_t index, const std::string& name)
+{
+    ThreadStatistics& counters = statistics.add_thread();
+
+    run(index);
+    counters.stop_cpu_clock();
+    worker_statistics[index] = counters;
+
+    /* Exit without the destructors and exit handlers of the parent process. */
+    _exit(write_result(index, name) ? 0 : 1);
+}
+
+/**
+ * @brief Creates the shards, forks a worker per shard and waits for them,
+ * meanwhile checking the time limit and the cancellation token. Afterwards,
+ * the results of the workers are merged into the result.
+ */
+void ProcessParser::loop()
+{
+    size_t num_workers = num_threads;
+
+    descriptor_set.clear();
+    epn_set.clear();
+    unmap_shared_memory();
+
+    if (!map_shared_memory(num_workers))
+    {
+        stop("failed");
+        return;
+    }
+
+    num_active = &control->num_active;
+    start_shards();
+
+    std::vector<std::string> result_files(num_workers);
+    std::vector<pid_t> workers(num_workers, -1);
+    std::vector<std::thread> threads;
+    std::atomic<size_t> num_running{0};
+
+    for (size_t index = 0; index < num_workers; index++)
+    {
+        result_files[index] = create_result_file();
+
+        if (!result_files[index].empty())
+        {
+            workers[index] = fork();
+        }
+
+        if (workers[index] == 0)
+        {
+            run_worker(index, result_files[index]);
+        }
+
+        if (workers[index] > 0)
+        {
+            num_running++;
+        }
+    }
+
+    /* Only started once all workers are forked, since a forked process would
+       only have the thread that forked it. */
+    for (size_t index = 0; index < num_workers; index++)
+    {
+        if (workers[index] < 0)
+        {
+            std::cerr << "Error: unable to start worker " << index << " as a process, running it as a thread" << std::endl;
+            num_running++;
+
+            threads.push_back(std::thread([this, index, &num_running]() {
+                ThreadStatistics& counters = statistics.add_thread();
+
+                run(index);
+                counters.stop_cpu_clock();
+                num_running--;
+            }));
+        }
+    }
+
+    std::vector<bool> done(num_workers, false);
+
+    while (num_running > 0)
+    {
+        for (size_t index = 0; index < num_workers; index++)
+        {
+            int status = 0;
+
+            if (workers[index] <= 0 || done[index] || waitpid(workers[index], &status, WNOHANG) == 0)
+            {
+                continue;
+            }
+
+            done[index] = true;
+            num_running--;
+
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                std::cerr << "Error: worker " << index << " failed, the result is incomplete" << std::endl;
+                workers[index] = -1;
+                stop_workers("failed");
+            }
+        }
+
+        if (cancellation && cancellation->is_cancelled())
+        {
+            stop_workers("cancelled");
+        }
+
+        if (time_limit > 0 && timer.elapsedMilliseconds() > time_limit)
+        {
+            stop_workers("time");
+        }
+
+        if (num_running > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(PROCESS_POLL_INTERVAL));
+        }
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (size_t index = 0; index < num_workers; index++)
+    {
+        if (workers[index] > 0)
+        {
+            statistics.threads.push_back(worker_statistics[index]);
+
+            if (!read_result(result_files[index]))
+            {
+                std::cerr << "Error: unable to read the result of worker " << index << std::endl;
+                stop_workers("failed");
+            }
+        }
+
+        if (!result_files[index].empty())
+        {
+            std::remove(result_files[index].c_str());
+        }
+    }
+
+    /* The shards of the parent hold the results of the workers that ran as
+       threads, and the start descriptors. */
+    merge_shards();
+
+    if (control->stopped.load())
+    {
+        stop(control->stop_reason);
+    }
+
+    unmap_shared_memory();
+    num_active = nullptr;
+}
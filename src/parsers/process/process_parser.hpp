@@ -0,0 +1,89 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with the Process parser, which runs the shards of the Sharded
+ *   parser in worker processes that exchange descriptors through shared
+ *   memory.
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include "../sharded/sharded_parser.hpp"
+
+/* Number of descriptors that fit in the ring buffer from one worker to
+   another. A worker keeps the descriptors that do not fit until they do. */
+#define PROCESS_RING_SIZE 4096
+
+/* Microseconds between two checks of the workers by the parent process. */
+#define PROCESS_POLL_INTERVAL 200
+
+/**
+ * Ring buffer of descriptors from one worker to another, in shared memory.
+ * Only the sending worker writes the tail and only the receiving worker
+ * writes the head, so neither takes a lock. Both only grow.
+ */
+struct DescriptorRing
+{
+    /* Slot id, left extent and right extent of a descriptor. */
+    typedef std::array<uint32_t, 3> record_t;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail{0};
+    alignas(CACHE_LINE_SIZE) record_t records[PROCESS_RING_SIZE];
+};
+
+/**
+ * State of a parse that the parent process and the workers share, in shared
+ * memory.
+ */
+struct WorkerControl
+{
+    /* See ShardedParser::num_active. */
+    alignas(CACHE_LINE_SIZE) std::atomic<long> num_active{0};
+    /* Number of descriptors taken by all workers together. */
+    alignas(CACHE_LINE_SIZE) std::atomic<unsigned long> num_checks{0};
+    /* Bytes of the EPN sets of all workers, for the memory limit. */
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> epn_bytes{0};
+    /* Whether the workers must stop, and the reason, written once by the
+       first one to stop them. */
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> stopped{false};
+    char stop_reason[16] = {};
+};
+
+/**
+ * Represents the Process parser. Derived from the Sharded parser, of which it
+ * only replaces the way the shards run and communicate.
+ */
+class ProcessParser : public ShardedParser
+{
+private:
+    /* Shared memory of the last parse: the control block, the counters of
+       each worker, which it copies there when it is done, and the ring from
+       each worker to each worker, at index from * workers + to. */
+    void* shared_memory = nullptr;
+    size_t shared_size = 0;
+    WorkerControl* control = nullptr;
+    ThreadStatistics* worker_statistics = nullptr;
+    DescriptorRing* rings = nullptr;
+public:
+    ProcessParser(Grammar g, unsigned int p) : ShardedParser(g, p) {};
+    ~ProcessParser();
+    ProcessParser(const ProcessParser&) = delete;
+    ProcessParser& operator=(const ProcessParser&) = delete;
+private:
+    void loop() override;
+    void send(size_t from, size_t to) override;
+    bool receive(size_t index) override;
+    bool limit_reached(size_t index) override;
+    bool parse_stopped() const override;
+    bool stop_workers(const char* reason);
+    bool map_shared_memory(size_t num_workers);
+    void unmap_shared_memory();
+    std::string create_result_file() const;
+    [[noreturn]] void run_worker(size_t index, const std::string& name);
+    bool write_result(size_t index, const std::string& name) const;
+    bool read_result(const std::string& name);
+};
@@ -0,0 +1,226 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the Query parser. A query for X, i and j descends into X
+ *   at position i instead of the start symbol at position 0, and processes
+ *   descriptors like the Dense parser, in order of their right extent. Right
+ *   extents only grow, so once all descriptors up to j are processed, no
+ *   descriptor of X from i to j can appear anymore. A query stops there, or as
+ *   soon as X is completed from i to j. The descriptor store and the rest of
+ *   the worklist are kept, so a later query continues where the earlier ones
+ *   stopped and never processes a descriptor twice.
+ */
+
+#include "query_parser.hpp"
+#include <algorithm>
+
+/**
+ * @brief Constructs the parser for an input.
+ *
+ * @param g Grammar.
+ * @param input_sequence Input that the queries are about.
+ */
+QueryParser::QueryParser(Grammar g, std::vector<std::string> input_sequence)
+    : grammar(g), input(input_sequence)
+{
+    grammar.compile();
+    descriptor_store.reset(grammar.num_slots(), input.size());
+    worklist.resize(input.size() + 1);
+    right_extents.assign(descriptor_store.bitvector_words(), 0);
+}
+
+/**
+ * @brief Adds a descriptor to the worklist if it has not been processed and is
+ * not in the worklist yet.
+ *
+ * @param descriptor Descriptor to add to the worklist.
+ */
+void QueryParser::add_to_worklist(Descriptor descriptor)
+{
+    if (descriptor_store.contains(descriptor) || !pending.insert(descriptor).second)
+    {
+        return;
+    }
+
+    worklist[descriptor.right_extent].push_back(descriptor);
+    next_right_extent = std::min<size_t>(next_right_extent, descriptor.right_extent);
+}
+
+/**
+ * @brief Implements the 'match' operation.
+ *
+ * @param descriptor Descriptor that is being processed.
+ */
+void QueryParser::match(Descriptor descriptor)
+{
+    if (descriptor.right_extent < input.size() && descriptor.get_next_symbol() == input[descriptor.right_extent])
+    {
+        Descriptor d = descriptor.copy_and_advance();
+        d.right_extent++;
+
+        add_to_worklist(d);
+    }
+}
+
+/**
+ * @brief Implements the 'descend' operation.
+ *
+ * @param symbol Nonterminal symbol to find alternatives of.
+ * @param pivot Position to descend at.
+ */
+void QueryParser::descend(const std::string& symbol, unsigned int pivot)
+{
+    for (auto slot : grammar.get_initial_slots(symbol))
+    {
+        add_to_worklist(Descriptor(slot, pivot, pivot));
+    }
+}
+
+/**
+ * @brief Implements the 'skip' operation, using the right extents found by the
+ * last lookup.
+ *
+ * @param descriptor Descriptor currently being processed, with nonterminal skip.
+ */
+void QueryParser::skip(Descriptor descriptor)
+{
+    ExtentSet::for_each_bit(right_extents, [&](unsigned int right_extent) {
+        add_to_worklist(Descriptor(descriptor.slot, descriptor.left_extent, right_extent));
+    });
+}
+
+/**
+ * @brief Implements the 'ascend' operation.
+ *
+ * @param descriptor Completed descriptor that is being processed.
+ */
+void QueryParser::ascend(Descriptor descriptor)
+{
+    for (auto slot : grammar.get_waiting_slots(descriptor.slot->lhs_id))
+    {
+        descriptor_store.get_left_extents(slot, descriptor.left_extent).for_each([&](unsigned int left_extent) {
+            add_to_worklist(Descriptor(slot->next, left_extent, descriptor.right_extent));
+        });
+    }
+}
+
+/**
+ * @brief Processes a descriptor, like the Dense parser but without EPNs.
+ *
+ * @param descriptor Descriptor to be processed.
+ */
+void QueryParser::process_descriptor(Descriptor descriptor)
+{
+    if (descriptor.is_completed())
+    {
+        ascend(descriptor);
+        return;
+    }
+
+    if (descriptor.slot->next_is_terminal)
+    {
+        match(descriptor);
+        return;
+    }
+
+    bool found = false;
+    std::fill(right_extents.begin(), right_extents.end(), 0);
+
+    for (auto slot : grammar.get_completed_slots(descriptor.slot->next_symbol_id))
+    {
+        found |= descriptor_store.add_right_extents(slot, descriptor.right_extent, right_extents);
+    }
+
+    if (!found)
+    {
+        descend(descriptor.get_next_symbol(), descriptor.right_extent);
+    }
+    else
+    {
+        skip(descriptor.copy_and_advance());
+    }
+}
+
+/**
+ * @return True if a completed descriptor of the nonterminal with the given
+ * extents has been processed.
+ */
+bool QueryParser::is_derived(unsigned int symbol_id, unsigned int left_extent, unsigned int right_extent) const
+{
+    for (auto slot : grammar.get_completed_slots(symbol_id))
+    {
+        if (descriptor_store.get_right_extents(slot, left_extent).contains(right_extent))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Answers whether a symbol derives the input from a left extent up to a
+ * right extent. Processes the descriptors that the answer depends on and have
+ * not been processed by an earlier query.
+ *
+ * @param symbol Terminal or nonterminal.
+ * @param left_extent Position of the first token.
+ * @param right_extent Position after the last token.
+ *
+ * @return True if the symbol derives input[left_extent..right_extent), false
+ * otherwise or if the symbol or extents are not valid.
+ */
+bool QueryParser::derives(const std::string& symbol, unsigned int left_extent, unsigned int right_extent)
+{
+    if (left_extent > right_extent || right_extent > input.size())
+    {
+        return false;
+    }
+
+    if (grammar.terminals.count(symbol))
+    {
+        return right_extent == left_extent + 1 && input[left_extent] == symbol;
+    }
+
+    auto symbol_id = grammar.compiled->symbol_ids.find(symbol);
+
+    if (symbol_id == grammar.compiled->symbol_ids.end())
+    {
+        return false;
+    }
+
+    if (is_derived(symbol_id->second, left_extent, right_extent))
+    {
+        return true;
+    }
+
+    descend(symbol, left_extent);
+
+    while (next_right_extent <= right_extent)
+    {
+        auto& descriptors = worklist[next_right_extent];
+
+        if (descriptors.empty())
+        {
+            next_right_extent++;
+            continue;
+        }
+
+        Descriptor d = descriptors.back();
+        descriptors.pop_back();
+        pending.erase(d);
+        descriptor_store.insert(d);
+
+        process_descriptor(d);
+        num_processed++;
+
+        if (d.is_completed() && d.slot->lhs_id == symbol_id->second
+            && d.left_extent == left_extent && d.right_extent == right_extent)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
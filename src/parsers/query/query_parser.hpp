@@ -0,0 +1,49 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with the Query parser, which answers whether a symbol derives a
+ *   part of an input, parsing only what the questions need.
+ */
+
+#pragma once
+
+#include "../../components/grammar.hpp"
+#include "../../components/descriptor_store.hpp"
+
+/**
+ * Answers queries of the form "does X derive input[i..j)?" on a single input.
+ * The descriptors found by a query are kept for the next queries.
+ */
+class QueryParser
+{
+public:
+    /* Input grammar. */
+    Grammar grammar;
+    /* Input sequence. */
+    std::vector<std::string> input;
+    /* Descriptors processed by all queries so far. */
+    unsigned long num_processed = 0;
+private:
+    DescriptorStore descriptor_store;
+    /* Descriptors that still have to be processed, by right extent. */
+    std::vector<std::vector<Descriptor>> worklist;
+    /* Descriptors in the worklist. */
+    descriptor_set_t pending;
+    /* Smallest right extent that may have descriptors in the worklist. */
+    size_t next_right_extent = 0;
+    /* Right extents found by the last 'skip' lookup. */
+    std::vector<uint64_t> right_extents;
+public:
+    QueryParser(Grammar g, std::vector<std::string> input_sequence);
+public:
+    bool derives(const std::string& symbol, unsigned int left_extent, unsigned int right_extent);
+private:
+    bool is_derived(unsigned int symbol_id, unsigned int left_extent, unsigned int right_extent) const;
+    void process_descriptor(Descriptor descriptor);
+    void match(Descriptor descriptor);
+    void descend(const std::string& symbol, unsigned int pivot);
+    void skip(Descriptor descriptor);
+    void ascend(Descriptor descriptor);
+    void add_to_worklist(Descriptor descriptor);
+};
@@ -9,18 +9,18 @@
 #include <iostream>
 
 // #define COLLECT_NUM_DERIVATIONS
-#define COLLECT_NUM_ACTIONS
 
 /**
  * @brief Adds a single descriptor to the worklist if it doesn't already exist
- * in the descriptor set
+ * in the descriptor set. With OPTIMISATION_INSERT_ON_DISCOVER, it is added to
+ * the descriptor set here instead of when it is processed.
  *
  * @param descriptor Descriptor to add to the worklist.
  */
 void SequentialParser::add_to_worklist(Descriptor descriptor)
 {
 #ifdef COLLECT_NUM_DERIVATIONS
-    if (descriptor.lhs == grammar.start_symbol
+    if (descriptor.lhs() == grammar.start_symbol
         && descriptor.is_completed()
         && descriptor.left_extent == 0
         && descriptor.right_extent == input.size())
@@ -29,30 +29,34 @@ void SequentialParser::add_to_worklist(Descriptor descriptor)
     }
 #endif
 
-    if (!descriptor_set.count(descriptor))
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+    if (!descriptor_set.insert(descriptor).second || !worklist.insert(descriptor))
+#else
+    if (descriptor_set.count(descriptor) || !worklist.insert(descriptor))
+#endif
     {
-        worklist.insert(descriptor);
+        Statistics::current().num_duplicates++;
     }
 }
 
 /**
- * @brief Extends the worklist with the provided rules, using the provided left
+ * @brief Extends the worklist with the provided slots, using the provided left
  * and right extents. Does not add a new descriptor if it is already in the
  * descriptors set.
  *
- * @param rules Rules to extend the worklist with.
+ * @param slots Initial slots of the rules to extend the worklist with.
  * @param left_extent Left extent of the new descriptors.
  * @param right_extent Right extent of the new descriptors.
  */
 void SequentialParser::extend_worklist(
-    std::vector<production_rule_t> rules,
-    int left_extent,
-    int right_extent
+    const std::vector<const GrammarSlot*>& slots,
+    unsigned int left_extent,
+    unsigned int right_extent
 )
 {
-    for (auto rule : rules)
+    for (auto slot : slots)
     {
-        Descriptor d(rule.first, rule.second, 0, left_extent, right_extent);
+        Descriptor d(slot, left_extent, right_extent);
 
         add_to_worklist(d);
     }
@@ -66,12 +70,11 @@ void SequentialParser::extend_worklist(
  */
 void SequentialParser::match(Descriptor descriptor)
 {
-#ifdef COLLECT_NUM_ACTIONS
-    num_match++;
-#endif
-    std::string terminal = descriptor.get_next_symbol();
+    Statistics::current().num_match++;
 
-    if (input.size() > 0 && terminal == input[descriptor.right_extent])
+    const std::string& terminal = descriptor.get_next_symbol();
+
+    if (descriptor.right_extent < input.size() && terminal == input[descriptor.right_extent])
     {
         Descriptor d = descriptor.copy_and_advance();
         d.right_extent++;
@@ -79,6 +82,7 @@ void SequentialParser::match(Descriptor descriptor)
         add_to_worklist(d);
 
         epn_set.insert(EPN(d, descriptor.right_extent));
+        enforce_memory_budget(epn_set);
     }
 }
 
@@ -90,15 +94,14 @@ void SequentialParser::match(Descriptor descriptor)
  * @param pivot Pivot of the currently processed descriptor.
  */
 void SequentialParser::descend(
-    std::string symbol,
+    const std::string& symbol,
     unsigned int pivot
 )
 {
-#ifdef COLLECT_NUM_ACTIONS
-    num_descend++;
-#endif
+    Statistics::current().num_descend++;
+
     extend_worklist(
-        grammar.get_production_rules(symbol),
+        grammar.get_initial_slots(symbol),
         pivot,
         pivot
     );
@@ -109,25 +112,27 @@ void SequentialParser::descend(
  * and find the valid descriptors.
  *
  * @param descriptor Descriptor currently being processed, with nonterminal skip.
- * @param right_extents Set of valid right extents for new descriptors.
+ * @param right_extents Bitvector of valid right extents for new descriptors.
  */
 void SequentialParser::skip(
     Descriptor descriptor,
-    std::unordered_set<unsigned int> right_extents
+    const std::vector<uint64_t>& right_extents
 )
 {
-#ifdef COLLECT_NUM_ACTIONS
-    num_skip++;
-#endif
-    for (int right_extent : right_extents)
-    {
-        Descriptor new_descriptor(descriptor);
-        new_descriptor.right_extent = right_extent;
+    std::vector<EPN> epns;
 
-        add_to_worklist(new_descriptor);
+    Statistics::current().num_skip++;
 
-        epn_set.insert(EPN(new_descriptor, descriptor.right_extent));
-    }
+    epns.reserve(ExtentSet::count_bits(right_extents));
+
+    ExtentSet::for_each_bit(right_extents, [&](unsigned int right_extent) {
+        add_to_worklist(Descriptor(descriptor.slot, descriptor.left_extent, right_extent));
+
+        epns.push_back(EPN(descriptor.slot, descriptor.left_extent, descriptor.right_extent, right_extent));
+    });
+
+    epn_set.insert(epns.begin(), epns.end());
+    enforce_memory_budget(epn_set);
 }
 
 /**
@@ -143,9 +148,10 @@ void SequentialParser::ascend(
     unsigned int right_extent
 )
 {
-#ifdef COLLECT_NUM_ACTIONS
-    num_ascend++;
-#endif
+    std::vector<EPN> epns;
+
+    Statistics::current().num_ascend++;
+
     for (auto descriptor : descriptors)
     {
         Descriptor new_descriptor(descriptor);
@@ -153,8 +159,11 @@ void SequentialParser::ascend(
 
         add_to_worklist(new_descriptor);
 
-        epn_set.insert(EPN(new_descriptor, descriptor.right_extent));
+        epns.push_back(EPN(new_descriptor, descriptor.right_extent));
     }
+
+    epn_set.insert(epns.begin(), epns.end());
+    enforce_memory_budget(epn_set);
 }
 
 /**
@@ -167,10 +176,11 @@ void SequentialParser::process_descriptor(Descriptor descriptor)
 {
     if (!descriptor.is_completed())
     {
-        std::unordered_set<unsigned int> right_extents;
-        std::string symbol = descriptor.get_next_symbol();
+        std::vector<uint64_t> right_extents(input.size() / 64 + 1, 0);
+        bool found = false;
+        const std::string& symbol = descriptor.get_next_symbol();
 
-        if (grammar.terminals.count(symbol))
+        if (descriptor.slot->next_is_terminal)
         {
             match(descriptor);
         }
@@ -178,13 +188,14 @@ void SequentialParser::process_descriptor(Descriptor descriptor)
         {
             for (auto d : descriptor_set)
             {
-                if (d.lhs == symbol && d.left_extent == descriptor.right_extent && d.is_completed())
+                if (d.slot->lhs_id == descriptor.slot->next_symbol_id && d.left_extent == descriptor.right_extent && d.is_completed())
                 {
-                    right_extents.insert(d.right_extent);
+                    right_extents[d.right_extent / 64] |= uint64_t(1) << (d.right_extent % 64);
+                    found = true;
                 }
             }
 
-            if (right_extents.size() == 0)
+            if (!found)
             {
                 descend(symbol, descriptor.right_extent);
             }
@@ -200,7 +211,7 @@ void SequentialParser::process_descriptor(Descriptor descriptor)
 
         for (auto d : descriptor_set)
         {
-            if (!d.is_completed() && d.get_next_symbol() == descriptor.lhs && d.right_extent == descriptor.left_extent)
+            if (!d.is_completed() && d.slot->next_symbol_id == descriptor.slot->lhs_id && d.right_extent == descriptor.left_extent)
             {
                 descriptors.insert(d.copy_and_advance());
             }
@@ -211,6 +222,7 @@ void SequentialParser::process_descriptor(Descriptor descriptor)
         if (descriptor.is_empty())
         {
             epn_set.insert(EPN(descriptor));
+            enforce_memory_budget(epn_set);
         }
     }
 }
@@ -218,62 +230,72 @@ void SequentialParser::process_descriptor(Descriptor descriptor)
 /**
  * @brief Call the parse method of the base class.
  */
-std::tuple<descriptor_set_t, epn_set_t>
-SequentialParser::parse(std::vector<std::string> input_sequence)
+ParseResult SequentialParser::parse(std::vector<std::string> input_sequence)
 {
-    return Parser::parse(input_sequence);
+    return Parser::parse(std::move(input_sequence));
 }
 
 /**
- * @brief Processes descriptors one by one, taking them from the beginning of
- * the set.
+ * @brief Processes descriptors one by one, taking them from the worklist in
+ * the order of its policy.
  */
-std::tuple<descriptor_set_t, epn_set_t> SequentialParser::loop()
+void SequentialParser::loop()
 {
-#ifdef COLLECT_NUM_ACTIONS
-    num_ascend = 0;
-    num_descend = 0;
-    num_match = 0;
-    num_skip = 0;
+    /* Clear the output of a previous parse, and the worklist of one that was
+       stopped. */
+#ifdef OPTIMISATION_INSERT_ON_DISCOVER
+    worklist = Worklist(worklist_policy, false);
+#else
+    worklist = Worklist(worklist_policy);
 #endif
+    descriptor_set.clear();
+    epn_set.clear();
+    num_derivations = 0;
+
+    ThreadStatistics& counters = Statistics::current();
+
+    statistics.worklist_policy = worklist_policy;
+
     extend_worklist(
-        grammar.get_production_rules(grammar.start_symbol)
+        grammar.get_initial_slots(grammar.start_symbol)
     );
 
-    while (!worklist.empty())
+    while (!worklist.empty() && !should_stop())
     {
-        Descriptor d = *worklist.begin();
+        counters.record_queue_depth(worklist.size());
+
+        Descriptor d = worklist.take();
+#ifndef OPTIMISATION_INSERT_ON_DISCOVER
         descriptor_set.insert(d);
+#endif
 
         process_descriptor(d);
 
-        num_descriptors++;
-        worklist.erase(d);
+        counters.num_processed++;
     }
+}
 
-    return std::make_tuple(descriptor_set, epn_set);
+/**
+ * @return The descriptor set and EPN set, moved out of the parser.
+ */
+ParseResult SequentialParser::get_result()
+{
+    return ParseResult(std::move(descriptor_set), std::move(epn_set));
 }
 
 /**
  * @brief Print data for experiments.
  */
-void SequentialParser::print_data()
+void SequentialParser::print_data(const ParseResult& result)
 {
     std::cout << input.size()
-#ifdef COLLECT_NUM_ACTIONS
-              << "," << num_match
-              << "," << num_descend
-              << "," << num_skip
-              << "," << num_ascend
-#else
               << "," << timer.elapsedMilliseconds()
-              << "," << num_descriptors
+              << "," << statistics.total().num_processed
               << "," << 1
-              << "," << descriptor_set.size()
-              << "," << epn_set.size()
+              << "," << result.descriptors.size()
+              << "," << num_epns(result.epns)
 #ifdef COLLECT_NUM_DERIVATIONS
               << "," << num_derivations
-#endif
 #endif
               << std::endl;
 }
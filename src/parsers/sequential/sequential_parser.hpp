@@ -8,35 +8,32 @@
 #pragma once
 
 #include "../../components/parser.hpp"
+#include "../../components/descriptor_store.hpp"
 
 class SequentialParser : public Parser
 {
 public:
-    descriptor_set_t worklist;
+    Worklist worklist;
     descriptor_set_t descriptor_set;
     epn_set_t epn_set;
-    int num_descriptors;
-    int num_derivations;
-    int num_match;
-    int num_descend;
-    int num_ascend;
-    int num_skip;
+    int num_derivations = 0;
 public:
-    SequentialParser(Grammar g) : Parser(g) { num_descriptors = 0; };
+    SequentialParser(Grammar g) : Parser(g) {};
 public:
-    std::tuple<descriptor_set_t, epn_set_t> parse(std::vector<std::string> input_sequence);
+    ParseResult parse(std::vector<std::string> input_sequence);
 private:
-    std::tuple<descriptor_set_t, epn_set_t> loop() override;
-    void print_data() override;
+    void loop() override;
+    ParseResult get_result() override;
+    void print_data(const ParseResult& result) override;
     void process_descriptor(Descriptor descriptor);
     void match(Descriptor descriptor);
-    void descend(std::string symbol, unsigned int pivot);
-    void skip(Descriptor descriptor, std::unordered_set<unsigned int> right_extents);
+    void descend(const std::string& symbol, unsigned int pivot);
+    void skip(Descriptor descriptor, const std::vector<uint64_t>& right_extents);
     void ascend(descriptor_set_t descriptors, unsigned int right_extent);
     void add_to_worklist(Descriptor descriptor);
     void extend_worklist(
-        std::vector<production_rule_t> rules,
-        int left_extent = 0,
-        int right_extent = 0
+        const std::vector<const GrammarSlot*>& slots,
+        unsigned int left_extent = 0,
+        unsigned int right_extent = 0
     );
 };
\ No newline at end of file
@@ -0,0 +1,587 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the Sharded parallel parser. Every thread owns one shard
+ *   of the descriptor space and is the only thread that reads or writes it.
+ *   A descriptor belongs to the shard of its key: the nonterminal after the
+ *   dot and the right extent, or for a completed descriptor its left-hand
+ *   side and left extent. A descriptor that waits for a nonterminal at a
+ *   position and the completions of that nonterminal there thus meet in the
+ *   same shard, like in the Chunked parser, and 'ascend' and 'skip' only look
+ *   at the shard itself. The keys are hashed onto the shards, which spreads
+ *   the work of neighbouring positions over the threads.
+ *   A thread adds the descriptors of its own shard to its worklist, and
+ *   collects those of other shards into batches that it sends through a
+ *   mailbox, one for every pair of shards. Nothing is locked. The parse is
+ *   done once no thread is busy and no batch is on its way, which a single
+ *   counter of both keeps track of.
+ */
+
+#include "sharded_parser.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Frees the batches that were not received.
+ */
+Mailbox::~Mailbox()
+{
+    while (head)
+    {
+        Node* next = head->next.load(std::memory_order_relaxed);
+        delete head;
+        head = next;
+    }
+}
+
+/**
+ * @brief Sends a batch. Only called by the thread of the sending shard.
+ *
+ * @param batch Descriptors to send.
+ */
+void Mailbox::push(pooled_vector_t<Descriptor>&& batch)
+{
+    Node* node = new Node();
+    node->batch = std::move(batch);
+
+    tail->next.store(node, std::memory_order_release);
+    tail = node;
+}
+
+/**
+ * @brief Receives the oldest batch that was sent, if any. Only called by the
+ * thread of the receiving shard.
+ *
+ * @param batch Set to the descriptors of the batch.
+ *
+ * @return True if a batch was received, false if the mailbox was empty.
+ */
+bool Mailbox::pop(pooled_vector_t<Descriptor>& batch)
+{
+    Node* next = head->next.load(std::memory_order_acquire);
+
+    if (!next)
+    {
+        return false;
+    }
+
+    batch = std::move(next->batch);
+    delete head;
+    head = next;
+
+    return true;
+}
+
+/**
+ * @brief Constructs the parser and indexes the initial slots of the grammar.
+ *
+ * @param g Grammar.
+ * @param t Number of threads, and of shards.
+ */
+ShardedParser::ShardedParser(Grammar g, unsigned int t)
+    : Parser(g), num_threads(std::max(t, 1u)), num_active(&local_active)
+{
+    initial_slots.assign(grammar.compiled->symbol_ids.size(), nullptr);
+
+    for (auto& symbol : grammar.compiled->symbol_ids)
+    {
+        if (!grammar.terminals.count(symbol.first))
+        {
+            initial_slots[symbol.second] = &grammar.get_initial_slots(symbol.first);
+        }
+    }
+}
+
+/**
+ * @return Index of the shard that a key belongs to.
+ */
+size_t ShardedParser::owner(uint64_t key) const
+{
+    /* Fibonacci hashing, so that consecutive positions go to different shards. */
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) % shards.size();
+}
+
+/**
+ * @return Index of the shard that a descriptor belongs to.
+ */
+size_t ShardedParser::owner(const Descriptor& descriptor) const
+{
+    if (descriptor.is_completed())
+    {
+        return owner(make_key(descriptor.slot->lhs_id, descriptor.left_extent));
+    }
+
+    return owner(make_key(descriptor.slot->next_symbol_id, descriptor.right_extent));
+}
+
+/**
+ * @brief Adds a descriptor to the worklist of its shard if it is not in the
+ * descriptor set of the shard yet. Only called by the thread of the shard.
+ *
+ * @param shard Shard of the descriptor.
+ * @param descriptor Descriptor to add.
+ */
+void ShardedParser::accept(Shard& shard, const Descriptor& descriptor)
+{
+    if (!shard.descriptor_set.insert(descriptor).second || !shard.worklist.insert(descriptor))
+    {
+        Statistics::current().num_duplicates++;
+    }
+}
+
+/**
+ * @brief Adds a descriptor to the worklist of a shard, or to the batch for its
+ * shard if that is another one. A full batch is sent.
+ *
+ * @param index Index of the shard of the calling thread.
+ * @param descriptor Descriptor to add.
+ */
+void ShardedParser::add_to_worklist(size_t index, Descriptor descriptor)
+{
+    size_t target = owner(descriptor);
+
+    if (target == index)
+    {
+        accept(shards[index], descriptor);
+        return;
+    }
+
+    auto& outbox = shards[index].outboxes[target];
+
+    outbox.push_back(descriptor);
+
+    if (outbox.size() >= SHARD_BATCH_SIZE)
+    {
+        send(index, target);
+    }
+}
+
+/**
+ * @brief Sends the batch of a shard for another shard. The descriptors count
+ * as work until they are received.
+ *
+ * @param from Index of the sending shard.
+ * @param to Index of the receiving shard.
+ */
+void ShardedParser::send(size_t from, size_t to)
+{
+    auto& outbox = shards[from].outboxes[to];
+
+    num_active->fetch_add(static_cast<long>(outbox.size()));
+    mailboxes[from * shards.size() + to]->push(std::move(outbox));
+
+    outbox = pooled_vector_t<Descriptor>();
+    outbox.reserve(SHARD_BATCH_SIZE);
+}
+
+/**
+ * @brief Receives the batches sent to a shard and adds their descriptors to
+ * its worklist. A shard that was idle becomes busy again before the received
+ * descriptors stop counting as work, so the counter never drops to 0 early.
+ *
+ * @param index Index of the shard of the calling thread.
+ *
+ * @return True if any batch was received, false otherwise.
+ */
+bool ShardedParser::receive(size_t index)
+{
+    Shard& shard = shards[index];
+    pooled_vector_t<Descriptor> batch;
+    bool received = false;
+
+    for (size_t from = 0; from < shards.size(); from++)
+    {
+        if (from == index)
+        {
+            continue;
+        }
+
+        while (mailboxes[from * shards.size() + index]->pop(batch))
+        {
+            if (!shard.active)
+            {
+                shard.active = true;
+                num_active->fetch_add(1);
+            }
+
+            for (auto& descriptor : batch)
+            {
+                accept(shard, descriptor);
+            }
+
+            num_active->fetch_sub(static_cast<long>(batch.size()));
+            received = true;
+        }
+    }
+
+    return received;
+}
+
+/**
+ * @brief Implements the 'match' operation: add a new descriptor and EPN if the
+ * current descriptor matches the correct terminal in the input string.
+ *
+ * @param index Index of the shard of the descriptor.
+ * @param descriptor Descriptor that is being processed.
+ */
+void ShardedParser::match(size_t index, Descriptor descriptor)
+{
+    Statistics::current().num_match++;
+
+    const std::string& terminal = descriptor.get_next_symbol();
+
+    if (descriptor.right_extent < input.size() && terminal == input[descriptor.right_extent])
+    {
+        Descriptor d = descriptor.copy_and_advance();
+        d.right_extent++;
+
+        add_to_worklist(index, d);
+
+        shards[index].epn_set.insert(EPN(d, descriptor.right_extent));
+    }
+}
+
+/**
+ * @brief Implements the 'descend' operation: add a new descriptor for every
+ * alternative of a nonterminal at a position.
+ *
+ * @param index Index of the shard of the calling thread.
+ * @param symbol_id Symbol id of the nonterminal.
+ * @param pivot Position to descend at.
+ */
+void ShardedParser::descend(size_t index, unsigned int symbol_id, unsigned int pivot)
+{
+    Statistics::current().num_descend++;
+
+    for (auto slot : *initial_slots[symbol_id])
+    {
+        add_to_worklist(index, Descriptor(slot, pivot, pivot));
+    }
+}
+
+/**
+ * @brief Implements the 'skip' operation: skip over the nonterminal after the
+ * dot, using the right extents at which it is known to be completed.
+ *
+ * @param index Index of the shard of the descriptor.
+ * @param descriptor Descriptor with the dot advanced over the nonterminal.
+ * @param right_extents Right extents of the nonterminal.
+ */
+void ShardedParser::skip(size_t index, Descriptor descriptor, const ExtentSet& right_extents)
+{
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_skip++;
+
+    epns.reserve(right_extents.size());
+
+    right_extents.for_each([&](unsigned int right_extent) {
+        add_to_worklist(index, Descriptor(descriptor.slot, descriptor.left_extent, right_extent));
+
+        epns.push_back(EPN(descriptor.slot, descriptor.left_extent, descriptor.right_extent, right_extent));
+    });
+
+    shards[index].epn_set.insert(epns.begin(), epns.end());
+}
+
+/**
+ * @brief Implements the 'ascend' operation: a nonterminal has been completed
+ * at a right extent, and every descriptor that waits for it is advanced to
+ * that right extent. Those all belong to the same shard as the completion.
+ *
+ * @param index Index of the shard of the completion.
+ * @param key Key of the nonterminal and its left extent.
+ * @param right_extent Right extent of the completed nonterminal.
+ */
+void ShardedParser::ascend(size_t index, uint64_t key, unsigned int right_extent)
+{
+    Shard& shard = shards[index];
+
+    if (!shard.completions[key].insert(right_extent, num_words))
+    {
+        return;
+    }
+
+    pooled_vector_t<EPN> epns;
+
+    Statistics::current().num_ascend++;
+
+    auto waiting = shard.waiting.find(key);
+
+    if (waiting != shard.waiting.end())
+    {
+        for (auto& descriptor : waiting->second)
+        {
+            Descriptor new_descriptor = descriptor.copy_and_advance();
+            new_descriptor.right_extent = right_extent;
+
+            add_to_worklist(index, new_descriptor);
+
+            epns.push_back(EPN(new_descriptor, descriptor.right_extent));
+        }
+    }
+
+    shard.epn_set.insert(epns.begin(), epns.end());
+}
+
+/**
+ * @brief Processes a descriptor. A nonterminal after the dot is descended once
+ * per position and skipped over with the completions known so far. Later
+ * completions reach the descriptor through 'ascend'.
+ *
+ * @param index Index of the shard of the descriptor.
+ * @param descriptor Descriptor to be processed.
+ */
+void ShardedParser::process_descriptor(size_t index, Descriptor descriptor)
+{
+    Shard& shard = shards[index];
+
+    if (descriptor.is_completed())
+    {
+        ascend(index, make_key(descriptor.slot->lhs_id, descriptor.left_extent), descriptor.right_extent);
+
+        if (descriptor.is_empty())
+        {
+            shard.epn_set.insert(EPN(descriptor));
+        }
+
+        return;
+    }
+
+    if (descriptor.slot->next_is_terminal)
+    {
+        match(index, descriptor);
+        return;
+    }
+
+    uint64_t key = make_key(descriptor.slot->next_symbol_id, descriptor.right_extent);
+
+    shard.waiting[key].push_back(descriptor);
+
+    if (shard.descended.insert(key).second)
+    {
+        descend(index, descriptor.slot->next_symbol_id, descriptor.right_extent);
+    }
+
+    auto completions = shard.completions.find(key);
+
+    if (completions != shard.completions.end())
+    {
+        skip(index, descriptor.copy_and_advance(), completions->second);
+    }
+}
+
+/**
+ * @brief Processes the descriptors of a shard and receives those sent to it,
+ * until no shard has work left or the parse is stopped. A worker only goes
+ * idle once all its descriptors for other shards have been sent.
+ *
+ * @param index Index of the shard.
+ */
+void ShardedParser::run(size_t index)
+{
+    ThreadStatistics& counters = Statistics::current();
+    Shard& shard = shards[index];
+    unsigned long num_since_receive = 0;
+
+    while (true)
+    {
+        if (shard.worklist.empty())
+        {
+            bool unsent = false;
+
+            for (size_t target = 0; target < shards.size(); target++)
+            {
+                if (!shard.outboxes[target].empty())
+                {
+                    send(index, target);
+                    unsent |= !shard.outboxes[target].empty();
+                }
+            }
+
+            if (receive(index))
+            {
+                continue;
+            }
+
+            if (shard.active && !unsent)
+            {
+                shard.active = false;
+                num_active->fetch_sub(1);
+            }
+
+            if (num_active->load() == 0 || parse_stopped())
+            {
+                break;
+            }
+
+            auto idle_start = std::chrono::steady_clock::now();
+
+            std::this_thread::yield();
+
+            counters.idle_time += static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - idle_start
+            ).count());
+
+            continue;
+        }
+
+        if (limit_reached(index))
+        {
+            break;
+        }
+
+        counters.record_queue_depth(shard.worklist.size());
+
+        process_descriptor(index, shard.worklist.take());
+
+        counters.num_processed++;
+
+        /* Keep receiving while busy, so that mailboxes do not grow without
+           bound. */
+        if (++num_since_receive % SHARD_BATCH_SIZE == 0)
+        {
+            receive(index);
+        }
+    }
+}
+
+/**
+ * @param index Index of the shard.
+ *
+ * @return Whether the worker of a shard must stop before processing the next
+ * descriptor. Counts the descriptor for the limits, and stops the parse when
+ * the EPN sets of all shards together take more than the memory limit.
+ */
+bool ShardedParser::limit_reached(size_t index)
+{
+    if (count_epn_memory(shards[index].epn_set, shards[index].epn_bytes, epn_bytes))
+    {
+        return stop("memory");
+    }
+
+    return should_stop();
+}
+
+/**
+ * @brief Call the parse method of the base class.
+ */
+ParseResult ShardedParser::parse(std::vector<std::string> input_sequence)
+{
+    return Parser::parse(std::move(input_sequence));
+}
+
+/**
+ * @brief Clears the result of a previous parse, creates a shard for every
+ * thread and adds the start descriptors to their shards.
+ */
+void ShardedParser::start_shards()
+{
+    descriptor_set.clear();
+    epn_set.clear();
+    epn_bytes = 0;
+    statistics.worklist_policy = worklist_policy;
+
+    size_t num_shards = num_threads;
+
+    num_words = input.size() / 64 + 1;
+    shards.assign(num_shards, Shard());
+
+    for (auto& shard : shards)
+    {
+        shard.worklist = Worklist(worklist_policy, false);
+        shard.outboxes.assign(num_shards, {});
+    }
+
+    /* Every worker starts out busy. */
+    num_active->store(static_cast<long>(num_shards));
+
+    auto start = grammar.compiled->symbol_ids.find(grammar.start_symbol);
+
+    if (start != grammar.compiled->symbol_ids.end() && initial_slots[start->second])
+    {
+        uint64_t key = make_key(start->second, 0);
+
+        Statistics::current().num_descend++;
+        shards[owner(key)].descended.insert(key);
+
+        for (auto slot : *initial_slots[start->second])
+        {
+            Descriptor d(slot, 0, 0);
+            accept(shards[owner(d)], d);
+        }
+    }
+}
+
+/**
+ * @brief Merges the descriptors and EPNs of the shards into the result and
+ * frees the shards.
+ */
+void ShardedParser::merge_shards()
+{
+    for (auto& shard : shards)
+    {
+        descriptor_set.insert(shard.descriptor_set.begin(), shard.descriptor_set.end());
+        epn_set.insert(shard.epn_set.begin(), shard.epn_set.end());
+        enforce_memory_budget(epn_set);
+
+        shard = Shard();
+    }
+
+    shards.clear();
+}
+
+/**
+ * @brief Creates the shards and the mailboxes between them, and runs a thread
+ * per shard. The calling thread runs the first shard. Afterwards, the shards
+ * are merged into the result.
+ */
+void ShardedParser::loop()
+{
+    start_shards();
+
+    mailboxes.clear();
+
+    for (size_t index = 0; index < shards.size() * shards.size(); index++)
+    {
+        mailboxes.push_back(std::make_unique<Mailbox>());
+    }
+
+    worker_threads.start(shards.size() - 1, [this](size_t index) {
+        ThreadStatistics& counters = statistics.add_thread();
+
+        run(index + 1);
+        counters.stop_cpu_clock();
+    });
+
+    run(0);
+    worker_threads.wait();
+
+    merge_shards();
+    mailboxes.clear();
+}
+
+/**
+ * @return The descriptor set and EPN set, moved out of the parser.
+ */
+ParseResult ShardedParser::get_result()
+{
+    return ParseResult(std::move(descriptor_set), std::move(epn_set));
+}
+
+/**
+ * @brief Print data for experiments.
+ */
+void ShardedParser::print_data(const ParseResult& result)
+{
+    std::cout << input.size()
+              << "," << timer.elapsedMilliseconds()
+              << "," << statistics.total().num_processed
+              << "," << num_threads
+              << "," << result.descriptors.size()
+              << "," << num_epns(result.epns)
+              << std::endl;
+}
@@ -0,0 +1,141 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with the Sharded parallel parser, which partitions the
+ *   descriptors over shards that are each owned by one thread, and passes
+ *   descriptors between the shards as messages.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include "../../components/parser.hpp"
+#include "../../components/descriptor_store.hpp"
+#include "../../utilities/pool_allocator.hpp"
+
+/* Number of descriptors that a shard collects for another shard before it
+   sends them as one message. */
+#define SHARD_BATCH_SIZE 64
+
+/**
+ * Queue of batches of descriptors from one shard to another. Only the thread
+ * of the sending shard pushes and only the thread of the receiving shard
+ * pops, so neither takes a lock. The queue is unbounded, so a sender never
+ * waits for the receiver.
+ */
+class Mailbox
+{
+private:
+    struct Node
+    {
+        pooled_vector_t<Descriptor> batch;
+        std::atomic<Node*> next{nullptr};
+    };
+
+    /* Node before the first batch, used by the receiver, and the node of the
+       last batch, used by the sender. */
+    alignas(CACHE_LINE_SIZE) Node* head;
+    alignas(CACHE_LINE_SIZE) Node* tail;
+public:
+    Mailbox() : head(new Node()), tail(head) {};
+    ~Mailbox();
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+public:
+    void push(pooled_vector_t<Descriptor>&& batch);
+    bool pop(pooled_vector_t<Descriptor>& batch);
+};
+
+/**
+ * Part of the descriptor space of the Sharded parser, only used by the thread
+ * of the shard. Pairs of a nonterminal and a position are keys, see
+ * ShardedParser::make_key().
+ */
+struct alignas(CACHE_LINE_SIZE) Shard
+{
+    Worklist worklist;
+    descriptor_set_t descriptor_set;
+    epn_set_t epn_set;
+    /* Bytes of the EPN set counted for the memory limit. */
+    size_t epn_bytes = 0;
+    /* Right extents of the completed nonterminals at a left extent. */
+    pooled_map_t<uint64_t, ExtentSet> completions;
+    /* Descriptors waiting for a nonterminal at their right extent. */
+    pooled_map_t<uint64_t, pooled_vector_t<Descriptor>> waiting;
+    /* Nonterminals descended at a position. */
+    pooled_set_t<uint64_t> descended;
+    /* Descriptors for each other shard that have not been sent yet. */
+    std::vector<pooled_vector_t<Descriptor>> outboxes;
+    /* Whether the thread of the shard is counted as busy. */
+    bool active = true;
+};
+
+/**
+ * Represents the Sharded parser. Derived from the Parser class.
+ */
+class ShardedParser : public Parser
+{
+public:
+    /* Number of threads, one per shard. */
+    unsigned int num_threads;
+    descriptor_set_t descriptor_set;
+    epn_set_t epn_set;
+protected:
+    std::vector<Shard> shards;
+    /* Number of busy workers plus the number of descriptors that were sent
+       and not received yet. The parse is done once it drops to 0. Points to
+       local_active, unless a derived parser shares it with other processes. */
+    std::atomic<long>* num_active;
+private:
+    /* Mailbox from each shard to each shard, at index from * shards + to. */
+    std::vector<std::unique_ptr<Mailbox>> mailboxes;
+    /* Number of 64-bit words in a bitvector over all extents. */
+    size_t num_words = 1;
+    /* Initial slots of each nonterminal, indexed by symbol id. */
+    std::vector<const std::vector<const GrammarSlot*>*> initial_slots;
+    alignas(CACHE_LINE_SIZE) std::atomic<long> local_active{0};
+    /* Bytes of the EPN sets of all shards, for the memory limit. */
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> epn_bytes{0};
+public:
+    ShardedParser(Grammar g, unsigned int t);
+public:
+    ParseResult parse(std::vector<std::string> input_sequence);
+protected:
+    void start_shards();
+    void merge_shards();
+    void run(size_t index);
+    void accept(Shard& shard, const Descriptor& descriptor);
+    virtual void send(size_t from, size_t to);
+    virtual bool receive(size_t index);
+
+    virtual bool limit_reached(size_t index);
+
+    /**
+     * @return Whether the parse has been stopped by any worker.
+     */
+    virtual bool parse_stopped() const { return is_stopped(); }
+private:
+    void loop() override;
+    ParseResult get_result() override;
+    void print_data(const ParseResult& result) override;
+    void add_to_worklist(size_t index, Descriptor descriptor);
+    void process_descriptor(size_t index, Descriptor descriptor);
+    void match(size_t index, Descriptor descriptor);
+    void descend(size_t index, unsigned int symbol_id, unsigned int pivot);
+    void skip(size_t index, Descriptor descriptor, const ExtentSet& right_extents);
+    void ascend(size_t index, uint64_t key, unsigned int right_extent);
+    size_t owner(uint64_t key) const;
+    size_t owner(const Descriptor& descriptor) const;
+
+    /**
+     * @return Key of a nonterminal at a position.
+     */
+    static uint64_t make_key(unsigned int symbol_id, unsigned int position)
+    {
+        return (static_cast<uint64_t>(position) << 32) | symbol_id;
+    }
+};
@@ -8,34 +8,14 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <filesystem>
 #include "argparse.hpp"
+#include "../parsers/parsers.hpp"
+#include "profiled_mutex.hpp"
 
 /**
- * @brief Gets the file names for the grammar and input files from the command line
- * arguments.
- *
- * @param argc Amount of arguments.
- * @param argv Array of arguments.
- *
- * @return Tuple with both filenames and a boolean indicating success.
- */
-std::tuple<std::string, std::string, bool> get_file_names(int argc, char const *argv[])
-{
-    switch (argc)
-    {
-    case 1:
-        std::cerr << "Error: missing arguments 'grammar_file' and 'input_file/input_string'" << std::endl;
-        return std::make_tuple("", "", false);
-    case 2:
-        std::cerr << "Error: missing argument 'input_file/input_string'" << std::endl;
-        return std::make_tuple("", "", false);
-    default:
-        return std::make_tuple(std::string(argv[1]), std::string(argv[2]), true);
-    }
-}
-
-/**
- * @brief Reads the grammar from the grammar file.
+ * @brief Reads the grammar from the grammar file and compiles it.
  *
  * @param grammar_file Filestream to read the grammar from.
  *
@@ -93,6 +73,8 @@ Grammar get_grammar(std::ifstream& grammar_file)
         }
     }
 
+    grammar.compile();
+
     return grammar;
 }
 
@@ -132,37 +114,369 @@ std::vector<std::string> get_input(std::ifstream& input_file, std::string argume
     return input;
 }
 
+
+
+/**
+ * @brief Reads the grammar from a file.
+ *
+ * @param file_name Name of the grammar file.
+ * @param grammar Variable to store the grammar in.
+ *
+ * @return True if the file could be opened, false otherwise.
+ */
+bool read_grammar_file(std::string file_name, Grammar& grammar)
+{
+    std::ifstream grammar_file(file_name);
+
+    if (!grammar_file)
+    {
+        std::cerr << "Error: unable to open file '" << file_name << "'" << std::endl;
+        return false;
+    }
+
+    grammar = get_grammar(grammar_file);
+
+    return true;
+}
+
 /**
- * @brief Gets the grammar and input from the command line arguments.
+ * @brief Reads the space-separated input from a file.
+ *
+ * @param file_name Name of the input file.
+ *
+ * @return Input sequence of symbols.
+ */
+std::vector<std::string> read_input_file(std::string file_name)
+{
+    std::ifstream input_file(file_name);
+
+    return get_input(input_file, "");
+}
+
+/**
+ * @brief Expands the input arguments of batch mode into a list of input files.
+ * A directory is replaced by the '.input' files it contains, and an argument
+ * of the form '@<file>' by the file names listed in that file, one per line.
+ *
+ * @param arguments Input arguments.
+ * @param input_files Vector to add the input files to.
+ *
+ * @return True if all arguments could be expanded, false otherwise.
+ */
+bool get_input_files(std::vector<std::string> arguments, std::vector<std::string>& input_files)
+{
+    for (auto argument : arguments)
+    {
+        if (argument.size() > 1 && argument[0] == '@')
+        {
+            std::ifstream list_file(argument.substr(1));
+            std::string line;
+
+            if (!list_file)
+            {
+                std::cerr << "Error: unable to open file '" << argument.substr(1) << "'" << std::endl;
+                return false;
+            }
+
+            while (std::getline(list_file, line))
+            {
+                if (!line.empty())
+                {
+                    input_files.push_back(line);
+                }
+            }
+        }
+        else if (std::filesystem::is_directory(argument))
+        {
+            std::vector<std::string> files;
+
+            for (auto& entry : std::filesystem::directory_iterator(argument))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".input")
+                {
+                    files.push_back(entry.path().string());
+                }
+            }
+
+            std::sort(files.begin(), files.end());
+            input_files.insert(input_files.end(), files.begin(), files.end());
+        }
+        else if (std::filesystem::is_regular_file(argument))
+        {
+            input_files.push_back(argument);
+        }
+        else
+        {
+            std::cerr << "Error: unable to open file '" << argument << "'" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Reads the value of an option that takes a positive number.
+ *
+ * @param option Name of the option.
+ * @param value Value of the option.
+ * @param result Variable to store the number in.
+ *
+ * @return True if the value is a positive number, false otherwise.
+ */
+template <typename T>
+bool get_number_option(std::string option, std::string value, T& result)
+{
+    unsigned long number = 0;
+
+    try
+    {
+        number = std::stoul(value);
+    }
+    catch (const std::exception& e) {}
+
+    if (number == 0)
+    {
+        std::cerr << "Error: option '" << option << "' expects a positive number" << std::endl;
+        return false;
+    }
+
+    result = static_cast<T>(number);
+
+    return true;
+}
+
+/**
+ * @brief Gets the grammar, input and options from the command line arguments.
+ * Usage:
+ *   main [options] <grammar_file> <input_file/input_string>
+ *   main --batch [options] <grammar_file> <input_file/directory/@list_file>...
+ *   main --server [--socket <path>] [options] <grammar_file>
+ * Options:
+ *   --engine <sequential|dense|pool|tree|chunked|sharded|process|chart|auto>
+ *                                    Parser engine. Default: pool.
+ *   --threads <n>                    Number of worker threads. Default: 16.
+ *   --worklist <hash|fifo|lifo|extent|slot>
+ *                                    Order in which descriptors are taken from
+ *                                    the worklists. Default: hash.
+ *   --large-threshold <n>            Minimum length of an input that is spread
+ *                                    across all workers in batch mode.
+ *   --socket <path>                  Unix domain socket to serve on in server
+ *                                    mode, instead of standard input/output.
+ *   --stats-json                     Print the statistics of the parse as JSON.
+ *   --phases                         Print the wall time of each phase of the
+ *                                    run, the CPU time and the peak memory.
+ *   --validate                       Check the output of the parser.
+ *   --output <file>                  Write the descriptors and EPNs to a binary
+ *                                    result file.
+ *   --output-text <file>             Write the descriptors and EPNs as text,
+ *                                    sorted by slot and extents.
+ *   --memory-budget <MB>             Spill the EPNs to disk when their set
+ *                                    takes more memory. Single parses only.
+ *   --spill-dir <dir>                Directory of the spilled EPNs.
+ *                                    Default: /tmp.
+ *   --time-limit <ms>                Stop a parse after this wall time.
+ *   --descriptor-limit <n>           Stop a parse after this many descriptors.
+ *   --memory-limit <MB>              Stop a parse when its EPN set takes more
+ *                                    memory.
+ *   --lock-profile                   Profile the locks of the parallel parsers
+ *                                    and print a contention report per parse
+ *                                    to standard error.
  *
  * @param argc Amount of arguments.
  * @param argv Array of arguments.
  *
- * @return Tuple with grammar, input and a boolean indicating success.
+ * @return Parsed arguments.
  */
-std::tuple<Grammar, std::vector<std::string>, bool> parse_arguments(int argc, char const *argv[])
+Arguments parse_arguments(int argc, char const *argv[])
 {
-    auto file_names = get_file_names(argc, argv);
-    std::string grammar_file_name = std::get<0>(file_names);
-    std::string input_file_name = std::get<1>(file_names);
-    std::ifstream grammar_file(grammar_file_name);
-    std::ifstream input_file(input_file_name);
-    Grammar grammar;
-    std::vector<std::string> input_string;
+    Arguments arguments;
+    std::vector<std::string> positional;
 
-    if (!std::get<2>(file_names))
+    for (int i = 1; i < argc; i++)
     {
-        return std::make_tuple(grammar, input_string, false);
+        std::string argument(argv[i]);
+
+        if (argument.rfind("--", 0) != 0)
+        {
+            positional.push_back(argument);
+            continue;
+        }
+
+        if (argument == "--batch")
+        {
+            arguments.batch = true;
+            continue;
+        }
+
+        if (argument == "--server")
+        {
+            arguments.server = true;
+            continue;
+        }
+
+        if (argument == "--stats-json")
+        {
+            arguments.print_statistics = true;
+            continue;
+        }
+
+        if (argument == "--phases")
+        {
+            arguments.print_phases = true;
+            continue;
+        }
+
+        if (argument == "--validate")
+        {
+            arguments.validate = true;
+            continue;
+        }
+
+        if (argument == "--lock-profile")
+        {
+            LockProfiler::enable(true);
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Error: unknown option '" << argument << "' or missing value" << std::endl;
+            return arguments;
+        }
+
+        std::string value(argv[++i]);
+
+        if (argument == "--engine")
+        {
+            if (!is_parser_engine(value))
+            {
+                std::cerr << "Error: unknown engine '" << value << "'" << std::endl;
+                return arguments;
+            }
+
+            arguments.engine = value;
+        }
+        else if (argument == "--worklist")
+        {
+            if (!Worklist::is_policy(value))
+            {
+                std::cerr << "Error: unknown worklist policy '" << value << "'" << std::endl;
+                return arguments;
+            }
+
+            arguments.worklist_policy = value;
+        }
+        else if (argument == "--threads")
+        {
+            if (!get_number_option(argument, value, arguments.num_threads))
+            {
+                return arguments;
+            }
+        }
+        else if (argument == "--large-threshold")
+        {
+            if (!get_number_option(argument, value, arguments.large_input_threshold))
+            {
+                return arguments;
+            }
+        }
+        else if (argument == "--socket")
+        {
+            arguments.socket_path = value;
+        }
+        else if (argument == "--output")
+        {
+            arguments.output_file = value;
+        }
+        else if (argument == "--output-text")
+        {
+            arguments.output_text_file = value;
+        }
+        else if (argument == "--memory-budget")
+        {
+            if (!get_number_option(argument, value, arguments.memory_budget))
+            {
+                return arguments;
+            }
+        }
+        else if (argument == "--spill-dir")
+        {
+            arguments.spill_directory = value;
+        }
+        else if (argument == "--time-limit")
+        {
+            if (!get_number_option(argument, value, arguments.time_limit))
+            {
+                return arguments;
+            }
+        }
+        else if (argument == "--descriptor-limit")
+        {
+            if (!get_number_option(argument, value, arguments.descriptor_limit))
+            {
+                return arguments;
+            }
+        }
+        else if (argument == "--memory-limit")
+        {
+            if (!get_number_option(argument, value, arguments.memory_limit))
+            {
+                return arguments;
+            }
+        }
+        else
+        {
+            std::cerr << "Error: unknown option '" << argument << "'" << std::endl;
+            return arguments;
+        }
     }
 
-    if (!grammar_file)
+    switch (positional.size())
     {
-        std::cerr << "Error: unable to open file '" << grammar_file_name << "'" << std::endl;
-        return std::make_tuple(grammar, input_string, false);
+    case 0:
+        std::cerr << "Error: missing arguments 'grammar_file' and 'input_file/input_string'" << std::endl;
+        return arguments;
+    case 1:
+        if (arguments.server)
+        {
+            break;
+        }
+
+        std::cerr << "Error: missing argument 'input_file/input_string'" << std::endl;
+        return arguments;
+    default:
+        break;
     }
 
-    grammar = get_grammar(grammar_file);
-    input_string = get_input(input_file, input_file_name);
+    arguments.phases.start("load_grammar");
+
+    if (!read_grammar_file(positional[0], arguments.grammar))
+    {
+        return arguments;
+    }
+
+    arguments.phases.start("load_input");
+
+    if (arguments.server)
+    {
+        arguments.success = true;
+    }
+    else if (arguments.batch)
+    {
+        std::vector<std::string> inputs(positional.begin() + 1, positional.end());
+
+        arguments.success = get_input_files(inputs, arguments.input_files);
+    }
+    else
+    {
+        std::ifstream input_file(positional[1]);
+
+        arguments.input = get_input(input_file, positional[1]);
+        arguments.success = true;
+    }
+
+    arguments.phases.stop();
 
-    return std::make_tuple(grammar, input_string, true);
+    return arguments;
 }
\ No newline at end of file
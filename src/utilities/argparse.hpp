@@ -8,5 +8,59 @@
 #pragma once
 
 #include "../components/grammar.hpp"
+#include "../components/worklist.hpp"
+#include "phases.hpp"
 
-std::tuple<Grammar, std::vector<std::string>, bool> parse_arguments(int argc, char const *argv[]);
\ No newline at end of file
+/**
+ * Options read from the command line.
+ */
+struct Arguments
+{
+    /* Input grammar. */
+    Grammar grammar;
+    /* Input sequence, used when parsing a single input. */
+    std::vector<std::string> input;
+    /* Input files, used in batch mode. */
+    std::vector<std::string> input_files;
+    /* Whether to parse many inputs against the grammar in one run. */
+    bool batch = false;
+    /* Whether to keep running and serve parse requests. */
+    bool server = false;
+    /* Path of the Unix domain socket to serve on. Standard input and output are used if empty. */
+    std::string socket_path;
+    /* Name of the parser engine. */
+    std::string engine = "pool";
+    /* Number of worker threads. */
+    unsigned int num_threads = 16;
+    /* Order in which the parsers take descriptors from their worklists. */
+    std::string worklist_policy = DEFAULT_WORKLIST_POLICY;
+    /* Whether to print the statistics of the parse as JSON. */
+    bool print_statistics = false;
+    /* Whether to print the wall time of each phase of the run as JSON. */
+    bool print_phases = false;
+    /* Whether to check the output of the parser for correctness. */
+    bool validate = false;
+    /* File to write the result to in the binary result format. Not written if empty. */
+    std::string output_file;
+    /* File to write the result to as sorted text. Not written if empty. */
+    std::string output_text_file;
+    /* Megabytes the EPN set of a single parse may take before its EPNs are spilled to disk. No limit if 0. */
+    size_t memory_budget = 0;
+    /* Directory of the files of spilled EPNs. */
+    std::string spill_directory = "/tmp";
+    /* Limits of every parse: wall time in milliseconds, descriptors, and
+       megabytes of the EPN set. No limit if 0. */
+    double time_limit = 0;
+    unsigned long descriptor_limit = 0;
+    size_t memory_limit = 0;
+    /* Wall time of loading the grammar and input. */
+    PhaseTimer phases;
+    /* Inputs of at least this length are spread across all workers in batch mode. */
+    size_t large_input_threshold = 64;
+    /* Whether the arguments were parsed successfully. */
+    bool success = false;
+};
+
+Arguments parse_arguments(int argc, char const *argv[]);
+bool read_grammar_file(std::string file_name, Grammar& grammar);
+std::vector<std::string> read_input_file(std::string file_name);
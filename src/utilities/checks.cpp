@@ -7,27 +7,48 @@
  *   and P(1)-P(3) from Van Binsbergen (2018).
  */
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include "checks.hpp"
 
-bool is_correct = true;
+namespace
+{
+    /* Key of the index of completed descriptors: symbol id of the left-hand side and left extent. */
+    typedef std::tuple<unsigned int, unsigned int> completed_key_t;
+    /* Maps a left-hand side and left extent to the right extents of the completed descriptors. */
+    typedef std::unordered_map<completed_key_t, std::vector<unsigned int>, hash_custom::hash<completed_key_t>> completed_index_t;
+
+    /**
+     * Read-only data shared by all threads of the checker.
+     */
+    struct CheckContext
+    {
+        const descriptor_set_t& descriptors;
+        const epn_set_t& epns;
+        Grammar& grammar;
+        const std::vector<std::string>& input;
+        completed_index_t completed;
+    };
+}
 
 /**
- * @brief Check if an EPN is in a set of EPNs. Prints a message
+ * @brief Check if an EPN is in a set of EPNs. Writes a message to the output
  * if this is not the case.
  *
- * @param epn Descriptor to check.
- * @param epns Set of descriptors.
+ * @param epn EPN to check.
+ * @param epns Set of EPNs.
+ * @param out Stream to write the message to.
  *
  * @return True if the EPN is in the set, false otherwise.
  */
-bool check_if_exists(EPN epn, epn_set_t epns)
+bool check_if_exists(const EPN& epn, const epn_set_t& epns, std::ostream& out)
 {
     if (!epns.count(epn))
     {
-        std::cout << "Missing EPN " << epn << std::endl;
-
-        is_correct = false;
+        out << "Missing EPN " << epn << std::endl;
         return false;
     }
 
@@ -35,21 +56,20 @@ bool check_if_exists(EPN epn, epn_set_t epns)
 }
 
 /**
- * @brief Check if a descriptor is in a set of descriptors. Prints a message
- * if this is not the case.
+ * @brief Check if a descriptor is in a set of descriptors. Writes a message to
+ * the output if this is not the case.
  *
  * @param descriptor Descriptor to check.
  * @param descriptors Set of descriptors.
+ * @param out Stream to write the message to.
  *
  * @return True if the descriptor is in the set, false otherwise.
  */
-bool check_if_exists(Descriptor descriptor, descriptor_set_t descriptors)
+bool check_if_exists(const Descriptor& descriptor, const descriptor_set_t& descriptors, std::ostream& out)
 {
     if (!descriptors.count(descriptor))
     {
-        std::cout << "Missing descriptor " << descriptor << std::endl;
-
-        is_correct = false;
+        out << "Missing descriptor " << descriptor << std::endl;
         return false;
     }
 
@@ -57,79 +77,185 @@ bool check_if_exists(Descriptor descriptor, descriptor_set_t descriptors)
 }
 
 /**
- * @brief Check correctness of the parsing output for some input.
+ * @brief Check the requirements that follow from a single descriptor of the
+ * output. R(1) is checked separately, because it does not depend on a
+ * descriptor.
+ *
+ * @param descriptor Descriptor to check.
+ * @param context Output of the parser and indexes built from it.
+ * @param out Stream to write messages about missing items to.
+ *
+ * @return True if all requirements hold, false otherwise.
+ */
+bool check_descriptor(Descriptor descriptor, const CheckContext& context, std::ostream& out)
+{
+    bool correct = true;
+
+    if (!descriptor.is_completed())
+    {
+        auto& symbol = descriptor.get_next_symbol();
+
+        if (descriptor.slot->next_is_terminal && descriptor.right_extent < context.input.size() && symbol == context.input[descriptor.right_extent])
+        {
+            Descriptor d = descriptor.copy_and_advance();
+            d.right_extent++;
+
+            /* Check requirement R(2). */
+            if (check_if_exists(d, context.descriptors, out))
+            {
+                /* Check requirement P(1). */
+                correct &= check_if_exists(EPN(d, descriptor.right_extent), context.epns, out);
+            }
+            else
+            {
+                correct = false;
+            }
+        }
+        else
+        {
+            for (auto slot : context.grammar.get_initial_slots(symbol))
+            {
+                /* Check requirement R(3). */
+                correct &= check_if_exists(Descriptor(slot, descriptor.right_extent, descriptor.right_extent), context.descriptors, out);
+            }
+
+            auto completed = context.completed.find(std::make_tuple(descriptor.slot->next_symbol_id, descriptor.right_extent));
+
+            if (completed != context.completed.end())
+            {
+                for (auto right_extent : completed->second)
+                {
+                    Descriptor d_new = descriptor.copy_and_advance();
+                    d_new.right_extent = right_extent;
+
+                    /* Check requirement R(4). */
+                    correct &= check_if_exists(d_new, context.descriptors, out);
+                    /* Check requirement P(2). */
+                    correct &= check_if_exists(EPN(d_new, descriptor.right_extent), context.epns, out);
+                }
+            }
+        }
+    }
+    else if (descriptor.is_empty())
+    {
+        /* Check requirement P(3). */
+        correct &= check_if_exists(EPN(descriptor), context.epns, out);
+    }
+
+    return correct;
+}
+
+/**
+ * @brief Check correctness of the parsing output for some input. The grammar
+ * is compiled if needed. The completed descriptors are indexed by left-hand
+ * side and left extent, so
+ * that R(4) and P(2) only visit the descriptors they apply to. The
+ * descriptors are divided over the threads, and the messages about missing
+ * items are printed per thread after all threads have finished.
  *
  * @param descriptors Output descriptor set.
  * @param epns Output EPN set.
  * @param grammar Input grammar.
  * @param input Input sequence.
+ * @param num_threads Number of threads to use. Uses the number of hardware
+ * threads if 0.
+ *
+ * @return True if all requirements hold, false otherwise.
  */
 bool check_correctness(
-    descriptor_set_t descriptors,
-    epn_set_t epns,
-    Grammar grammar,
-    std::vector<std::string> input
+    const descriptor_set_t& descriptors,
+    const epn_set_t& epns,
+    Grammar& grammar,
+    const std::vector<std::string>& input,
+    unsigned int num_threads
 )
 {
-    auto start_symbol_rules = grammar.get_production_rules(grammar.start_symbol);
+    CheckContext context{descriptors, epns, grammar, input, {}};
+    std::vector<Descriptor> items(descriptors.begin(), descriptors.end());
+    bool correct = true;
+
+    grammar.compile();
+
+    for (auto& descriptor : items)
+    {
+        if (descriptor.is_completed())
+        {
+            context.completed[std::make_tuple(descriptor.slot->lhs_id, descriptor.left_extent)].push_back(descriptor.right_extent);
+        }
+    }
 
-    for (auto rule : start_symbol_rules)
+    for (auto slot : grammar.get_initial_slots(grammar.start_symbol))
     {
         /* Check requirement R(1). */
-        check_if_exists(Descriptor(grammar.start_symbol, rule.second, 0, 0, 0), descriptors);
+        correct &= check_if_exists(Descriptor(slot, 0, 0), descriptors, std::cout);
     }
 
-    for (auto descriptor : descriptors)
+    if (num_threads == 0)
     {
-        if (!descriptor.is_completed())
-        {
-            auto symbol = descriptor.get_next_symbol();
+        num_threads = std::max(1U, std::thread::hardware_concurrency());
+    }
 
-            if (grammar.terminals.count(symbol) && symbol == input[descriptor.right_extent])
-            {
-                Descriptor d = descriptor.copy_and_advance();
-                d.right_extent++;
+    num_threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(num_threads, items.size())));
+
+    std::vector<std::thread> threads;
+    std::vector<std::stringstream> messages(num_threads);
+    std::vector<char> results(num_threads, true);
+    size_t chunk_size = (items.size() + num_threads - 1) / num_threads;
 
-                /* Check requirement R(2). */
-                bool result = check_if_exists(d, descriptors);
+    for (unsigned int t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            size_t end = std::min(items.size(), (t + 1) * chunk_size);
 
-                if (result)
+            for (size_t i = t * chunk_size; i < end; i++)
+            {
+                if (!check_descriptor(items[i], context, messages[t]))
                 {
-                    /* Check requirement P(1). */
-                    check_if_exists(EPN(d, descriptor.right_extent), epns);
+                    results[t] = false;
                 }
             }
-            else
-            {
-                auto rules = grammar.get_production_rules(symbol);
+        });
+    }
 
-                for (auto rule : rules)
-                {
-                    /* Check requirement R(3). */
-                    check_if_exists(Descriptor(symbol, rule.second, 0, descriptor.right_extent, descriptor.right_extent), descriptors);
-                }
+    for (unsigned int t = 0; t < num_threads; t++)
+    {
+        threads[t].join();
+        std::cout << messages[t].str();
+        correct &= static_cast<bool>(results[t]);
+    }
 
-                for (auto d : descriptors)
-                {
-                    if (d.lhs == symbol && d.is_completed() && d.left_extent == descriptor.right_extent)
-                    {
-                        Descriptor d_new = descriptor.copy_and_advance();
-                        d_new.right_extent = d.right_extent;
-
-                        /* Check requirement R(4). */
-                        check_if_exists(d_new, descriptors);
-                        /* Check requirement P(2). */
-                        check_if_exists(EPN(d_new, descriptor.right_extent), epns);
-                    }
-                }
-            }
+    return correct;
+}
+
+/**
+ * @brief Check if the input sequence is in the language of the grammar, i.e.
+ * if a descriptor exists for a fully processed production rule of the start
+ * symbol that spans the whole input. The grammar is compiled if needed.
+ *
+ * @param descriptors Output descriptor set.
+ * @param grammar Input grammar.
+ * @param input_length Length of the input sequence.
+ *
+ * @return True if the input is recognised, false otherwise.
+ */
+bool is_recognised(const descriptor_set_t& descriptors, Grammar& grammar, size_t input_length)
+{
+    grammar.compile();
+
+    for (auto slot : grammar.get_initial_slots(grammar.start_symbol))
+    {
+        unsigned int length = static_cast<unsigned int>(input_length);
+
+        while (!slot->completed)
+        {
+            slot = slot->next;
         }
-        else if (descriptor.is_empty())
+
+        if (descriptors.count(Descriptor(slot, 0, length)))
         {
-            /* Check requirement P(3). */
-            check_if_exists(EPN(descriptor), epns);
+            return true;
         }
     }
 
-    return is_correct;
-}
\ No newline at end of file
+    return false;
+}
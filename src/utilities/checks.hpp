@@ -10,8 +10,10 @@
 #include "../components/grammar.hpp"
 
 bool check_correctness(
-    descriptor_set_t descriptors,
-    epn_set_t epns,
-    Grammar grammar,
-    std::vector<std::string> input
-);
\ No newline at end of file
+    const descriptor_set_t& descriptors,
+    const epn_set_t& epns,
+    Grammar& grammar,
+    const std::vector<std::string>& input,
+    unsigned int num_threads = 0
+);
+bool is_recognised(const descriptor_set_t& descriptors, Grammar& grammar, size_t input_length);
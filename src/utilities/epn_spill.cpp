@@ -0,0 +1,335 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of EPNs spilled to disk.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <unistd.h>
+#include "epn_spill.hpp"
+
+namespace
+{
+    /**
+     * Buffered reader of the records of a run.
+     */
+    class RunReader
+    {
+    private:
+        std::ifstream file;
+        std::vector<EPNSpill::record_t> buffer;
+        size_t position = 0;
+    public:
+        RunReader(const std::string& name, size_t buffer_records) : file(name, std::ios::binary), buffer(buffer_records)
+        {
+            fill();
+        }
+
+        bool done() const { return position >= buffer.size(); }
+        bool failed() const { return !file.is_open() || file.bad(); }
+        const EPNSpill::record_t& current() const { return buffer[position]; }
+
+        /**
+         * @brief Moves to the next record.
+         */
+        void next()
+        {
+            if (++position == buffer.size())
+            {
+                fill();
+            }
+        }
+    private:
+        /**
+         * @brief Reads the next records into the buffer.
+         */
+        void fill()
+        {
+            buffer.resize(buffer.capacity());
+            file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(EPNSpill::record_t)));
+            buffer.resize(static_cast<size_t>(file.gcount()) / sizeof(EPNSpill::record_t));
+            position = 0;
+        }
+    };
+
+    /**
+     * @brief Writes records to a file.
+     *
+     * @return True if the records were written.
+     */
+    bool write_records(std::ofstream& file, const std::vector<EPNSpill::record_t>& records)
+    {
+        return static_cast<bool>(file.write(
+            reinterpret_cast<const char*>(records.data()),
+            static_cast<std::streamsize>(records.size() * sizeof(EPNSpill::record_t))
+        ));
+    }
+}
+
+/**
+ * @brief Creates an empty spill.
+ *
+ * @param dir Directory of the temporary files.
+ */
+EPNSpill::EPNSpill(std::string dir) : directory(dir) {}
+
+/**
+ * @brief Removes the files of the runs.
+ */
+EPNSpill::~EPNSpill()
+{
+    for (auto& run : runs)
+    {
+        std::remove(run.c_str());
+    }
+}
+
+/**
+ * @brief Creates a new temporary file in the directory of the spill.
+ *
+ * @param file Stream to open on the file.
+ *
+ * @return Name of the file, or an empty string if it could not be created.
+ */
+std::string EPNSpill::create_file(std::ofstream& file)
+{
+    std::string name = directory + "/cds-epns-XXXXXX";
+    int descriptor = mkstemp(&name[0]);
+
+    if (descriptor < 0)
+    {
+        std::cerr << "Error: unable to create a temporary file in '" << directory << "'" << std::endl;
+        return "";
+    }
+
+    close(descriptor);
+    file.open(name, std::ios::binary | std::ios::trunc);
+
+    return name;
+}
+
+/**
+ * @brief Writes EPNs to disk as a new sorted run.
+ *
+ * @param epns EPNs to write.
+ *
+ * @return True if the run was written, false otherwise.
+ */
+bool EPNSpill::write_run(const epn_set_t& epns)
+{
+    std::vector<record_t> records;
+    std::ofstream file;
+
+    records.reserve(epns.size());
+
+    for (auto& epn : epns)
+    {
+        if (slots.size() <= epn.slot->id)
+        {
+            slots.resize(epn.slot->id + 1, nullptr);
+        }
+
+        slots[epn.slot->id] = epn.slot;
+        records.push_back({ epn.slot->id, epn.left_extent, epn.pivot, epn.right_extent });
+    }
+
+    std::sort(records.begin(), records.end());
+
+    std::string name = create_file(file);
+
+    if (name.empty())
+    {
+        return false;
+    }
+
+    bool written = write_records(file, records);
+    file.close();
+
+    if (!written || !file)
+    {
+        std::cerr << "Error: unable to write EPNs to '" << name << "'" << std::endl;
+        std::remove(name.c_str());
+        return false;
+    }
+
+    runs.push_back(name);
+    run_sizes.push_back(records.size());
+    merged = false;
+
+    return true;
+}
+
+/**
+ * @brief Merges a range of runs into a new run without duplicates.
+ *
+ * @param first Index of the first run.
+ * @param last Index after the last run.
+ * @param name Variable to store the name of the new run in.
+ * @param size Variable to store the number of EPNs of the new run in.
+ *
+ * @return True if the runs were merged, false otherwise.
+ */
+bool EPNSpill::merge_runs(size_t first, size_t last, std::string& name, size_t& size)
+{
+    std::vector<std::unique_ptr<RunReader>> readers;
+    std::vector<record_t> output;
+    std::ofstream file;
+    bool has_previous = false;
+    record_t previous = {};
+
+    auto later = [&readers](size_t a, size_t b) {
+        return readers[b]->current() < readers[a]->current();
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> queue(later);
+
+    name = create_file(file);
+    size = 0;
+
+    if (name.empty())
+    {
+        return false;
+    }
+
+    for (size_t run = first; run < last; run++)
+    {
+        readers.push_back(std::make_unique<RunReader>(runs[run], BUFFER_RECORDS));
+
+        if (readers.back()->failed())
+        {
+            std::cerr << "Error: unable to read EPNs from '" << runs[run] << "'" << std::endl;
+            return false;
+        }
+
+        if (!readers.back()->done())
+        {
+            queue.push(readers.size() - 1);
+        }
+    }
+
+    output.reserve(BUFFER_RECORDS);
+
+    while (!queue.empty())
+    {
+        size_t reader = queue.top();
+        queue.pop();
+
+        const record_t& record = readers[reader]->current();
+
+        if (!has_previous || record != previous)
+        {
+            output.push_back(record);
+            previous = record;
+            has_previous = true;
+            size++;
+
+            if (output.size() == BUFFER_RECORDS)
+            {
+                if (!write_records(file, output))
+                {
+                    break;
+                }
+
+                output.clear();
+            }
+        }
+
+        readers[reader]->next();
+
+        if (!readers[reader]->done())
+        {
+            queue.push(reader);
+        }
+    }
+
+    bool written = write_records(file, output);
+    file.close();
+
+    if (!written || !file)
+    {
+        std::cerr << "Error: unable to write EPNs to '" << name << "'" << std::endl;
+        return false;
+    }
+
+    for (auto& reader : readers)
+    {
+        if (reader->failed())
+        {
+            std::cerr << "Error: unable to read spilled EPNs" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Merges all runs into a single run without duplicates, at most
+ * FAN_IN runs at a time.
+ *
+ * @return True if the runs were merged, false otherwise.
+ */
+bool EPNSpill::merge()
+{
+    /* A single run comes from a set, so it has no duplicates. */
+    while (runs.size() > 1)
+    {
+        std::vector<std::string> merged_runs;
+        std::vector<size_t> merged_sizes;
+
+        for (size_t first = 0; first < runs.size(); first += FAN_IN)
+        {
+            size_t last = std::min(first + FAN_IN, runs.size());
+            std::string name;
+            size_t size = 0;
+            bool success = merge_runs(first, last, name, size);
+
+            if (!name.empty())
+            {
+                merged_runs.push_back(name);
+                merged_sizes.push_back(size);
+            }
+
+            if (!success)
+            {
+                for (auto& run : merged_runs)
+                {
+                    std::remove(run.c_str());
+                }
+
+                return false;
+            }
+        }
+
+        for (auto& run : runs)
+        {
+            std::remove(run.c_str());
+        }
+
+        runs.swap(merged_runs);
+        run_sizes.swap(merged_sizes);
+    }
+
+    merged = true;
+
+    return true;
+}
+
+/**
+ * @return Number of EPNs in the runs. Only exact after merge().
+ */
+size_t EPNSpill::size() const
+{
+    size_t size = 0;
+
+    for (auto run_size : run_sizes)
+    {
+        size += run_size;
+    }
+
+    return size;
+}
@@ -0,0 +1,89 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   EPNs spilled to disk by a parser that exceeds its memory budget. Each
+ *   spill writes the EPNs of the parser to a temporary file, as a run of
+ *   fixed-size records sorted by slot, left extent, pivot and right extent.
+ *   Runs may share EPNs. At the end of the parse the runs are combined by an
+ *   external merge, which removes the duplicates, into a single run that can
+ *   be read back in order. The files are removed with the spill.
+ */
+
+#pragma once
+
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+class EPNSpill
+{
+public:
+    /* Slot id, left extent, pivot and right extent of an EPN. */
+    typedef std::array<uint32_t, 4> record_t;
+private:
+    /* Maximum number of runs merged at once. */
+    static constexpr size_t FAN_IN = 64;
+    /* Number of records read or written at once. */
+    static constexpr size_t BUFFER_RECORDS = 4096;
+
+    /* Directory of the temporary files. */
+    std::string directory;
+    /* Names of the files of the runs. */
+    std::vector<std::string> runs;
+    /* Number of EPNs in each run. */
+    std::vector<size_t> run_sizes;
+    /* Slots of the EPNs, indexed by slot id. */
+    std::vector<const GrammarSlot*> slots;
+    /* Whether the runs have been merged into one. */
+    bool merged = false;
+public:
+    EPNSpill(std::string directory);
+    ~EPNSpill();
+    EPNSpill(const EPNSpill&) = delete;
+    EPNSpill& operator=(const EPNSpill&) = delete;
+public:
+    bool write_run(const epn_set_t& epns);
+    bool merge();
+    size_t size() const;
+    size_t num_runs() const { return runs.size(); }
+
+    /**
+     * @brief Calls a function for every EPN of the merged run, in order of
+     * slot id, left extent, pivot and right extent.
+     *
+     * @param function Function to call with each EPN.
+     *
+     * @return True if the run could be read, false otherwise.
+     */
+    template <typename Function>
+    bool for_each(Function function) const
+    {
+        if (!merged || runs.empty())
+        {
+            return merged;
+        }
+
+        std::ifstream file(runs[0], std::ios::binary);
+        std::vector<record_t> buffer(BUFFER_RECORDS);
+
+        while (file)
+        {
+            file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(record_t)));
+
+            size_t count = static_cast<size_t>(file.gcount()) / sizeof(record_t);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                function(EPN(slots[buffer[i][0]], buffer[i][1], buffer[i][2], buffer[i][3]));
+            }
+        }
+
+        return file.eof();
+    }
+private:
+    std::string create_file(std::ofstream& file);
+    bool merge_runs(size_t first, size_t last, std::string& name, size_t& size);
+};
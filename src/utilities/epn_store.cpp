@@ -0,0 +1,386 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the columnar EPN store.
+ */
+
+#include <algorithm>
+#include <tuple>
+#include "epn_store.hpp"
+
+namespace
+{
+    /**
+     * @return Sort key of an EPN in a block.
+     */
+    std::tuple<unsigned int, unsigned int, unsigned int, unsigned int> block_key(const EPN& epn)
+    {
+        return std::make_tuple(epn.slot->id, epn.left_extent, epn.right_extent, epn.pivot);
+    }
+}
+
+/**
+ * @brief Packs values into the column, replacing its contents.
+ *
+ * @param values Values to store.
+ */
+void PackedColumn::assign(const std::vector<unsigned int>& values)
+{
+    words.clear();
+    base = values.empty() ? 0 : *std::min_element(values.begin(), values.end());
+    width = 0;
+
+    unsigned int range = values.empty() ? 0 : *std::max_element(values.begin(), values.end()) - base;
+
+    while (width < 32 && range >> width)
+    {
+        width++;
+    }
+
+    words.assign((values.size() * width + 63) / 64, 0);
+
+    for (size_t index = 0; index < values.size() && width > 0; index++)
+    {
+        uint64_t value = values[index] - base;
+        size_t bit = index * width;
+        size_t word = bit / 64;
+        unsigned int offset = static_cast<unsigned int>(bit % 64);
+
+        words[word] |= value << offset;
+
+        if (offset + width > 64)
+        {
+            words[word + 1] |= value >> (64 - offset);
+        }
+    }
+
+    words.shrink_to_fit();
+}
+
+/**
+ * @brief Creates an iterator at the first EPN of the store, or at its end.
+ *
+ * @param s Store to iterate over.
+ * @param at_end Whether to create the end iterator.
+ */
+EPNStore::iterator::iterator(const EPNStore* s, bool at_end)
+    : store(s), block(at_end ? s->blocks.size() : 0), index(0),
+      recent(at_end ? s->recent.end() : s->recent.begin())
+{
+    if (block < store->blocks.size())
+    {
+        current = store->get(store->blocks[block], index);
+    }
+    else if (recent != store->recent.end())
+    {
+        current = *recent;
+    }
+}
+
+/**
+ * @brief Moves to the next EPN.
+ */
+EPNStore::iterator& EPNStore::iterator::operator++()
+{
+    if (block < store->blocks.size())
+    {
+        if (++index == store->blocks[block].size)
+        {
+            block++;
+            index = 0;
+        }
+    }
+    else
+    {
+        ++recent;
+    }
+
+    if (block < store->blocks.size())
+    {
+        current = store->get(store->blocks[block], index);
+    }
+    else if (recent != store->recent.end())
+    {
+        current = *recent;
+    }
+
+    return *this;
+}
+
+/**
+ * @return True if both iterators are at the same EPN.
+ */
+bool EPNStore::iterator::operator==(const iterator& other) const
+{
+    return block == other.block && index == other.index
+        && (block < store->blocks.size() || recent == other.recent);
+}
+
+/**
+ * @brief Adds an EPN to the store. The collected EPNs are frozen into a block
+ * once there are enough of them.
+ *
+ * @param epn EPN to add.
+ *
+ * @return True if the EPN was not in the store yet.
+ */
+bool EPNStore::insert(const EPN& epn)
+{
+    if (count(epn) || !recent.insert(epn).second)
+    {
+        return false;
+    }
+
+    if (slots.size() <= epn.slot->id)
+    {
+        slots.resize(epn.slot->id + 1, nullptr);
+    }
+
+    slots[epn.slot->id] = epn.slot;
+
+    if (recent.size() >= BLOCK_SIZE)
+    {
+        freeze();
+    }
+
+    return true;
+}
+
+/**
+ * @param epn EPN to look for.
+ *
+ * @return 1 if the EPN is in the store, 0 otherwise.
+ */
+size_t EPNStore::count(const EPN& epn) const
+{
+    if (recent.count(epn))
+    {
+        return 1;
+    }
+
+    for (auto& block : blocks)
+    {
+        size_t index = lower_bound(block, epn.slot->id, epn.left_extent, epn.right_extent, epn.pivot);
+
+        if (index < block.size && block_key(get(block, index)) == block_key(epn))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finds the pivots of the EPNs with the given slot and extents, by a
+ * binary search in each block.
+ *
+ * @param slot Slot of the EPNs.
+ * @param left_extent Left extent of the EPNs.
+ * @param right_extent Right extent of the EPNs.
+ *
+ * @return The pivots, sorted.
+ */
+std::vector<unsigned int> EPNStore::get_pivots(const GrammarSlot* slot, unsigned int left_extent, unsigned int right_extent) const
+{
+    std::vector<unsigned int> pivots;
+
+    for (auto& block : blocks)
+    {
+        for (size_t index = lower_bound(block, slot->id, left_extent, right_extent, 0); index < block.size; index++)
+        {
+            if (block.slots.get(index) != slot->id
+                || block.left_extents.get(index) != left_extent
+                || block.right_extents.get(index) != right_extent)
+            {
+                break;
+            }
+
+            pivots.push_back(block.pivots.get(index));
+        }
+    }
+
+    for (unsigned int pivot = left_extent; pivot <= right_extent && !recent.empty(); pivot++)
+    {
+        if (recent.count(EPN(slot, left_extent, pivot, right_extent)))
+        {
+            pivots.push_back(pivot);
+        }
+    }
+
+    std::sort(pivots.begin(), pivots.end());
+
+    return pivots;
+}
+
+/**
+ * @brief Freezes the collected EPNs into a block. While the last block is at
+ * most twice as large as the new one, the two are merged, so the sizes of the
+ * blocks at least double from the last block to the first.
+ */
+void EPNStore::freeze()
+{
+    if (recent.empty())
+    {
+        return;
+    }
+
+    std::vector<EPN> epns(recent.begin(), recent.end());
+    recent.clear();
+
+    std::sort(epns.begin(), epns.end(), [](const EPN& a, const EPN& b) {
+        return block_key(a) < block_key(b);
+    });
+
+    EPNBlock block = make_block(epns);
+    std::vector<EPN>().swap(epns);
+
+    while (!blocks.empty() && blocks.back().size <= 2 * block.size)
+    {
+        block = merge_blocks(blocks.back(), block);
+        num_frozen -= blocks.back().size;
+        frozen_bytes -= blocks.back().memory_usage();
+        blocks.pop_back();
+    }
+
+    num_frozen += block.size;
+    frozen_bytes += block.memory_usage();
+    blocks.push_back(std::move(block));
+}
+
+/**
+ * @param epns EPNs of the block, sorted.
+ *
+ * @return Block with the given EPNs.
+ */
+EPNBlock EPNStore::make_block(const std::vector<EPN>& epns) const
+{
+    EPNBlock block;
+    std::vector<unsigned int> values(epns.size());
+
+    block.size = epns.size();
+
+    std::transform(epns.begin(), epns.end(), values.begin(), [](const EPN& e) { return e.slot->id; });
+    block.slots.assign(values);
+    std::transform(epns.begin(), epns.end(), values.begin(), [](const EPN& e) { return e.left_extent; });
+    block.left_extents.assign(values);
+    std::transform(epns.begin(), epns.end(), values.begin(), [](const EPN& e) { return e.right_extent; });
+    block.right_extents.assign(values);
+    std::transform(epns.begin(), epns.end(), values.begin(), [](const EPN& e) { return e.pivot; });
+    block.pivots.assign(values);
+
+    return block;
+}
+
+/**
+ * @brief Merges two blocks one column at a time, so that at most one column
+ * is unpacked at once.
+ *
+ * @param first First block.
+ * @param second Second block, without EPNs in common with the first.
+ *
+ * @return Block with the EPNs of both blocks.
+ */
+EPNBlock EPNStore::merge_blocks(const EPNBlock& first, const EPNBlock& second) const
+{
+    static PackedColumn EPNBlock::* const columns[] = {
+        &EPNBlock::slots, &EPNBlock::left_extents, &EPNBlock::right_extents, &EPNBlock::pivots
+    };
+
+    EPNBlock block;
+    std::vector<bool> from_second;
+    size_t i = 0;
+    size_t j = 0;
+
+    block.size = first.size + second.size;
+    from_second.reserve(block.size);
+
+    while (i < first.size || j < second.size)
+    {
+        bool take_second = i == first.size
+            || (j < second.size && block_key(get(second, j)) < block_key(get(first, i)));
+
+        from_second.push_back(take_second);
+        take_second ? j++ : i++;
+    }
+
+    for (auto column : columns)
+    {
+        std::vector<unsigned int> values(block.size);
+
+        i = 0;
+        j = 0;
+
+        for (size_t index = 0; index < block.size; index++)
+        {
+            values[index] = from_second[index] ? (second.*column).get(j++) : (first.*column).get(i++);
+        }
+
+        (block.*column).assign(values);
+    }
+
+    return block;
+}
+
+/**
+ * @brief Removes all EPNs.
+ */
+void EPNStore::clear()
+{
+    blocks.clear();
+    recent.clear();
+    num_frozen = 0;
+    frozen_bytes = 0;
+}
+
+/**
+ * @param block Block of the EPN.
+ * @param index Index of the EPN in the block.
+ *
+ * @return The EPN.
+ */
+EPN EPNStore::get(const EPNBlock& block, size_t index) const
+{
+    return EPN(
+        slots[block.slots.get(index)],
+        block.left_extents.get(index),
+        block.pivots.get(index),
+        block.right_extents.get(index)
+    );
+}
+
+/**
+ * @return Index of the first EPN in the block that is not smaller than the
+ *         given slot id and extents.
+ */
+size_t EPNStore::lower_bound(const EPNBlock& block, unsigned int slot, unsigned int left, unsigned int right, unsigned int pivot) const
+{
+    auto key = std::make_tuple(slot, left, right, pivot);
+    size_t first = 0;
+    size_t count = block.size;
+
+    while (count > 0)
+    {
+        size_t step = count / 2;
+        size_t middle = first + step;
+        auto middle_key = std::make_tuple(
+            block.slots.get(middle),
+            block.left_extents.get(middle),
+            block.right_extents.get(middle),
+            block.pivots.get(middle)
+        );
+
+        if (middle_key < key)
+        {
+            first = middle + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    return first;
+}
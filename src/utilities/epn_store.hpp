@@ -0,0 +1,171 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Set of EPNs in a structure-of-arrays layout. New EPNs are collected in a
+ *   small hash set. When it is full, its EPNs are sorted by slot, left extent,
+ *   right extent and pivot, and frozen into a block that stores each of the
+ *   four fields in its own bit-packed column, at the width of the largest
+ *   difference with the smallest value in the block. Blocks of similar size
+ *   are merged, so there are only logarithmically many, and lookups are
+ *   binary searches in each block. A frozen EPN takes a few bytes instead of
+ *   the tens of bytes it takes in a hash set.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "../components/epn.hpp"
+#include "hash_custom.hpp"
+#include "flat_set.hpp"
+
+/**
+ * Column of unsigned integers, each stored in the same number of bits as the
+ * difference with the smallest value of the column.
+ */
+class PackedColumn
+{
+private:
+    std::vector<uint64_t> words;
+    unsigned int base = 0;
+    unsigned int width = 0;
+public:
+    void assign(const std::vector<unsigned int>& values);
+
+    /**
+     * @param index Index of a value.
+     *
+     * @return The value at the index.
+     */
+    unsigned int get(size_t index) const
+    {
+        if (width == 0)
+        {
+            return base;
+        }
+
+        size_t bit = index * width;
+        size_t word = bit / 64;
+        unsigned int offset = static_cast<unsigned int>(bit % 64);
+        uint64_t value = words[word] >> offset;
+
+        if (offset + width > 64)
+        {
+            value |= words[word + 1] << (64 - offset);
+        }
+
+        return base + static_cast<unsigned int>(value & ((uint64_t(1) << width) - 1));
+    }
+
+    size_t memory_usage() const { return words.capacity() * sizeof(uint64_t); }
+};
+
+/**
+ * Frozen, sorted EPNs, one column per field.
+ */
+struct EPNBlock
+{
+    PackedColumn slots;
+    PackedColumn left_extents;
+    PackedColumn right_extents;
+    PackedColumn pivots;
+    size_t size = 0;
+
+    size_t memory_usage() const
+    {
+        return slots.memory_usage() + left_extents.memory_usage()
+             + right_extents.memory_usage() + pivots.memory_usage();
+    }
+};
+
+/**
+ * Set of EPNs with the interface of the EPN hash set that the parsers use.
+ */
+class EPNStore
+{
+private:
+    /* Number of EPNs collected before they are frozen into a block. */
+    static constexpr size_t BLOCK_SIZE = 1 << 14;
+public:
+    /**
+     * Forward iterator over the EPNs, first those of the blocks and then those
+     * of the hash set. Holds the current EPN, since frozen EPNs are decoded.
+     */
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = EPN;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const EPN*;
+        using reference = const EPN&;
+    private:
+        const EPNStore* store = nullptr;
+        size_t block = 0;
+        size_t index = 0;
+        FlatSet<EPN, hash_custom::hash<EPN>>::iterator recent;
+        EPN current;
+    public:
+        iterator() = default;
+        iterator(const EPNStore* s, bool at_end);
+        reference operator*() const { return current; }
+        pointer operator->() const { return &current; }
+        iterator& operator++();
+        iterator operator++(int) { iterator copy = *this; ++*this; return copy; }
+        bool operator==(const iterator& other) const;
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+    };
+    using const_iterator = iterator;
+    using value_type = EPN;
+private:
+    std::vector<EPNBlock> blocks;
+    /* EPNs that are not frozen yet. */
+    FlatSet<EPN, hash_custom::hash<EPN>> recent;
+    /* Slots of the EPNs, indexed by slot id. */
+    std::vector<const GrammarSlot*> slots;
+    /* Number of EPNs in the blocks. */
+    size_t num_frozen = 0;
+    /* Number of bytes allocated for the blocks. */
+    size_t frozen_bytes = 0;
+public:
+    bool insert(const EPN& epn);
+
+    /**
+     * @brief Inserts a range of EPNs.
+     *
+     * @param first Beginning of the range.
+     * @param last End of the range.
+     *
+     * @return Number of EPNs that were not in the store yet.
+     */
+    template <typename ForwardIt>
+    size_t insert(ForwardIt first, ForwardIt last)
+    {
+        size_t inserted = 0;
+
+        for (; first != last; ++first)
+        {
+            inserted += insert(*first);
+        }
+
+        return inserted;
+    }
+
+    size_t count(const EPN& epn) const;
+    std::vector<unsigned int> get_pivots(const GrammarSlot* slot, unsigned int left_extent, unsigned int right_extent) const;
+    void freeze();
+    void clear();
+    void reserve(size_t count) { recent.reserve(std::min(count, BLOCK_SIZE)); }
+    size_t size() const { return num_frozen + recent.size(); }
+    bool empty() const { return size() == 0; }
+    size_t memory_usage() const { return frozen_bytes + recent.memory_usage(); }
+    iterator begin() const { return iterator(this, false); }
+    iterator end() const { return iterator(this, true); }
+private:
+    EPN get(const EPNBlock& block, size_t index) const;
+    size_t lower_bound(const EPNBlock& block, unsigned int slot, unsigned int left, unsigned int right, unsigned int pivot) const;
+    EPNBlock make_block(const std::vector<EPN>& epns) const;
+    EPNBlock merge_blocks(const EPNBlock& first, const EPNBlock& second) const;
+};
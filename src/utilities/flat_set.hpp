@@ -0,0 +1,551 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Flat open-addressing hash set in the style of a Swiss table. Elements are
+ *   stored inline in one array, next to an array of control bytes. A control
+ *   byte is empty, deleted, or holds 7 bits of the hash of a full slot. The
+ *   table is probed 16 control bytes at a time, which are compared in one
+ *   SSE2 instruction when available. Intended for small, trivially copyable
+ *   elements such as descriptors and EPNs.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Hash set with the interface of std::unordered_set that the parsers use.
+ * Inserting may invalidate iterators, erasing does not.
+ */
+template <typename T, typename Hash = std::hash<T>, typename Equal = std::equal_to<T>>
+class FlatSet
+{
+private:
+    /* Number of slots that are probed at once. */
+    static constexpr size_t GROUP_SIZE = 16;
+    /* Control bytes of empty and deleted slots. Full slots have a non-negative control byte. */
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+    /* Number of elements inserted at once by the bulk insert, after computing their hashes. */
+    static constexpr size_t BATCH_SIZE = 16;
+public:
+    /**
+     * Forward iterator over the elements of the set.
+     */
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+    private:
+        const FlatSet* set = nullptr;
+        size_t index = 0;
+    public:
+        iterator() = default;
+        iterator(const FlatSet* s, size_t i) : set(s), index(i) {}
+        reference operator*() const { return set->slots[index]; }
+        pointer operator->() const { return &set->slots[index]; }
+        iterator& operator++() { index = set->next_full(index + 1); return *this; }
+        iterator operator++(int) { iterator copy = *this; ++*this; return copy; }
+        bool operator==(const iterator& other) const { return index == other.index; }
+        bool operator!=(const iterator& other) const { return index != other.index; }
+    };
+    using const_iterator = iterator;
+    using value_type = T;
+private:
+    std::vector<int8_t> control;
+    std::vector<T> slots;
+    size_t num_elements = 0;
+    size_t num_deleted = 0;
+    /* Number of elements erased since the last rehash. */
+    size_t num_erased = 0;
+    /* No slot before this index is full. Relaxed atomic, because begin() may
+       be called by multiple readers at once. */
+    mutable std::atomic<size_t> first_full{0};
+public:
+    FlatSet() = default;
+
+    FlatSet(const FlatSet& other)
+        : control(other.control), slots(other.slots), num_elements(other.num_elements),
+          num_deleted(other.num_deleted), num_erased(other.num_erased), first_full(other.first_full.load(std::memory_order_relaxed)) {}
+
+    FlatSet(FlatSet&& other) noexcept
+        : control(std::move(other.control)), slots(std::move(other.slots)), num_elements(other.num_elements),
+          num_deleted(other.num_deleted), num_erased(other.num_erased), first_full(other.first_full.load(std::memory_order_relaxed))
+    {
+        other.control.clear();
+        other.slots.clear();
+        other.num_elements = 0;
+        other.num_deleted = 0;
+        other.num_erased = 0;
+        other.first_full.store(0, std::memory_order_relaxed);
+    }
+
+    FlatSet& operator=(const FlatSet& other)
+    {
+        if (this != &other)
+        {
+            control = other.control;
+            slots = other.slots;
+            num_elements = other.num_elements;
+            num_deleted = other.num_deleted;
+            num_erased = other.num_erased;
+            first_full.store(other.first_full.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        return *this;
+    }
+
+    FlatSet& operator=(FlatSet&& other) noexcept
+    {
+        if (this != &other)
+        {
+            control = std::move(other.control);
+            slots = std::move(other.slots);
+            num_elements = other.num_elements;
+            num_deleted = other.num_deleted;
+            num_erased = other.num_erased;
+            first_full.store(other.first_full.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other.control.clear();
+            other.slots.clear();
+            other.num_elements = 0;
+            other.num_deleted = 0;
+            other.num_erased = 0;
+            other.first_full.store(0, std::memory_order_relaxed);
+        }
+
+        return *this;
+    }
+public:
+    size_t size() const { return num_elements; }
+    bool empty() const { return num_elements == 0; }
+    size_t capacity() const { return control.size(); }
+
+    /**
+     * @return Number of bytes allocated for the elements of the set.
+     */
+    size_t memory_usage() const
+    {
+        return control.capacity() * sizeof(int8_t) + slots.capacity() * sizeof(T);
+    }
+
+    /**
+     * @return Iterator to the first element. Starts looking at the first slot
+     * that can be full, so taking elements from the front of a set that is
+     * used as a worklist does not rescan the slots that were emptied.
+     */
+    iterator begin() const
+    {
+        size_t index = next_full(first_full.load(std::memory_order_relaxed));
+
+        first_full.store(index, std::memory_order_relaxed);
+
+        return iterator(this, index);
+    }
+
+    iterator end() const
+    {
+        return iterator(this, capacity());
+    }
+
+    /**
+     * @brief Removes all elements. Keeps the capacity.
+     */
+    void clear()
+    {
+        std::fill(control.begin(), control.end(), EMPTY);
+        num_elements = 0;
+        num_deleted = 0;
+        num_erased = 0;
+        first_full.store(capacity(), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Makes room for a number of elements without rehashing.
+     *
+     * @param count Number of elements.
+     */
+    void reserve(size_t count)
+    {
+        if (count > max_load(capacity()) - num_deleted)
+        {
+            rehash(capacity_for(std::max(count, num_elements)));
+        }
+    }
+
+    /**
+     * @param value Value to look for.
+     *
+     * @return Iterator to the element equal to the value, or end().
+     */
+    iterator find(const T& value) const
+    {
+        return iterator(this, find_index(value, mix(Hash()(value))));
+    }
+
+    /**
+     * @param value Value to look for.
+     *
+     * @return 1 if the set contains the value, 0 otherwise.
+     */
+    size_t count(const T& value) const
+    {
+        return find_index(value, mix(Hash()(value))) != capacity();
+    }
+
+    /**
+     * @brief Inserts a value if the set does not contain it yet.
+     *
+     * @param value Value to insert.
+     *
+     * @return Iterator to the element equal to the value, and whether it was inserted.
+     */
+    std::pair<iterator, bool> insert(const T& value)
+    {
+        return insert_hashed(value, mix(Hash()(value)));
+    }
+
+    /**
+     * @brief Bulk insert. Reserves room for all values, then inserts them in
+     * batches: the hashes of a batch are computed and the groups they probe
+     * first are prefetched, before the values are inserted one by one.
+     *
+     * @param first Forward iterator to the first value.
+     * @param last Forward iterator past the last value.
+     *
+     * @return Number of values that were inserted.
+     */
+    template <typename ForwardIt>
+    size_t insert(ForwardIt first, ForwardIt last)
+    {
+        size_t hashes[BATCH_SIZE];
+        size_t inserted = 0;
+
+        reserve(num_elements + static_cast<size_t>(std::distance(first, last)));
+
+        while (first != last)
+        {
+            ForwardIt batch_start = first;
+            size_t batch = 0;
+
+            for (; first != last && batch < BATCH_SIZE; ++first, batch++)
+            {
+                hashes[batch] = mix(Hash()(*first));
+                prefetch(hashes[batch]);
+            }
+
+            for (size_t i = 0; i < batch; i++, ++batch_start)
+            {
+                inserted += insert_hashed(*batch_start, hashes[i]).second;
+            }
+        }
+
+        return inserted;
+    }
+
+    /**
+     * @brief Removes the element equal to a value.
+     *
+     * @param value Value to remove.
+     *
+     * @return Number of elements removed.
+     */
+    size_t erase(const T& value)
+    {
+        size_t index = find_index(value, mix(Hash()(value)));
+
+        if (index == capacity())
+        {
+            return 0;
+        }
+
+        /* A slot can only become empty again if its group has an empty slot,
+           because probing only continues past groups without empty slots. */
+        if (match_byte(&control[index - index % GROUP_SIZE], EMPTY))
+        {
+            control[index] = EMPTY;
+        }
+        else
+        {
+            control[index] = DELETED;
+            num_deleted++;
+        }
+
+        num_elements--;
+        num_erased++;
+
+        return 1;
+    }
+private:
+    /**
+     * @brief Mixes the bits of a hash, so that hashes that only differ in
+     * their low bits still select different groups and control bytes.
+     */
+    static size_t mix(size_t hash)
+    {
+        uint64_t x = static_cast<uint64_t>(hash);
+
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+
+        return static_cast<size_t>(x);
+    }
+
+    static int8_t control_byte(size_t hash)
+    {
+        return static_cast<int8_t>(hash & 0x7f);
+    }
+
+    /**
+     * @return Bit mask of the control bytes of a group that are equal to a value.
+     */
+    static uint32_t match_byte(const int8_t* group, int8_t value)
+    {
+#ifdef __SSE2__
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+
+        for (size_t i = 0; i < GROUP_SIZE; i++)
+        {
+            mask |= static_cast<uint32_t>(group[i] == value) << i;
+        }
+
+        return mask;
+#endif
+    }
+
+    /**
+     * @return Bit mask of the slots of a group that are empty or deleted.
+     */
+    static uint32_t match_free(const int8_t* group)
+    {
+#ifdef __SSE2__
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+
+        return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+        uint32_t mask = 0;
+
+        for (size_t i = 0; i < GROUP_SIZE; i++)
+        {
+            mask |= static_cast<uint32_t>(group[i] < 0) << i;
+        }
+
+        return mask;
+#endif
+    }
+
+    static unsigned int lowest_bit(uint32_t mask)
+    {
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+    }
+
+    static size_t max_load(size_t capacity)
+    {
+        return capacity - capacity / 8;
+    }
+
+    /**
+     * @return Smallest capacity, a power of two and at least one group, that
+     * holds a number of elements at half load.
+     */
+    static size_t capacity_for(size_t count)
+    {
+        size_t capacity = GROUP_SIZE;
+
+        while (capacity < 2 * count)
+        {
+            capacity *= 2;
+        }
+
+        return capacity;
+    }
+
+    /**
+     * @return Index of the first full slot at or after an index, or capacity().
+     */
+    size_t next_full(size_t index) const
+    {
+        while (index < capacity())
+        {
+            size_t group = index - index % GROUP_SIZE;
+            uint32_t full = ~match_free(&control[group]) & 0xffff;
+
+            full &= ~((1u << (index - group)) - 1);
+
+            if (full)
+            {
+                return group + lowest_bit(full);
+            }
+
+            index = group + GROUP_SIZE;
+        }
+
+        return capacity();
+    }
+
+    void prefetch(size_t hash) const
+    {
+        if (capacity())
+        {
+            size_t group = (hash >> 7) & (capacity() / GROUP_SIZE - 1);
+
+            __builtin_prefetch(&control[group * GROUP_SIZE]);
+            __builtin_prefetch(&slots[group * GROUP_SIZE]);
+        }
+    }
+
+    /**
+     * @brief Probes the groups for a value. Groups are visited in triangular
+     * order, which visits every group once when the number of groups is a
+     * power of two. Probing stops at the first group with an empty slot.
+     *
+     * @return Index of the element equal to the value, or capacity().
+     */
+    size_t find_index(const T& value, size_t hash) const
+    {
+        if (num_elements == 0)
+        {
+            return capacity();
+        }
+
+        size_t group_mask = capacity() / GROUP_SIZE - 1;
+        size_t group = (hash >> 7) & group_mask;
+        int8_t byte = control_byte(hash);
+
+        for (size_t step = 1; step <= group_mask + 1; step++)
+        {
+            const int8_t* group_control = &control[group * GROUP_SIZE];
+
+            for (uint32_t match = match_byte(group_control, byte); match; match &= match - 1)
+            {
+                size_t index = group * GROUP_SIZE + lowest_bit(match);
+
+                if (Equal()(slots[index], value))
+                {
+                    return index;
+                }
+            }
+
+            if (match_byte(group_control, EMPTY))
+            {
+                break;
+            }
+
+            group = (group + step) & group_mask;
+        }
+
+        return capacity();
+    }
+
+    /**
+     * @return Index of the first empty or deleted slot in the probe sequence of a hash.
+     */
+    size_t find_free(size_t hash) const
+    {
+        size_t group_mask = capacity() / GROUP_SIZE - 1;
+        size_t group = (hash >> 7) & group_mask;
+
+        for (size_t step = 1; ; step++)
+        {
+            uint32_t free = match_free(&control[group * GROUP_SIZE]);
+
+            if (free)
+            {
+                return group * GROUP_SIZE + lowest_bit(free);
+            }
+
+            group = (group + step) & group_mask;
+        }
+    }
+
+    std::pair<iterator, bool> insert_hashed(const T& value, size_t hash)
+    {
+        size_t index = find_index(value, hash);
+
+        if (index != capacity())
+        {
+            return std::make_pair(iterator(this, index), false);
+        }
+
+        /* Grow when full, or shrink when most elements have been erased again,
+           so that iterating and taking elements from the front stay cheap. */
+        if (num_elements + num_deleted + 1 > max_load(capacity())
+            || (capacity() > 4 * GROUP_SIZE && 8 * num_elements < capacity() && num_erased > num_elements))
+        {
+            rehash(capacity_for(num_elements + 1));
+        }
+
+        index = find_free(hash);
+
+        if (control[index] == DELETED)
+        {
+            num_deleted--;
+        }
+
+        control[index] = control_byte(hash);
+        slots[index] = value;
+        num_elements++;
+
+        if (index < first_full.load(std::memory_order_relaxed))
+        {
+            first_full.store(index, std::memory_order_relaxed);
+        }
+
+        return std::make_pair(iterator(this, index), true);
+    }
+
+    /**
+     * @brief Moves all elements into a table with a new capacity, which drops
+     * the deleted slots.
+     *
+     * @param new_capacity New capacity, a power of two and at least one group.
+     */
+    void rehash(size_t new_capacity)
+    {
+        std::vector<int8_t> old_control(new_capacity, EMPTY);
+        std::vector<T> old_slots(new_capacity);
+
+        old_control.swap(control);
+        old_slots.swap(slots);
+        num_deleted = 0;
+        num_erased = 0;
+        first_full.store(capacity(), std::memory_order_relaxed);
+
+        for (size_t i = 0; i < old_control.size(); i++)
+        {
+            if (old_control[i] >= 0)
+            {
+                size_t hash = mix(Hash()(old_slots[i]));
+                size_t index = find_free(hash);
+
+                control[index] = control_byte(hash);
+                slots[index] = old_slots[i];
+
+                if (index < first_full.load(std::memory_order_relaxed))
+                {
+                    first_full.store(index, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+};
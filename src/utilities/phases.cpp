@@ -0,0 +1,157 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the phase timer.
+ */
+
+#include <sstream>
+#include <sys/resource.h>
+#include "phases.hpp"
+
+/**
+ * @brief Starts timing a phase. A phase that is still running is stopped
+ * first.
+ *
+ * @param name Name of the phase.
+ */
+void PhaseTimer::start(std::string name)
+{
+    if (!current.empty())
+    {
+        stop();
+    }
+
+    current = name;
+    timer.start();
+}
+
+/**
+ * @brief Stops timing the running phase and records its duration.
+ */
+void PhaseTimer::stop()
+{
+    if (current.empty())
+    {
+        return;
+    }
+
+    timer.stop();
+    add(current, timer.elapsedMilliseconds());
+    current.clear();
+}
+
+/**
+ * @brief Records the duration of a phase. A phase that was recorded before
+ * gets the duration added to it.
+ *
+ * @param name Name of the phase.
+ * @param milliseconds Duration of the phase.
+ */
+void PhaseTimer::add(std::string name, double milliseconds)
+{
+    for (auto& phase : phases)
+    {
+        if (phase.first == name)
+        {
+            phase.second += milliseconds;
+            return;
+        }
+    }
+
+    phases.emplace_back(name, milliseconds);
+}
+
+/**
+ * @brief Records all phases of another phase timer.
+ *
+ * @param other Phase timer to take the phases from.
+ */
+void PhaseTimer::append(const PhaseTimer& other)
+{
+    for (auto& phase : other.phases)
+    {
+        add(phase.first, phase.second);
+    }
+}
+
+/**
+ * @return Sum of the durations of all recorded phases, in milliseconds.
+ */
+double PhaseTimer::total() const
+{
+    double result = 0;
+
+    for (auto& phase : phases)
+    {
+        result += phase.second;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Writes the phases as a single-line JSON object, together with the
+ * CPU time of the parse threads and the parallel efficiency. The parallelism
+ * is the CPU time of all threads divided by the wall time of the parse phase,
+ * and the efficiency is the parallelism divided by the number of threads.
+ *
+ * @param statistics Statistics of the parse.
+ *
+ * @return The phases as JSON.
+ */
+std::string PhaseTimer::to_json(const Statistics& statistics) const
+{
+    std::stringstream ss;
+    double parse_ms = 0;
+    double cpu_ms = static_cast<double>(statistics.total().cpu_time) / 1e6;
+    double parallelism = 0;
+    double efficiency = 0;
+
+    ss << "{\"phases_ms\": {";
+
+    for (size_t i = 0; i < phases.size(); i++)
+    {
+        ss << (i ? ", " : "") << "\"" << phases[i].first << "\": " << phases[i].second;
+
+        if (phases[i].first == "parse")
+        {
+            parse_ms = phases[i].second;
+        }
+    }
+
+    if (parse_ms > 0)
+    {
+        parallelism = cpu_ms / parse_ms;
+    }
+
+    if (!statistics.threads.empty())
+    {
+        efficiency = parallelism / static_cast<double>(statistics.threads.size());
+    }
+
+    ss << "}, \"wall_ms\": " << total()
+       << ", \"cpu_ms\": " << cpu_ms
+       << ", \"threads\": " << statistics.threads.size()
+       << ", \"parallelism\": " << parallelism
+       << ", \"efficiency\": " << efficiency
+       << ", \"peak_rss_kb\": " << peak_rss_kb()
+       << "}";
+
+    return ss.str();
+}
+
+/**
+ * @return Peak resident set size of the process, in kilobytes.
+ */
+long peak_rss_kb()
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    return usage.ru_maxrss;
+}
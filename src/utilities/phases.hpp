@@ -0,0 +1,39 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Declares the phase timer, which measures the wall time of each phase of a
+ *   run, such as loading, parsing and output, on the monotonic clock.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "timer.hpp"
+#include "statistics.hpp"
+
+/**
+ * Wall time of the phases of a run, in the order they were recorded.
+ */
+class PhaseTimer
+{
+public:
+    /* Name and duration in milliseconds of each recorded phase. */
+    std::vector<std::pair<std::string, double>> phases;
+private:
+    /* Name of the running phase. */
+    std::string current;
+    /* Timer of the running phase. */
+    Timer timer;
+public:
+    void start(std::string name);
+    void stop();
+    void add(std::string name, double milliseconds);
+    void append(const PhaseTimer& other);
+    double total() const;
+    std::string to_json(const Statistics& statistics) const;
+};
+
+long peak_rss_kb();
@@ -0,0 +1,347 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the thread-local pools of the pooled allocator.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "pool_allocator.hpp"
+#include "statistics.hpp"
+
+namespace
+{
+    /* Size of the smallest size class, and the number of size classes. Each
+       size class holds blocks of twice the size of the previous one. */
+    constexpr size_t MIN_BLOCK_SIZE = 16;
+    constexpr size_t NUM_SIZE_CLASSES = 9;
+    /* Bytes at the start of a chunk taken by its header. */
+    constexpr size_t HEADER_SIZE = CACHE_LINE_SIZE;
+
+    static_assert(MIN_BLOCK_SIZE << (NUM_SIZE_CLASSES - 1) == POOL_MAX_BLOCK_SIZE, "Size classes must end at POOL_MAX_BLOCK_SIZE");
+    static_assert((POOL_CHUNK_SIZE & (POOL_CHUNK_SIZE - 1)) == 0, "POOL_CHUNK_SIZE must be a power of two");
+
+    /**
+     * Free block, linked to the next free block.
+     */
+    struct Block
+    {
+        Block* next;
+    };
+
+    class Pool;
+
+    /**
+     * Header at the start of every chunk.
+     */
+    struct ChunkHeader
+    {
+        Pool* owner;
+        size_t size_class;
+    };
+
+    /**
+     * @return Size class of the blocks that hold a number of bytes.
+     */
+    size_t size_class_of(size_t bytes)
+    {
+        if (bytes <= MIN_BLOCK_SIZE)
+        {
+            return 0;
+        }
+
+        return static_cast<size_t>(64 - __builtin_clzll(bytes - 1)) - 4;
+    }
+
+    /**
+     * @return Header of the chunk that a block lies in.
+     */
+    ChunkHeader* chunk_of(const void* block)
+    {
+        return reinterpret_cast<ChunkHeader*>(reinterpret_cast<uintptr_t>(block) & ~static_cast<uintptr_t>(POOL_CHUNK_SIZE - 1));
+    }
+
+    /**
+     * Pool of a thread. Only its owner thread allocates from it and frees to
+     * its free lists. Other threads hand blocks back through remote_frees.
+     */
+    class Pool
+    {
+    private:
+        /**
+         * Blocks freed by this thread for the pool of another thread.
+         */
+        struct RemoteBatch
+        {
+            Pool* owner;
+            Block* head;
+            Block* tail;
+            size_t size;
+        };
+
+        Block* free_lists[NUM_SIZE_CLASSES] = {};
+        /* Part of the last chunk of each size class that was never used. */
+        char* unused[NUM_SIZE_CLASSES] = {};
+        char* unused_end[NUM_SIZE_CLASSES] = {};
+        std::vector<RemoteBatch> remote_batches;
+        /* Blocks handed back by other threads, linked through their next. */
+        alignas(CACHE_LINE_SIZE) std::atomic<Block*> remote_frees{nullptr};
+    public:
+        AllocationCounters counters;
+    public:
+        void* allocate(size_t size_class);
+        void free(void* pointer);
+        void flush_remote_batches();
+    private:
+        void add_chunk(size_t size_class);
+        void collect_remote_frees();
+        void flush(RemoteBatch& batch);
+    };
+
+    /**
+     * @brief Takes a block from the free list of a size class. If the list is
+     * empty, takes back the blocks handed back by other threads, and if there
+     * are none, carves a block from the last chunk of the size class.
+     *
+     * @param size_class Size class of the block.
+     *
+     * @return The block.
+     */
+    void* Pool::allocate(size_t size_class)
+    {
+        counters.num_allocations++;
+
+        if (!free_lists[size_class] && remote_frees.load(std::memory_order_relaxed))
+        {
+            collect_remote_frees();
+        }
+
+        if (Block* block = free_lists[size_class])
+        {
+            free_lists[size_class] = block->next;
+            return block;
+        }
+
+        if (unused[size_class] == unused_end[size_class])
+        {
+            add_chunk(size_class);
+        }
+
+        void* block = unused[size_class];
+        unused[size_class] += MIN_BLOCK_SIZE << size_class;
+
+        return block;
+    }
+
+    /**
+     * @brief Frees a block. A block of this pool goes back to its free list,
+     * a block of another pool into the batch for that pool.
+     *
+     * @param pointer Block to free.
+     */
+    void Pool::free(void* pointer)
+    {
+        ChunkHeader* chunk = chunk_of(pointer);
+        Block* block = static_cast<Block*>(pointer);
+
+        if (chunk->owner == this)
+        {
+            block->next = free_lists[chunk->size_class];
+            free_lists[chunk->size_class] = block;
+            return;
+        }
+
+        counters.num_remote_frees++;
+
+        auto batch = remote_batches.begin();
+
+        while (batch != remote_batches.end() && batch->owner != chunk->owner)
+        {
+            ++batch;
+        }
+
+        if (batch == remote_batches.end())
+        {
+            remote_batches.push_back({ chunk->owner, nullptr, nullptr, 0 });
+            batch = remote_batches.end() - 1;
+        }
+
+        block->next = batch->head;
+        batch->head = block;
+        batch->tail = batch->tail ? batch->tail : block;
+
+        if (++batch->size == POOL_REMOTE_BATCH_SIZE)
+        {
+            flush(*batch);
+        }
+    }
+
+    /**
+     * @brief Hands all batches of blocks of other pools back to their owners.
+     */
+    void Pool::flush_remote_batches()
+    {
+        for (auto& batch : remote_batches)
+        {
+            flush(batch);
+        }
+    }
+
+    /**
+     * @brief Takes a chunk from the system allocator for a size class.
+     *
+     * @param size_class Size class of the blocks of the chunk.
+     */
+    void Pool::add_chunk(size_t size_class)
+    {
+        char* chunk = static_cast<char*>(::operator new(POOL_CHUNK_SIZE, std::align_val_t(POOL_CHUNK_SIZE)));
+        size_t block_size = MIN_BLOCK_SIZE << size_class;
+
+        new (chunk) ChunkHeader{ this, size_class };
+
+        unused[size_class] = chunk + HEADER_SIZE;
+        unused_end[size_class] = unused[size_class] + (POOL_CHUNK_SIZE - HEADER_SIZE) / block_size * block_size;
+        counters.num_system_allocations++;
+    }
+
+    /**
+     * @brief Moves the blocks handed back by other threads to the free lists.
+     */
+    void Pool::collect_remote_frees()
+    {
+        Block* block = remote_frees.exchange(nullptr, std::memory_order_acquire);
+
+        while (block)
+        {
+            Block* next = block->next;
+            size_t size_class = chunk_of(block)->size_class;
+
+            block->next = free_lists[size_class];
+            free_lists[size_class] = block;
+            block = next;
+        }
+    }
+
+    /**
+     * @brief Hands a batch of blocks back to their owner with a single atomic
+     * operation, and empties the batch.
+     *
+     * @param batch Batch to hand back.
+     */
+    void Pool::flush(RemoteBatch& batch)
+    {
+        if (!batch.head)
+        {
+            return;
+        }
+
+        Block* head = batch.owner->remote_frees.load(std::memory_order_relaxed);
+
+        do
+        {
+            batch.tail->next = head;
+        }
+        while (!batch.owner->remote_frees.compare_exchange_weak(head, batch.head, std::memory_order_release, std::memory_order_relaxed));
+
+        batch.head = nullptr;
+        batch.tail = nullptr;
+        batch.size = 0;
+    }
+
+    /* Pools of threads that exited, to be taken over by new threads. */
+    std::mutex released_pools_mutex;
+    std::vector<Pool*> released_pools;
+
+    /**
+     * Pool of the calling thread, which is released when the thread exits.
+     */
+    struct LocalPool
+    {
+        Pool* pool = nullptr;
+
+        ~LocalPool()
+        {
+            if (pool)
+            {
+                pool->flush_remote_batches();
+
+                std::lock_guard<std::mutex> lock(released_pools_mutex);
+                released_pools.push_back(pool);
+            }
+        }
+    };
+
+    thread_local LocalPool local_pool;
+
+    /**
+     * @return Pool of the calling thread. The first call of a thread takes
+     * over a released pool, or creates a new one.
+     */
+    Pool& get_local_pool()
+    {
+        if (!local_pool.pool)
+        {
+            std::lock_guard<std::mutex> lock(released_pools_mutex);
+
+            if (released_pools.empty())
+            {
+                local_pool.pool = new Pool();
+            }
+            else
+            {
+                local_pool.pool = released_pools.back();
+                released_pools.pop_back();
+            }
+        }
+
+        return *local_pool.pool;
+    }
+}
+
+/**
+ * @brief Allocates memory from the pool of the calling thread, or from the
+ * system allocator if it is larger than POOL_MAX_BLOCK_SIZE.
+ *
+ * @param bytes Number of bytes.
+ *
+ * @return The memory.
+ */
+void* pool_allocate(size_t bytes)
+{
+    Pool& pool = get_local_pool();
+
+    if (bytes > POOL_MAX_BLOCK_SIZE)
+    {
+        pool.counters.num_system_allocations++;
+        return ::operator new(bytes);
+    }
+
+    return pool.allocate(size_class_of(bytes));
+}
+
+/**
+ * @brief Frees memory allocated by pool_allocate(), from any thread.
+ *
+ * @param pointer Memory to free.
+ * @param bytes Number of bytes it was allocated with.
+ */
+void pool_deallocate(void* pointer, size_t bytes)
+{
+    if (bytes > POOL_MAX_BLOCK_SIZE)
+    {
+        ::operator delete(pointer);
+        return;
+    }
+
+    get_local_pool().free(pointer);
+}
+
+/**
+ * @return Allocation counters of the pool of the calling thread.
+ */
+AllocationCounters allocation_counters()
+{
+    return get_local_pool().counters;
+}
@@ -0,0 +1,114 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Thread-local pooled allocator for the small containers that the parallel
+ *   parsers create and free for every descriptor: sets of right extents,
+ *   lists of EPNs, batches of descriptors and the nodes of hash maps. Every
+ *   thread allocates from a pool of its own, with a free list per size
+ *   class, so that threads do not contend for the system allocator. Blocks
+ *   are carved from chunks of POOL_CHUNK_SIZE bytes, aligned to their size,
+ *   that hold blocks of a single size class and point to the pool that owns
+ *   them. A block freed by another thread than its owner is collected in a
+ *   batch for the owner, which is handed over with one atomic operation once
+ *   it holds POOL_REMOTE_BATCH_SIZE blocks or the thread exits. The owner
+ *   takes the handed over blocks back when its free list runs empty. Chunks
+ *   are never returned to the system allocator. The pool of a thread that
+ *   exits is kept, with its chunks, for the next thread that starts.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* The parallel parsers allocate their small containers from the thread-local
+   pools instead of the system allocator. The pools keep their chunks until
+   the program exits. */
+// #define OPTIMISATION_POOLED_ALLOCATION
+
+/* Bytes of a chunk of blocks. */
+#define POOL_CHUNK_SIZE 65536
+/* Largest block in bytes. Larger allocations go to the system allocator. */
+#define POOL_MAX_BLOCK_SIZE 4096
+/* Number of blocks freed for another thread that are handed over at once. */
+#define POOL_REMOTE_BATCH_SIZE 64
+
+/**
+ * Allocation counters of the pool of a thread.
+ */
+struct AllocationCounters
+{
+    /* Number of allocations served by the pool. */
+    unsigned long num_allocations = 0;
+    /* Number of chunks and large blocks taken from the system allocator. */
+    unsigned long num_system_allocations = 0;
+    /* Number of blocks freed for the pool of another thread. */
+    unsigned long num_remote_frees = 0;
+};
+
+void* pool_allocate(size_t bytes);
+void pool_deallocate(void* pointer, size_t bytes);
+AllocationCounters allocation_counters();
+
+/**
+ * Allocator for the standard containers that takes memory from the pool of
+ * the calling thread. The memory may be freed by any thread, so all
+ * allocators are equal.
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+public:
+    PoolAllocator() = default;
+    template <typename U> PoolAllocator(const PoolAllocator<U>&) {}
+public:
+    T* allocate(size_t n)
+    {
+        if (alignof(T) > alignof(std::max_align_t))
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        }
+
+        return static_cast<T*>(pool_allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t n)
+    {
+        if (alignof(T) > alignof(std::max_align_t))
+        {
+            ::operator delete(pointer, std::align_val_t(alignof(T)));
+            return;
+        }
+
+        pool_deallocate(pointer, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+#ifdef OPTIMISATION_POOLED_ALLOCATION
+template <typename T> using pooled_allocator_t = PoolAllocator<T>;
+#else
+template <typename T> using pooled_allocator_t = std::allocator<T>;
+#endif
+
+/* Containers of the parallel parsers that use the pools. */
+template <typename T>
+using pooled_vector_t = std::vector<T, pooled_allocator_t<T>>;
+template <typename T, typename Hash = std::hash<T>>
+using pooled_set_t = std::unordered_set<T, Hash, std::equal_to<T>, pooled_allocator_t<T>>;
+template <typename K, typename V, typename Hash = std::hash<K>>
+using pooled_map_t = std::unordered_map<K, V, Hash, std::equal_to<K>, pooled_allocator_t<std::pair<const K, V>>>;
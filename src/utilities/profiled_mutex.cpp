@@ -0,0 +1,432 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the profiled mutexes and the lock profile registry.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include "profiled_mutex.hpp"
+
+namespace
+{
+    std::atomic<bool> profiling_enabled(false);
+    /* Shared acquisitions of the calling thread that are being profiled. */
+    thread_local std::vector<std::pair<const void*, std::chrono::steady_clock::time_point>> shared_holds;
+
+    /**
+     * @return Nanoseconds elapsed since a point in time.
+     */
+    unsigned long nanoseconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start
+        ).count());
+    }
+
+    /**
+     * @return Index of the histogram bucket for a time in nanoseconds.
+     */
+    size_t bucket(unsigned long time)
+    {
+        size_t index = 0;
+
+        while (time >>= 1)
+        {
+            index++;
+        }
+
+        return std::min<size_t>(index, LOCK_HISTOGRAM_BUCKETS - 1);
+    }
+}
+
+/**
+ * @brief Records an acquisition and the time spent waiting for it.
+ *
+ * @param time Wait time in nanoseconds, 0 if the lock was free.
+ */
+void LockProfile::record_wait(unsigned long time)
+{
+    num_acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+    if (time)
+    {
+        num_contended.fetch_add(1, std::memory_order_relaxed);
+        total_wait.fetch_add(time, std::memory_order_relaxed);
+    }
+
+    wait_histogram[bucket(time)].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Records the time a lock was held.
+ *
+ * @param time Hold time in nanoseconds.
+ */
+void LockProfile::record_hold(unsigned long time)
+{
+    total_hold.fetch_add(time, std::memory_order_relaxed);
+    hold_histogram[bucket(time)].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sets all counters to zero.
+ */
+void LockProfile::reset()
+{
+    num_acquisitions = 0;
+    num_contended = 0;
+    total_wait = 0;
+    total_hold = 0;
+
+    for (size_t i = 0; i < LOCK_HISTOGRAM_BUCKETS; i++)
+    {
+        wait_histogram[i] = 0;
+        hold_histogram[i] = 0;
+    }
+}
+
+/**
+ * @brief Enables or disables profiling of all profiled mutexes.
+ */
+void LockProfiler::enable(bool enabled)
+{
+    profiling_enabled.store(enabled);
+}
+
+/**
+ * @return True if profiling is enabled.
+ */
+bool LockProfiler::is_enabled()
+{
+    return profiling_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @param name Name of the lock.
+ *
+ * @return The profile of the locks with the given name. Created if it does
+ * not exist yet.
+ */
+LockProfile& LockProfiler::profile(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+
+    for (auto& profile : profiles)
+    {
+        if (profile.name == name)
+        {
+            return profile;
+        }
+    }
+
+    profiles.emplace_back();
+    profiles.back().name = name;
+
+    return profiles.back();
+}
+
+/**
+ * @brief Sets the counters of all profiles to zero.
+ */
+void LockProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+
+    for (auto& profile : profiles)
+    {
+        profile.reset();
+    }
+}
+
+/**
+ * @brief Creates a report of all locks that were acquired since the last
+ * reset, as CSV sorted by total wait time. The histograms list the counts of
+ * all buckets up to the last non-empty one, separated by '|'.
+ *
+ * @return The report.
+ */
+std::string LockProfiler::report() const
+{
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    std::vector<const LockProfile*> used;
+    std::stringstream ss;
+
+    for (auto& profile : profiles)
+    {
+        if (profile.num_acquisitions.load())
+        {
+            used.push_back(&profile);
+        }
+    }
+
+    std::sort(used.begin(), used.end(), [](const LockProfile* first, const LockProfile* second) {
+        return first->total_wait.load() > second->total_wait.load();
+    });
+
+    auto histogram = [&ss](const std::array<std::atomic<unsigned long>, LOCK_HISTOGRAM_BUCKETS>& buckets) {
+        size_t last = 0;
+
+        for (size_t i = 0; i < LOCK_HISTOGRAM_BUCKETS; i++)
+        {
+            if (buckets[i].load())
+            {
+                last = i;
+            }
+        }
+
+        for (size_t i = 0; i <= last; i++)
+        {
+            ss << (i ? "|" : "") << buckets[i].load();
+        }
+    };
+
+    ss << "lock,acquisitions,contended,wait_ms,hold_ms,wait_histogram,hold_histogram" << std::endl;
+
+    for (auto profile : used)
+    {
+        ss << profile->name
+           << "," << profile->num_acquisitions.load()
+           << "," << profile->num_contended.load()
+           << "," << static_cast<double>(profile->total_wait.load()) / 1e6
+           << "," << static_cast<double>(profile->total_hold.load()) / 1e6
+           << ",";
+        histogram(profile->wait_histogram);
+        ss << ",";
+        histogram(profile->hold_histogram);
+        ss << std::endl;
+    }
+
+    return ss.str();
+}
+
+/**
+ * @brief Creates a mutex with a name.
+ *
+ * @param profiler Profiler to record into.
+ * @param name Name of the lock in the report.
+ */
+ProfiledMutex::ProfiledMutex(LockProfiler& profiler, const std::string& name)
+{
+    set_name(profiler, name);
+}
+
+/**
+ * @brief Sets the profiler and name of the mutex. Must be called before it is
+ * used.
+ *
+ * @param profiler Profiler to record into.
+ * @param name Name of the lock in the report.
+ */
+void ProfiledMutex::set_name(LockProfiler& profiler, const std::string& name)
+{
+    profile = &profiler.profile(name);
+}
+
+/**
+ * @brief Locks the mutex. When profiling, the mutex is first tried without
+ * blocking, so that uncontended acquisitions are recorded without waiting.
+ */
+void ProfiledMutex::lock()
+{
+    if (!profile || !LockProfiler::is_enabled())
+    {
+        mutex.lock();
+        profiling = false;
+        return;
+    }
+
+    unsigned long wait = 0;
+
+    if (!mutex.try_lock())
+    {
+        auto start = std::chrono::steady_clock::now();
+        mutex.lock();
+        wait = std::max(nanoseconds_since(start), 1ul);
+    }
+
+    profile->record_wait(wait);
+    profiling = true;
+    acquired = std::chrono::steady_clock::now();
+}
+
+/**
+ * @return True if the mutex was locked, false if it was already locked.
+ */
+bool ProfiledMutex::try_lock()
+{
+    if (!mutex.try_lock())
+    {
+        return false;
+    }
+
+    profiling = profile && LockProfiler::is_enabled();
+
+    if (profiling)
+    {
+        profile->record_wait(0);
+        acquired = std::chrono::steady_clock::now();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Unlocks the mutex and records how long it was held.
+ */
+void ProfiledMutex::unlock()
+{
+    if (profiling)
+    {
+        profile->record_hold(nanoseconds_since(acquired));
+    }
+
+    mutex.unlock();
+}
+
+/**
+ * @brief Creates a shared mutex with a name.
+ *
+ * @param profiler Profiler to record into.
+ * @param name Name of the lock in the report.
+ */
+ProfiledSharedMutex::ProfiledSharedMutex(LockProfiler& profiler, const std::string& name)
+{
+    set_name(profiler, name);
+}
+
+/**
+ * @brief Sets the profiler and name of the mutex. Must be called before it is
+ * used.
+ *
+ * @param profiler Profiler to record into.
+ * @param name Name of the lock in the report.
+ */
+void ProfiledSharedMutex::set_name(LockProfiler& profiler, const std::string& name)
+{
+    profile = &profiler.profile(name);
+}
+
+/**
+ * @brief Locks the mutex exclusively.
+ */
+void ProfiledSharedMutex::lock()
+{
+    if (!profile || !LockProfiler::is_enabled())
+    {
+        mutex.lock();
+        profiling = false;
+        return;
+    }
+
+    unsigned long wait = 0;
+
+    if (!mutex.try_lock())
+    {
+        auto start = std::chrono::steady_clock::now();
+        mutex.lock();
+        wait = std::max(nanoseconds_since(start), 1ul);
+    }
+
+    profile->record_wait(wait);
+    profiling = true;
+    acquired = std::chrono::steady_clock::now();
+}
+
+/**
+ * @return True if the mutex was locked exclusively, false otherwise.
+ */
+bool ProfiledSharedMutex::try_lock()
+{
+    if (!mutex.try_lock())
+    {
+        return false;
+    }
+
+    profiling = profile && LockProfiler::is_enabled();
+
+    if (profiling)
+    {
+        profile->record_wait(0);
+        acquired = std::chrono::steady_clock::now();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Unlocks the exclusively locked mutex.
+ */
+void ProfiledSharedMutex::unlock()
+{
+    if (profiling)
+    {
+        profile->record_hold(nanoseconds_since(acquired));
+    }
+
+    mutex.unlock();
+}
+
+/**
+ * @brief Locks the mutex for shared ownership. Since several threads can hold
+ * the mutex at once, the start of each hold is kept by the holding thread.
+ */
+void ProfiledSharedMutex::lock_shared()
+{
+    if (!profile || !LockProfiler::is_enabled())
+    {
+        mutex.lock_shared();
+        return;
+    }
+
+    unsigned long wait = 0;
+
+    if (!mutex.try_lock_shared())
+    {
+        auto start = std::chrono::steady_clock::now();
+        mutex.lock_shared();
+        wait = std::max(nanoseconds_since(start), 1ul);
+    }
+
+    profile->record_wait(wait);
+    shared_holds.push_back(std::make_pair(this, std::chrono::steady_clock::now()));
+}
+
+/**
+ * @return True if the mutex was locked for shared ownership, false otherwise.
+ */
+bool ProfiledSharedMutex::try_lock_shared()
+{
+    if (!mutex.try_lock_shared())
+    {
+        return false;
+    }
+
+    if (profile && LockProfiler::is_enabled())
+    {
+        profile->record_wait(0);
+        shared_holds.push_back(std::make_pair(this, std::chrono::steady_clock::now()));
+    }
+
+    return true;
+}
+
+/**
+ * @brief Unlocks the mutex from shared ownership.
+ */
+void ProfiledSharedMutex::unlock_shared()
+{
+    for (auto it = shared_holds.rbegin(); it != shared_holds.rend(); it++)
+    {
+        if (it->first == this)
+        {
+            profile->record_hold(nanoseconds_since(it->second));
+            shared_holds.erase(std::next(it).base());
+            break;
+        }
+    }
+
+    mutex.unlock_shared();
+}
@@ -0,0 +1,106 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Declares mutexes that record how often they are acquired and how long
+ *   threads wait for and hold them. Every mutex records into a profiler,
+ *   normally the one in the statistics of the parser that owns it, so that
+ *   concurrent parses do not mix their counts. Locks with the same name share
+ *   one profile of their profiler. Profiling is enabled at runtime; when it is
+ *   disabled, the mutexes only check a flag before locking.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+/* Number of histogram buckets. Bucket i counts times in [2^i, 2^(i+1)) nanoseconds. */
+#define LOCK_HISTOGRAM_BUCKETS 32
+
+/**
+ * Contention data of all locks with the same name.
+ */
+struct LockProfile
+{
+    std::string name;
+    std::atomic<unsigned long> num_acquisitions{0};
+    /* Number of acquisitions that had to wait for another thread. */
+    std::atomic<unsigned long> num_contended{0};
+    /* Total wait and hold times in nanoseconds. */
+    std::atomic<unsigned long> total_wait{0};
+    std::atomic<unsigned long> total_hold{0};
+    std::array<std::atomic<unsigned long>, LOCK_HISTOGRAM_BUCKETS> wait_histogram{};
+    std::array<std::atomic<unsigned long>, LOCK_HISTOGRAM_BUCKETS> hold_histogram{};
+public:
+    void record_wait(unsigned long time);
+    void record_hold(unsigned long time);
+    void reset();
+};
+
+/**
+ * Registry of the lock profiles of the mutexes of one parser. Whether
+ * profiling is enabled is shared by all profilers.
+ */
+class LockProfiler
+{
+private:
+    std::deque<LockProfile> profiles;
+    mutable std::mutex profiles_mutex;
+public:
+    static void enable(bool enabled);
+    static bool is_enabled();
+    LockProfile& profile(const std::string& name);
+    void reset();
+    std::string report() const;
+};
+
+/**
+ * Mutex that records its contention while profiling is enabled.
+ */
+class ProfiledMutex
+{
+private:
+    std::mutex mutex;
+    LockProfile* profile = nullptr;
+    /* Whether the current holder is being profiled, and since when it holds the mutex. */
+    bool profiling = false;
+    std::chrono::steady_clock::time_point acquired;
+public:
+    ProfiledMutex() = default;
+    ProfiledMutex(LockProfiler& profiler, const std::string& name);
+public:
+    void set_name(LockProfiler& profiler, const std::string& name);
+    void lock();
+    bool try_lock();
+    void unlock();
+};
+
+/**
+ * Shared mutex that records its contention while profiling is enabled.
+ * Exclusive and shared acquisitions are recorded in the same profile.
+ */
+class ProfiledSharedMutex
+{
+private:
+    std::shared_mutex mutex;
+    LockProfile* profile = nullptr;
+    bool profiling = false;
+    std::chrono::steady_clock::time_point acquired;
+public:
+    ProfiledSharedMutex() = default;
+    ProfiledSharedMutex(LockProfiler& profiler, const std::string& name);
+public:
+    void set_name(LockProfiler& profiler, const std::string& name);
+    void lock();
+    bool try_lock();
+    void unlock();
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+};
@@ -0,0 +1,713 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Writer and reader of the binary result file, and the canonical text dump
+ *   of a result. See 'result_file.hpp' for the layout of the file.
+ */
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "result_file.hpp"
+#include "print.hpp"
+
+namespace
+{
+    /* First bytes of every result file. */
+    const std::string MAGIC = "CDSR";
+    /* Version of the layout of the file. */
+    const unsigned int VERSION = 1;
+    /* Kinds of the symbols in the symbol table. */
+    const unsigned int TERMINAL = 0;
+    const unsigned int NONTERMINAL = 1;
+
+    /**
+     * @brief Appends an unsigned LEB128 varint.
+     *
+     * @param out Buffer to append to.
+     * @param value Value to append.
+     */
+    void put_varint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        out.push_back(static_cast<char>(value));
+    }
+
+    /**
+     * @brief Appends a string, prefixed with its length.
+     *
+     * @param out Buffer to append to.
+     * @param value String to append.
+     */
+    void put_string(std::string& out, const std::string& value)
+    {
+        put_varint(out, value.size());
+        out += value;
+    }
+
+    /**
+     * @brief Returns the base of a value, given the row and the previous row.
+     *
+     * @param current Row of the value.
+     * @param previous Previous row, or nullptr for the first row.
+     * @param column Index of the column.
+     *
+     * @return The base of the value.
+     */
+    template <size_t N>
+    unsigned int column_base(const std::array<unsigned int, N>& current, const std::array<unsigned int, N>* previous, size_t column)
+    {
+        if (previous && std::equal(current.begin(), current.begin() + column, previous->begin()))
+        {
+            return (*previous)[column];
+        }
+
+        return column >= 2 ? current[column - 1] : 0;
+    }
+
+    /**
+     * @brief Returns the value that a value in a column is coded relative to.
+     * Within a group of rows that agree on all previous columns, that is the
+     * value in the previous row. A new group starts from the value in the
+     * previous column, since a pivot is at least the left extent and a right
+     * extent at least the pivot. The left extent, in column 1, starts from 0.
+     *
+     * @param rows Rows, sorted.
+     * @param row Index of the row.
+     * @param column Index of the column.
+     *
+     * @return The base of the value.
+     */
+    template <size_t N>
+    unsigned int column_base(const std::vector<std::array<unsigned int, N>>& rows, size_t row, size_t column)
+    {
+        return column_base(rows[row], row > 0 ? &rows[row - 1] : nullptr, column);
+    }
+
+    /**
+     * @brief Sorts rows. If the values of a row fit in 64 bits together, the
+     * rows are packed into integers first, which sort much faster.
+     *
+     * @param rows Rows to sort.
+     */
+    template <size_t N>
+    void sort_rows(std::vector<std::array<unsigned int, N>>& rows)
+    {
+        std::array<unsigned int, N> widths = {};
+        unsigned int total_width = 0;
+
+        for (size_t column = 0; column < N; column++)
+        {
+            unsigned int maximum = 0;
+
+            for (auto& row : rows)
+            {
+                maximum = std::max(maximum, row[column]);
+            }
+
+            while (widths[column] < 32 && maximum >> widths[column])
+            {
+                widths[column]++;
+            }
+
+            total_width += widths[column];
+        }
+
+        if (total_width > 64)
+        {
+            std::sort(rows.begin(), rows.end());
+            return;
+        }
+
+        std::vector<uint64_t> keys;
+        keys.reserve(rows.size());
+
+        for (auto& row : rows)
+        {
+            uint64_t key = 0;
+
+            for (size_t column = 0; column < N; column++)
+            {
+                key = (key << widths[column]) | row[column];
+            }
+
+            keys.push_back(key);
+        }
+
+        std::sort(keys.begin(), keys.end());
+
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            uint64_t key = keys[i];
+
+            for (size_t column = N; column-- > 0;)
+            {
+                rows[i][column] = static_cast<unsigned int>(key & ((uint64_t(1) << widths[column]) - 1));
+                key >>= widths[column];
+            }
+        }
+    }
+
+    /**
+     * @brief Sorts rows and appends them one column at a time, each value
+     * coded as the difference with its base. The differences are computed
+     * modulo 2^32, so rows that break the ordering of the extents still
+     * round-trip, only with longer varints.
+     *
+     * @param out Buffer to append to.
+     * @param rows Rows to append.
+     */
+    template <size_t N>
+    void put_columns(std::string& out, std::vector<std::array<unsigned int, N>>& rows)
+    {
+        sort_rows(rows);
+
+        put_varint(out, rows.size());
+
+        for (size_t column = 0; column < N; column++)
+        {
+            for (size_t row = 0; row < rows.size(); row++)
+            {
+                put_varint(out, rows[row][column] - column_base(rows, row, column));
+            }
+        }
+    }
+
+    /**
+     * @brief Appends buffered output to a file once the buffer is large.
+     *
+     * @param out Buffer of the output.
+     * @param file File to write to.
+     * @param force Whether to write the buffer regardless of its size.
+     *
+     * @return False if the file could not be written, true otherwise.
+     */
+    bool flush_output(std::string& out, std::ostream& file, bool force)
+    {
+        if (!force && out.size() < (1 << 20))
+        {
+            return true;
+        }
+
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        out.clear();
+
+        return static_cast<bool>(file);
+    }
+
+    /**
+     * @brief Appends the EPNs of a spill in the layout of put_columns. The
+     * merged run is already sorted, so it is read once per column instead of
+     * being loaded into memory, and the buffer is flushed to the file.
+     *
+     * @param out Buffer to append to.
+     * @param file File to flush the buffer to.
+     * @param spilled EPNs spilled to disk.
+     *
+     * @return False if the spill could not be read or the file written.
+     */
+    bool put_spilled_columns(std::string& out, std::ostream& file, const EPNSpill& spilled)
+    {
+        put_varint(out, spilled.size());
+
+        for (size_t column = 0; column < 4; column++)
+        {
+            std::array<unsigned int, 4> previous = {};
+            bool first = true;
+            bool written = true;
+
+            bool read = spilled.for_each([&](const EPN& e) {
+                std::array<unsigned int, 4> row = { e.slot->id, e.left_extent, e.pivot, e.right_extent };
+
+                put_varint(out, row[column] - column_base(row, first ? nullptr : &previous, column));
+                previous = row;
+                first = false;
+                written = written && flush_output(out, file, false);
+            });
+
+            if (!read || !written)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Reads values from the contents of a result file. After the first error
+     * all reads return 0 and failed() is true.
+     */
+    class ResultReader
+    {
+    private:
+        const std::string& data;
+        size_t position = 0;
+        bool error = false;
+    public:
+        ResultReader(const std::string& d) : data(d) {};
+
+        /**
+         * @return The next varint.
+         */
+        uint64_t varint()
+        {
+            uint64_t value = 0;
+
+            for (unsigned int shift = 0; shift < 64 && !error; shift += 7)
+            {
+                if (position >= data.size())
+                {
+                    break;
+                }
+
+                auto byte = static_cast<uint8_t>(data[position++]);
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+                if (!(byte & 0x80))
+                {
+                    return value;
+                }
+            }
+
+            error = true;
+            return 0;
+        }
+
+        /**
+         * @param limit Exclusive upper bound of the value.
+         *
+         * @return The next varint, or 0 if it is not below the limit.
+         */
+        unsigned int index(size_t limit)
+        {
+            uint64_t value = varint();
+
+            if (value >= limit)
+            {
+                error = true;
+                return 0;
+            }
+
+            return static_cast<unsigned int>(value);
+        }
+
+        /**
+         * @param length Number of bytes.
+         *
+         * @return The next bytes as a string.
+         */
+        std::string bytes(size_t length)
+        {
+            if (error || length > data.size() - position)
+            {
+                error = true;
+                return "";
+            }
+
+            position += length;
+
+            return data.substr(position - length, length);
+        }
+
+        /**
+         * @return The next length-prefixed string.
+         */
+        std::string string()
+        {
+            return bytes(varint());
+        }
+
+        /**
+         * @brief Reads rows that were written by put_columns.
+         *
+         * @param rows Vector to store the rows in.
+         */
+        template <size_t N>
+        void columns(std::vector<std::array<unsigned int, N>>& rows)
+        {
+            uint64_t count = varint();
+
+            /* Every value takes at least one byte. */
+            if (count > (data.size() - position) / N)
+            {
+                error = true;
+                return;
+            }
+
+            rows.resize(count);
+
+            for (size_t column = 0; column < N; column++)
+            {
+                for (size_t row = 0; row < rows.size(); row++)
+                {
+                    rows[row][column] = column_base(rows, row, column) + static_cast<unsigned int>(varint());
+                }
+            }
+        }
+
+        void fail() { error = true; }
+        bool failed() const { return error; }
+        bool at_end() const { return position == data.size(); }
+    };
+
+    /**
+     * Text of the slots of a result, built once per slot.
+     */
+    class SlotTexts
+    {
+    private:
+        std::vector<std::string> texts;
+    public:
+        /**
+         * @param slot Slot of a compiled grammar.
+         *
+         * @return The production rule of the slot as text, with the dot.
+         */
+        const std::string& get(const GrammarSlot* slot)
+        {
+            if (texts.size() <= slot->id)
+            {
+                texts.resize(slot->id + 1);
+            }
+
+            if (texts[slot->id].empty())
+            {
+                texts[slot->id] = production_rule_to_string(std::make_pair(slot->lhs, slot->rhs), slot->dot_position);
+            }
+
+            return texts[slot->id];
+        }
+    };
+}
+
+/**
+ * @brief Writes the result of a parse to a binary result file.
+ *
+ * @param file_name Name of the file to write.
+ * @param grammar Grammar of the parse.
+ * @param input_length Length of the input sequence.
+ * @param descriptors Descriptors of the parse.
+ * @param epns EPNs of the parse.
+ * @param spilled EPNs of the parse that were spilled to disk, used instead of
+ * epns if not nullptr.
+ *
+ * @return True if the file was written, false otherwise.
+ */
+bool write_result_file(
+    const std::string& file_name,
+    Grammar& grammar,
+    size_t input_length,
+    const descriptor_set_t& descriptors,
+    const epn_set_t& epns,
+    const EPNSpill* spilled
+)
+{
+    std::string out = MAGIC;
+    std::ofstream file(file_name, std::ios::binary);
+
+    if (!file)
+    {
+        std::cerr << "Error: unable to write file '" << file_name << "'" << std::endl;
+        return false;
+    }
+
+    grammar.compile();
+
+    /* Symbols in the rules get their symbol id as index, other symbols follow in sorted order. */
+    std::vector<std::string> symbols(grammar.compiled->symbol_ids.size());
+    std::unordered_map<std::string, unsigned int> indices(grammar.compiled->symbol_ids);
+    std::vector<std::string> unused;
+
+    for (auto& symbol : grammar.compiled->symbol_ids)
+    {
+        symbols[symbol.second] = symbol.first;
+    }
+
+    for (auto& symbol : grammar.symbols)
+    {
+        if (!indices.count(symbol))
+        {
+            unused.push_back(symbol);
+        }
+    }
+
+    std::sort(unused.begin(), unused.end());
+
+    for (auto& symbol : unused)
+    {
+        indices[symbol] = static_cast<unsigned int>(symbols.size());
+        symbols.push_back(symbol);
+    }
+
+    put_varint(out, VERSION);
+    put_varint(out, input_length);
+    put_varint(out, symbols.size());
+
+    for (auto& symbol : symbols)
+    {
+        put_varint(out, grammar.terminals.count(symbol) ? TERMINAL : NONTERMINAL);
+        put_string(out, symbol);
+    }
+
+    put_varint(out, grammar.has_start_symbol ? indices[grammar.start_symbol] + 1 : 0);
+
+    /* Rules in the order of their slots, so that the reader gets the same slot ids. */
+    std::vector<const GrammarSlot*> rules;
+
+    for (auto& slot : grammar.compiled->slots)
+    {
+        if (slot.dot_position == 0)
+        {
+            rules.push_back(&slot);
+        }
+    }
+
+    put_varint(out, rules.size());
+
+    for (auto rule : rules)
+    {
+        put_varint(out, rule->lhs_id);
+        put_varint(out, rule->rhs.size());
+
+        for (auto& symbol : rule->rhs)
+        {
+            put_varint(out, indices[symbol]);
+        }
+    }
+
+    std::vector<std::array<unsigned int, 3>> descriptor_rows;
+    std::vector<std::array<unsigned int, 4>> epn_rows;
+    bool success = true;
+
+    descriptor_rows.reserve(descriptors.size());
+
+    for (auto& d : descriptors)
+    {
+        descriptor_rows.push_back({ d.slot->id, d.left_extent, d.right_extent });
+    }
+
+    put_columns(out, descriptor_rows);
+
+    if (spilled)
+    {
+        success = put_spilled_columns(out, file, *spilled);
+    }
+    else
+    {
+        epn_rows.reserve(epns.size());
+
+        for (auto& e : epns)
+        {
+            epn_rows.push_back({ e.slot->id, e.left_extent, e.pivot, e.right_extent });
+        }
+
+        put_columns(out, epn_rows);
+    }
+
+    if (!success || !flush_output(out, file, true))
+    {
+        std::cerr << "Error: unable to write file '" << file_name << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Reads a binary result file. The grammar is rebuilt from the file and
+ * compiled, and the descriptors and EPNs refer to its slots.
+ *
+ * @param file_name Name of the file to read.
+ * @param result Variable to store the contents in.
+ *
+ * @return True if the file could be read, false otherwise.
+ */
+bool read_result_file(const std::string& file_name, ResultFile& result)
+{
+    std::ifstream file(file_name, std::ios::binary);
+
+    if (!file)
+    {
+        std::cerr << "Error: unable to open file '" << file_name << "'" << std::endl;
+        return false;
+    }
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ResultReader reader(data);
+
+    if (reader.bytes(MAGIC.size()) != MAGIC || reader.varint() != VERSION)
+    {
+        std::cerr << "Error: '" << file_name << "' is not a result file of version " << VERSION << std::endl;
+        return false;
+    }
+
+    Grammar grammar;
+    std::vector<std::string> symbols;
+
+    auto symbol = [&reader, &symbols]() {
+        unsigned int index = reader.index(symbols.size());
+
+        return reader.failed() ? std::string() : symbols[index];
+    };
+
+    result.input_length = reader.varint();
+    symbols.resize(reader.index(data.size()));
+
+    for (size_t i = 0; i < symbols.size() && !reader.failed(); i++)
+    {
+        unsigned int kind = reader.index(2);
+
+        symbols[i] = reader.string();
+
+        if (!reader.failed() && !(kind == TERMINAL ? grammar.add_terminal(symbols[i]) : grammar.add_nonterminal(symbols[i])))
+        {
+            reader.fail();
+        }
+    }
+
+    unsigned int start = reader.index(symbols.size() + 1);
+
+    if (start > 0 && !reader.failed() && !grammar.set_start_symbol(symbols[start - 1]))
+    {
+        reader.fail();
+    }
+
+    size_t num_rules = reader.index(data.size());
+
+    for (size_t i = 0; i < num_rules && !reader.failed(); i++)
+    {
+        std::string lhs = symbol();
+        std::vector<std::string> rhs(reader.index(data.size()));
+
+        for (auto& rhs_symbol : rhs)
+        {
+            rhs_symbol = symbol();
+        }
+
+        grammar.add_production_rule(lhs, rhs);
+    }
+
+    grammar.compile();
+
+    std::vector<std::array<unsigned int, 3>> descriptor_rows;
+    std::vector<std::array<unsigned int, 4>> epn_rows;
+
+    reader.columns(descriptor_rows);
+    reader.columns(epn_rows);
+
+    if (reader.failed() || !reader.at_end())
+    {
+        std::cerr << "Error: result file '" << file_name << "' is corrupt" << std::endl;
+        return false;
+    }
+
+    for (auto& row : descriptor_rows)
+    {
+        if (row[0] >= grammar.num_slots())
+        {
+            std::cerr << "Error: result file '" << file_name << "' is corrupt" << std::endl;
+            return false;
+        }
+    }
+
+    for (auto& row : epn_rows)
+    {
+        if (row[0] >= grammar.num_slots())
+        {
+            std::cerr << "Error: result file '" << file_name << "' is corrupt" << std::endl;
+            return false;
+        }
+    }
+
+    result.descriptors.clear();
+    result.epns.clear();
+    result.descriptors.reserve(descriptor_rows.size());
+    result.epns.reserve(epn_rows.size());
+
+    for (auto& row : descriptor_rows)
+    {
+        result.descriptors.insert(Descriptor(grammar.get_slot(row[0]), row[1], row[2]));
+    }
+
+    for (auto& row : epn_rows)
+    {
+        result.epns.insert(EPN(grammar.get_slot(row[0]), row[1], row[2], row[3]));
+    }
+
+    result.grammar = grammar;
+
+    return true;
+}
+
+/**
+ * @brief Writes the EPNs and descriptors as text, one per line, sorted by slot
+ * and extents. Two results of the same grammar give the same text if and only
+ * if they are equal, so the text can be compared with diff.
+ *
+ * @param out Stream to write to.
+ * @param descriptors Descriptors to write.
+ * @param epns EPNs to write.
+ * @param spilled EPNs spilled to disk, written instead of epns if not nullptr.
+ */
+void write_result_text(std::ostream& out, const descriptor_set_t& descriptors, const epn_set_t& epns, const EPNSpill* spilled)
+{
+    std::vector<EPN> sorted_epns;
+    std::vector<Descriptor> sorted_descriptors(descriptors.begin(), descriptors.end());
+    SlotTexts texts;
+
+    if (!spilled)
+    {
+        sorted_epns.assign(epns.begin(), epns.end());
+    }
+
+    std::sort(sorted_epns.begin(), sorted_epns.end(), [](const EPN& a, const EPN& b) {
+        return std::make_tuple(a.slot->id, a.left_extent, a.pivot, a.right_extent)
+             < std::make_tuple(b.slot->id, b.left_extent, b.pivot, b.right_extent);
+    });
+    std::sort(sorted_descriptors.begin(), sorted_descriptors.end(), [](const Descriptor& a, const Descriptor& b) {
+        return std::make_tuple(a.slot->id, a.left_extent, a.right_extent)
+             < std::make_tuple(b.slot->id, b.left_extent, b.right_extent);
+    });
+
+    std::string buffer;
+
+    auto write_epn = [&buffer, &texts, &out](const EPN& e) {
+        buffer += "[" + texts.get(e.slot)
+                + ", " + std::to_string(e.left_extent)
+                + ", " + std::to_string(e.pivot)
+                + ", " + std::to_string(e.right_extent) + "]\n";
+        flush_output(buffer, out, false);
+    };
+
+    buffer += "EPNs:\n";
+
+    if (spilled)
+    {
+        spilled->for_each(write_epn);
+    }
+
+    for (auto& e : sorted_epns)
+    {
+        write_epn(e);
+    }
+
+    buffer += "Descriptors:\n";
+
+    for (auto& d : sorted_descriptors)
+    {
+        buffer += "[" + texts.get(d.slot)
+                + ", " + std::to_string(d.left_extent)
+                + ", " + std::to_string(d.right_extent) + "]\n";
+    }
+
+    flush_output(buffer, out, true);
+}
@@ -0,0 +1,50 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Interface with the binary result file, which stores the descriptors and
+ *   EPNs of a parse together with the grammar they refer to. The file starts
+ *   with the magic bytes 'CDSR' and a version, followed by the input length,
+ *   the symbol table, the production rules, and then the descriptors and EPNs.
+ *   The descriptors and EPNs are sorted by slot and extents and stored one
+ *   column at a time, each value as a varint of its difference with the
+ *   previous value in the column, or with the previous column when the value
+ *   starts a new group. All numbers are unsigned LEB128 varints.
+ */
+
+#pragma once
+
+#include <ostream>
+#include "../components/grammar.hpp"
+#include "epn_spill.hpp"
+
+/**
+ * Contents of a result file.
+ */
+struct ResultFile
+{
+    /* Grammar of the parse. The descriptors and EPNs refer to its slots. */
+    Grammar grammar;
+    /* Length of the input sequence. */
+    size_t input_length = 0;
+    /* Descriptors of the parse. */
+    descriptor_set_t descriptors;
+    /* EPNs of the parse. */
+    epn_set_t epns;
+};
+
+bool write_result_file(
+    const std::string& file_name,
+    Grammar& grammar,
+    size_t input_length,
+    const descriptor_set_t& descriptors,
+    const epn_set_t& epns,
+    const EPNSpill* spilled = nullptr
+);
+bool read_result_file(const std::string& file_name, ResultFile& result);
+void write_result_text(
+    std::ostream& out,
+    const descriptor_set_t& descriptors,
+    const epn_set_t& epns,
+    const EPNSpill* spilled = nullptr
+);
@@ -0,0 +1,242 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the statistics that the parsers collect while parsing.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <time.h>
+#include "statistics.hpp"
+
+namespace
+{
+    /* Counters of the calling thread, set by Statistics::add_thread(). */
+    thread_local ThreadStatistics* current_statistics = nullptr;
+
+    /**
+     * @return CPU time used by the calling thread, in nanoseconds.
+     */
+    unsigned long thread_cpu_time()
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+        return static_cast<unsigned long>(ts.tv_sec) * 1000000000UL + static_cast<unsigned long>(ts.tv_nsec);
+    }
+}
+
+/**
+ * @brief Records the size of the worklist at the moment a descriptor is taken.
+ *
+ * @param depth Size of the worklist.
+ */
+void ThreadStatistics::record_queue_depth(size_t depth)
+{
+    num_dequeued++;
+    total_queue_depth += depth;
+
+    if (depth > max_queue_depth)
+    {
+        max_queue_depth = depth;
+    }
+}
+
+/**
+ * @brief Sets the CPU time and the allocation counters to what the calling
+ * thread used since it was added. Must be called by the thread itself when it
+ * stops working.
+ */
+void ThreadStatistics::stop_cpu_clock()
+{
+    AllocationCounters allocations = allocation_counters();
+
+    cpu_time = thread_cpu_time() - cpu_start;
+    num_allocations = allocations.num_allocations - allocations_start.num_allocations;
+    num_system_allocations = allocations.num_system_allocations - allocations_start.num_system_allocations;
+    num_remote_frees = allocations.num_remote_frees - allocations_start.num_remote_frees;
+}
+
+/**
+ * @brief Adds the counters of another thread to these counters. The maximum
+ * queue depth is the maximum of both.
+ *
+ * @param other Counters to add.
+ */
+ThreadStatistics& ThreadStatistics::operator+=(const ThreadStatistics& other)
+{
+    num_match += other.num_match;
+    num_descend += other.num_descend;
+    num_skip += other.num_skip;
+    num_ascend += other.num_ascend;
+    num_processed += other.num_processed;
+    num_duplicates += other.num_duplicates;
+    num_dequeued += other.num_dequeued;
+    total_queue_depth += other.total_queue_depth;
+    max_queue_depth = std::max(max_queue_depth, other.max_queue_depth);
+    idle_time += other.idle_time;
+    cpu_time += other.cpu_time;
+    num_allocations += other.num_allocations;
+    num_system_allocations += other.num_system_allocations;
+    num_remote_frees += other.num_remote_frees;
+
+    return *this;
+}
+
+/**
+ * @brief Forgets the counters of the calling thread if they are about to be
+ * destroyed, so that current() does not return them.
+ */
+Statistics::~Statistics()
+{
+    forget_current();
+}
+
+/**
+ * @brief Forgets the counters of the calling thread if they belong to these
+ * statistics. Other threads set theirs again with add_thread() before they
+ * use current().
+ */
+void Statistics::forget_current()
+{
+    for (auto& thread : threads)
+    {
+        if (&thread == current_statistics)
+        {
+            current_statistics = nullptr;
+        }
+    }
+}
+
+/**
+ * @brief Removes all counters and sets those of the lock profiles to zero.
+ * Must not be called while a parse is running.
+ */
+void Statistics::reset()
+{
+    forget_current();
+    threads.clear();
+    working_threads.clear();
+    stop_reason.clear();
+    worklist_policy.clear();
+    wall_time = 0;
+    locks.reset();
+}
+
+/**
+ * @brief Adds counters for the calling thread, which can then be accessed
+ * through current(). Safe to call from multiple threads at once.
+ *
+ * @return Counters of the calling thread.
+ */
+ThreadStatistics& Statistics::add_thread()
+{
+    std::lock_guard<std::mutex> lock(threads_mutex);
+
+    threads.emplace_back();
+    threads.back().cpu_start = thread_cpu_time();
+    threads.back().allocations_start = allocation_counters();
+    current_statistics = &threads.back();
+
+    return threads.back();
+}
+
+/**
+ * @return Counters of the calling thread. The thread must have called
+ * add_thread() on the statistics of the running parse.
+ */
+ThreadStatistics& Statistics::current()
+{
+    assert(current_statistics && "add_thread() was not called by this thread");
+
+    return *current_statistics;
+}
+
+/**
+ * @return Sum of the counters of all threads.
+ */
+ThreadStatistics Statistics::total() const
+{
+    ThreadStatistics result;
+
+    for (auto& thread : threads)
+    {
+        result += thread;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Writes counters as the members of a JSON object.
+ *
+ * @param ss Stream to write to.
+ * @param counters Counters to write.
+ */
+void counters_to_json(std::stringstream& ss, const ThreadStatistics& counters)
+{
+    double average_queue_depth = counters.num_dequeued
+        ? static_cast<double>(counters.total_queue_depth) / static_cast<double>(counters.num_dequeued)
+        : 0;
+
+    ss << "{\"match\": " << counters.num_match
+       << ", \"descend\": " << counters.num_descend
+       << ", \"skip\": " << counters.num_skip
+       << ", \"ascend\": " << counters.num_ascend
+       << ", \"processed\": " << counters.num_processed
+       << ", \"duplicates\": " << counters.num_duplicates
+       << ", \"average_queue_depth\": " << average_queue_depth
+       << ", \"max_queue_depth\": " << counters.max_queue_depth
+       << ", \"idle_ms\": " << static_cast<double>(counters.idle_time) / 1e6
+       << ", \"cpu_ms\": " << static_cast<double>(counters.cpu_time) / 1e6
+       << ", \"allocations\": " << counters.num_allocations
+       << ", \"system_allocations\": " << counters.num_system_allocations
+       << ", \"remote_frees\": " << counters.num_remote_frees
+       << "}";
+}
+
+/**
+ * @return The statistics as a single-line JSON object.
+ */
+std::string Statistics::to_json() const
+{
+    std::stringstream ss;
+
+    ss << "{\"threads\": " << threads.size() << ", \"wall_ms\": " << wall_time;
+
+    if (!worklist_policy.empty())
+    {
+        ss << ", \"worklist\": \"" << worklist_policy << "\"";
+    }
+
+    ss << ", \"total\": ";
+    counters_to_json(ss, total());
+    ss << ", \"per_thread\": [";
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        ss << (i ? ", " : "");
+        counters_to_json(ss, threads[i]);
+    }
+
+    ss << "], \"working_threads\": [";
+
+    for (size_t i = 0; i < working_threads.size(); i++)
+    {
+        ss << (i ? ", " : "") << working_threads[i];
+    }
+
+    ss << "]";
+
+    if (!stop_reason.empty())
+    {
+        ss << ", \"stopped\": \"" << stop_reason << "\"";
+    }
+
+    ss << "}";
+
+    return ss.str();
+}
@@ -0,0 +1,90 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Declares the statistics that the parsers collect while parsing. Each
+ *   thread updates its own counters, which are aggregated after the parse.
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "pool_allocator.hpp"
+#include "profiled_mutex.hpp"
+
+/* Size of a cache line in bytes. */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * Counters of a single thread. Aligned to a cache line, so that threads never
+ * write to the same cache line when updating their own counters.
+ */
+struct alignas(CACHE_LINE_SIZE) ThreadStatistics
+{
+    /* Number of times each action was applied. */
+    unsigned long num_match = 0;
+    unsigned long num_descend = 0;
+    unsigned long num_skip = 0;
+    unsigned long num_ascend = 0;
+    /* Number of descriptors processed. */
+    unsigned long num_processed = 0;
+    /* Number of descriptors rejected because they were already known. */
+    unsigned long num_duplicates = 0;
+    /* Number of times a descriptor was taken from a worklist. */
+    unsigned long num_dequeued = 0;
+    /* Sum and maximum of the worklist sizes seen when taking a descriptor. */
+    unsigned long total_queue_depth = 0;
+    unsigned long max_queue_depth = 0;
+    /* Time spent waiting for work, in nanoseconds. */
+    unsigned long idle_time = 0;
+    /* CPU time used by the thread, in nanoseconds. */
+    unsigned long cpu_time = 0;
+    /* CPU clock of the thread when it was added, in nanoseconds. */
+    unsigned long cpu_start = 0;
+    /* Allocations by the pool of the thread, see AllocationCounters. */
+    unsigned long num_allocations = 0;
+    unsigned long num_system_allocations = 0;
+    unsigned long num_remote_frees = 0;
+    /* Allocation counters of the pool of the thread when it was added. */
+    AllocationCounters allocations_start;
+public:
+    void record_queue_depth(size_t depth);
+    void stop_cpu_clock();
+    ThreadStatistics& operator+=(const ThreadStatistics& other);
+};
+
+/**
+ * Statistics of a parse.
+ */
+class Statistics
+{
+public:
+    /* Counters of each thread that took part in the parse. */
+    std::deque<ThreadStatistics> threads;
+    /* Number of times each number of threads was seen working at once. */
+    std::vector<unsigned long> working_threads;
+    /* Limit that stopped the parse early, or empty if it finished. */
+    std::string stop_reason;
+    /* Policy of the worklists, or empty if the parser has none. */
+    std::string worklist_policy;
+    /* Wall time of the parse in milliseconds. */
+    double wall_time = 0;
+    /* Contention of the locks of the parser, recorded with --lock-profile. */
+    LockProfiler locks;
+private:
+    std::mutex threads_mutex;
+public:
+    Statistics() = default;
+    ~Statistics();
+public:
+    void reset();
+    ThreadStatistics& add_thread();
+    static ThreadStatistics& current();
+    ThreadStatistics total() const;
+    std::string to_json() const;
+private:
+    void forget_current();
+};
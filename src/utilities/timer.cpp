@@ -9,23 +9,23 @@
 
 void Timer::start()
 {
-    m_StartTime = std::chrono::system_clock::now();
+    m_StartTime = std::chrono::steady_clock::now();
     m_bRunning = true;
 }
 
 void Timer::stop()
 {
-    m_EndTime = std::chrono::system_clock::now();
+    m_EndTime = std::chrono::steady_clock::now();
     m_bRunning = false;
 }
 
 long int Timer::elapsedNanoseconds()
 {
-    std::chrono::time_point<std::chrono::system_clock> endTime;
+    std::chrono::time_point<std::chrono::steady_clock> endTime;
 
     if(m_bRunning)
     {
-        endTime = std::chrono::system_clock::now();
+        endTime = std::chrono::steady_clock::now();
     }
     else
     {
@@ -2,16 +2,20 @@
  * Source:
  *   https://gist.github.com/mcleary/b0bf4fa88830ff7c882d
  * Description:
- *   Definition of class for high resolution timer using C++ chrono.
+ *   Definition of class for high resolution timer using C++ chrono. Uses the
+ *   monotonic steady clock, so that measurements are not affected by changes
+ *   to the system time.
  */
 
+#pragma once
+
 #include <chrono>
 
 class Timer
 {
 private:
-    std::chrono::time_point<std::chrono::system_clock> m_StartTime;
-    std::chrono::time_point<std::chrono::system_clock> m_EndTime;
+    std::chrono::time_point<std::chrono::steady_clock> m_StartTime;
+    std::chrono::time_point<std::chrono::steady_clock> m_EndTime;
     bool                                               m_bRunning = false;
 public:
     void start();
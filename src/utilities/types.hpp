@@ -12,7 +12,17 @@
 #include <tuple>
 #include <unordered_set>
 #include "hash_custom.hpp"
+#include "flat_set.hpp"
+#include "epn_store.hpp"
 
-typedef std::unordered_set<Descriptor, hash_custom::hash<Descriptor>> descriptor_set_t;
-typedef std::unordered_set<EPN, hash_custom::hash<EPN>> epn_set_t;
+/* Stores the EPNs in sorted, bit-packed columns instead of a hash set. Uses
+   several times less memory, but inserting and looking up EPNs is slower. */
+// #define OPTIMISATION_COLUMNAR_EPNS
+
+typedef FlatSet<Descriptor, hash_custom::hash<Descriptor>> descriptor_set_t;
+#ifdef OPTIMISATION_COLUMNAR_EPNS
+typedef EPNStore epn_set_t;
+#else
+typedef FlatSet<EPN, hash_custom::hash<EPN>> epn_set_t;
+#endif
 typedef std::pair<std::string, std::vector<std::string>> production_rule_t;
\ No newline at end of file
@@ -0,0 +1,108 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Implementation of the threads that parsers keep between parses.
+ */
+
+#include "worker_threads.hpp"
+
+/**
+ * @brief Stops and joins all threads. They must not be running a task.
+ */
+WorkerThreads::~WorkerThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    start_cv.notify_all();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Runs a function on a number of threads, each called with its index
+ * from 0 up to the number of threads. Returns without waiting for them. The
+ * previous task must have been waited for.
+ *
+ * @param count Number of threads to run the function on.
+ * @param function Function to run.
+ */
+void WorkerThreads::start(size_t count, std::function<void(size_t)> function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        task = std::move(function);
+        num_tasks = count;
+        num_running = count;
+
+        while (threads.size() < count)
+        {
+            threads.push_back(std::thread(&WorkerThreads::thread_function, this, threads.size(), generation));
+        }
+
+        generation++;
+    }
+
+    start_cv.notify_all();
+}
+
+/**
+ * @brief Waits until all threads finished the current task.
+ */
+void WorkerThreads::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this]() { return num_running == 0; });
+}
+
+/**
+ * @brief Runs the tasks meant for a thread until the threads are stopped.
+ *
+ * @param index Index of the thread.
+ * @param seen Generation of the last task the thread has seen.
+ */
+void WorkerThreads::thread_function(size_t index, unsigned long seen)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [this, seen]() { return stopping || generation != seen; });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            seen = generation;
+
+            if (index >= num_tasks)
+            {
+                continue;
+            }
+        }
+
+        task(index);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (--num_running == 0)
+            {
+                done_cv.notify_all();
+            }
+        }
+    }
+}
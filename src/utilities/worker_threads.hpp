@@ -0,0 +1,48 @@
+/**
+ * Author:
+ *   Marco van Eerden
+ * Description:
+ *   Threads of a parser that are kept between parses, so that a server that
+ *   parses many small inputs does not create and join threads per request.
+ *   The threads sleep on a condition variable between tasks. Threads are
+ *   created when a task needs more of them than exist, and joined when the
+ *   parser is destroyed.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Set of threads that run one task at a time, each with its own index.
+ */
+class WorkerThreads
+{
+private:
+    std::vector<std::thread> threads;
+    /* Task of the threads, and the number of threads that run it. */
+    std::function<void(size_t)> task;
+    size_t num_tasks = 0;
+    /* Number of threads that have not finished the task yet. */
+    size_t num_running = 0;
+    /* Incremented for every task, so that a thread runs each task once. */
+    unsigned long generation = 0;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+public:
+    WorkerThreads() = default;
+    ~WorkerThreads();
+    WorkerThreads(const WorkerThreads&) = delete;
+    WorkerThreads& operator=(const WorkerThreads&) = delete;
+public:
+    void start(size_t count, std::function<void(size_t)> function);
+    void wait();
+private:
+    void thread_function(size_t index, unsigned long seen);
+};